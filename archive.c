@@ -0,0 +1,296 @@
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "archive.h"
+#include "dump.h"
+
+#define ARCHIVE_MAGIC       "SRIXARCH"
+#define ARCHIVE_VERSION     1
+#define ARCHIVE_BYTE_ORDER  0x01020304U
+#define ARCHIVE_IMPORT_BATCH 256
+
+/**
+ * Archive file header, followed by fixed-size records.
+ */
+typedef struct ArchiveHeader {
+    char magic[8];                    /* ARCHIVE_MAGIC */
+    uint32_t version;                 /* ARCHIVE_VERSION */
+    uint32_t recordSize;              /* sizeof(SrixArchiveRecord) */
+    uint32_t byteOrder;               /* ARCHIVE_BYTE_ORDER written in host order */
+    uint32_t reserved;                /* keeps records 8 bytes aligned */
+} ArchiveHeader;
+
+/**
+ * Entry of UID index.
+ */
+typedef struct ArchiveIndexEntry {
+    uint64_t uid;                     /* SRIX UID */
+    int64_t timestamp;                /* record timestamp */
+    size_t record;                    /* record index */
+} ArchiveIndexEntry;
+
+/**
+ * Archive mapped in memory.
+ */
+struct SrixArchive {
+    void *mapping;                    /* mapped file */
+    size_t mappingSize;               /* size of mapped file */
+    const SrixArchiveRecord *records; /* first record */
+    size_t count;                     /* number of records */
+    ArchiveIndexEntry *index;         /* records sorted by UID and timestamp */
+};
+
+/**
+ * Build the header of an archive created by this host.
+ * @return archive header
+ */
+static ArchiveHeader archiveHeader() {
+    ArchiveHeader header = {
+            .version = ARCHIVE_VERSION,
+            .recordSize = sizeof(SrixArchiveRecord),
+            .byteOrder = ARCHIVE_BYTE_ORDER,
+            .reserved = 0
+    };
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+    return header;
+}
+
+/**
+ * Compare two index entries by UID and then by timestamp.
+ */
+static int archiveIndexCompare(const void *first, const void *second) {
+    const ArchiveIndexEntry *a = first;
+    const ArchiveIndexEntry *b = second;
+
+    if (a->uid != b->uid) {
+        return a->uid < b->uid ? -1 : 1;
+    } else if (a->timestamp != b->timestamp) {
+        return a->timestamp < b->timestamp ? -1 : 1;
+    } else {
+        return a->record < b->record ? -1 : a->record > b->record;
+    }
+}
+
+SrixArchive *SrixArchiveOpen(const char *filename) {
+    int file = open(filename, O_RDONLY);
+    if (file < 0) {
+        return (void *) 0;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) != 0 || (size_t) info.st_size < sizeof(ArchiveHeader)) {
+        close(file);
+        return (void *) 0;
+    }
+
+    void *mapping = mmap((void *) 0, info.st_size, PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED) {
+        return (void *) 0;
+    }
+
+    /* Only archives written with the same layout and byte order can be mapped directly */
+    ArchiveHeader expected = archiveHeader();
+    if (memcmp(mapping, &expected, sizeof(ArchiveHeader)) != 0) {
+        munmap(mapping, info.st_size);
+        return (void *) 0;
+    }
+
+    SrixArchive *created = malloc(sizeof(SrixArchive));
+    if (!created) {
+        munmap(mapping, info.st_size);
+        return (void *) 0;
+    }
+
+    created->mapping = mapping;
+    created->mappingSize = info.st_size;
+    created->records = (const SrixArchiveRecord *) ((const uint8_t *) mapping + sizeof(ArchiveHeader));
+
+    /* A partial record at the end (interrupted append) is ignored */
+    created->count = (info.st_size - sizeof(ArchiveHeader)) / sizeof(SrixArchiveRecord);
+
+    /* Build UID index */
+    created->index = malloc((created->count ? created->count : 1) * sizeof(ArchiveIndexEntry));
+    if (!created->index) {
+        SrixArchiveClose(created);
+        return (void *) 0;
+    }
+
+    for (size_t i = 0; i < created->count; i++) {
+        created->index[i] = (ArchiveIndexEntry) {
+                .uid = created->records[i].uid,
+                .timestamp = created->records[i].timestamp,
+                .record = i
+        };
+    }
+    qsort(created->index, created->count, sizeof(ArchiveIndexEntry), archiveIndexCompare);
+
+    return created;
+}
+
+void SrixArchiveClose(SrixArchive archive[static 1]) {
+    munmap(archive->mapping, archive->mappingSize);
+    free(archive->index);
+    free(archive);
+}
+
+size_t SrixArchiveCount(SrixArchive archive[static 1]) {
+    return archive->count;
+}
+
+const SrixArchiveRecord *SrixArchiveGet(SrixArchive archive[static 1], size_t index) {
+    return index < archive->count ? archive->records + index : (void *) 0;
+}
+
+const SrixArchiveRecord *SrixArchiveFind(SrixArchive archive[static 1], uint64_t uid) {
+    /* Search first entry with a greater UID, previous entry is the most recent one of uid */
+    size_t low = 0;
+    size_t high = archive->count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (archive->index[middle].uid <= uid) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (low == 0 || archive->index[low - 1].uid != uid) {
+        return (void *) 0;
+    }
+
+    return archive->records + archive->index[low - 1].record;
+}
+
+SrixError SrixArchiveAppend(const char *filename, const SrixArchiveRecord *records, size_t count) {
+    int file = open(filename, O_RDWR | O_APPEND | O_CREAT, 0644);
+    if (file < 0) {
+        return SRIX_ERROR(SRIX_ERROR, "unable to open archive file");
+    }
+
+    struct stat info;
+    if (fstat(file, &info) != 0) {
+        close(file);
+        return SRIX_ERROR(SRIX_ERROR, "unable to read archive file");
+    }
+
+    ArchiveHeader expected = archiveHeader();
+    off_t end = sizeof(ArchiveHeader);
+    if (info.st_size == 0) {
+        /* New archive */
+        if (write(file, &expected, sizeof(ArchiveHeader)) != sizeof(ArchiveHeader)) {
+            close(file);
+            return SRIX_ERROR(SRIX_ERROR, "unable to write archive header");
+        }
+    } else {
+        ArchiveHeader header;
+        if (pread(file, &header, sizeof(ArchiveHeader), 0) != sizeof(ArchiveHeader) ||
+            memcmp(&header, &expected, sizeof(ArchiveHeader)) != 0) {
+            close(file);
+            return SRIX_ERROR(SRIX_ERROR, "incompatible archive file");
+        }
+
+        /* Drop a partial record left by an interrupted append */
+        off_t partial = (info.st_size - (off_t) sizeof(ArchiveHeader)) % (off_t) sizeof(SrixArchiveRecord);
+        if (partial && ftruncate(file, info.st_size - partial) != 0) {
+            close(file);
+            return SRIX_ERROR(SRIX_ERROR, "unable to repair archive file");
+        }
+        end = info.st_size - partial;
+    }
+
+    /* All records in a single write, a partial one is removed */
+    size_t size = count * sizeof(SrixArchiveRecord);
+    ssize_t written = write(file, records, size);
+    if (written < 0 || (size_t) written != size) {
+        (void) !ftruncate(file, end);
+        close(file);
+        return SRIX_ERROR(SRIX_ERROR, "unable to write archive records");
+    } else if (close(file) != 0) {
+        return SRIX_ERROR(SRIX_ERROR, "unable to write archive records");
+    }
+
+    return SRIX_NO_ERROR;
+}
+
+SrixError SrixArchiveImport(const char *filename, char *const dumps[], size_t count) {
+    SrixArchiveRecord *batch = malloc(ARCHIVE_IMPORT_BATCH * sizeof(SrixArchiveRecord));
+    if (!batch) {
+        return SRIX_ERROR(SRIX_ERROR, "unable to allocate memory for import");
+    }
+
+    /* Archive is restored to this size if a dump can't be imported */
+    struct stat original;
+    bool existing = stat(filename, &original) == 0;
+
+    SrixError error = SRIX_NO_ERROR;
+    size_t batchCount = 0;
+
+    for (size_t i = 0; i < count && !SRIX_IS_ERROR(error); i++) {
+        SrixArchiveRecord *record = batch + batchCount;
+
+        error = SrixDumpLoad(dumps[i], record->eeprom, &record->uid);
+        if (SRIX_IS_ERROR(error)) {
+            break;
+        }
+
+        /* Dump timestamp is its last modification */
+        struct stat info;
+        record->timestamp = stat(dumps[i], &info) == 0 ? (int64_t) info.st_mtime : 0;
+
+        if (++batchCount == ARCHIVE_IMPORT_BATCH) {
+            error = SrixArchiveAppend(filename, batch, batchCount);
+            batchCount = 0;
+        }
+    }
+
+    if (!SRIX_IS_ERROR(error) && batchCount) {
+        error = SrixArchiveAppend(filename, batch, batchCount);
+    }
+
+    if (SRIX_IS_ERROR(error)) {
+        if (existing) {
+            (void) !truncate(filename, original.st_size);
+        } else {
+            remove(filename);
+        }
+    }
+
+    free(batch);
+    return error;
+}
+
+SrixError SrixArchiveExport(SrixArchive archive[static 1], const char *directory) {
+    char path[PATH_MAX];
+    size_t sequence = 0;
+
+    /* Index keeps records of the same UID and timestamp next to each other */
+    for (size_t i = 0; i < archive->count; i++) {
+        const ArchiveIndexEntry *entry = archive->index + i;
+        const SrixArchiveRecord *record = archive->records + entry->record;
+
+        bool repeated = i > 0 && entry[-1].uid == entry->uid && entry[-1].timestamp == entry->timestamp;
+        sequence = repeated ? sequence + 1 : 0;
+        if (sequence) {
+            snprintf(path, sizeof(path), "%s/%016" PRIX64 "-%" PRId64 "-%zu.bin", directory, record->uid,
+                     record->timestamp, sequence);
+        } else {
+            snprintf(path, sizeof(path), "%s/%016" PRIX64 "-%" PRId64 ".bin", directory, record->uid,
+                     record->timestamp);
+        }
+
+        SrixError error = SrixDumpSaveRaw(path, record->eeprom, record->uid);
+        if (SRIX_IS_ERROR(error)) {
+            return error;
+        }
+    }
+
+    return SRIX_NO_ERROR;
+}
@@ -0,0 +1,84 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "error.h"
+
+/**
+ * Single dump saved in an archive.
+ * Blocks are saved in host byte order, so they can be used directly from the mapped file.
+ */
+typedef struct SrixArchiveRecord {
+    uint64_t uid;                     /* SRIX UID */
+    int64_t timestamp;                /* seconds since epoch when dump has been saved */
+    uint32_t eeprom[SRIX4K_BLOCKS];   /* SRIX4K EEPROM */
+} SrixArchiveRecord;
+
+typedef struct SrixArchive SrixArchive;
+
+/**
+ * Open an archive file in read-only mode, mapping it in memory.
+ * @param filename name of archive file
+ * @return null if there is an error, else a SrixArchive pointer
+ */
+SrixArchive *SrixArchiveOpen(const char *filename);
+
+/**
+ * Unmap an archive and free its memory.
+ * @param archive pointer to SrixArchive
+ */
+void SrixArchiveClose(SrixArchive *archive);
+
+/**
+ * Get number of records in an archive.
+ * @param archive pointer to SrixArchive
+ * @return number of records
+ */
+size_t SrixArchiveCount(SrixArchive *archive);
+
+/**
+ * Get a record of an archive, without copying it.
+ * @param archive pointer to SrixArchive
+ * @param index index of record (in append order)
+ * @return pointer to record in mapped memory, null if index is out of range
+ */
+const SrixArchiveRecord *SrixArchiveGet(SrixArchive *archive, size_t index);
+
+/**
+ * Find the most recent record of a tag using the UID index.
+ * @param archive pointer to SrixArchive
+ * @param uid UID to search
+ * @return pointer to record in mapped memory, null if UID isn't in archive
+ */
+const SrixArchiveRecord *SrixArchiveFind(SrixArchive *archive, uint64_t uid);
+
+/**
+ * Append records to an archive, creating it if it doesn't exist.
+ * @param filename name of archive file
+ * @param records records to append
+ * @param count number of records
+ * @return SrixError result
+ */
+SrixError SrixArchiveAppend(const char *filename, const SrixArchiveRecord *records, size_t count);
+
+/**
+ * Append raw dump files to an archive.
+ * If a dump can't be imported the archive is restored as it was before the import.
+ * @param filename name of archive file
+ * @param dumps names of raw dump files
+ * @param count number of dump files
+ * @return SrixError result
+ */
+SrixError SrixArchiveImport(const char *filename, char *const dumps[], size_t count);
+
+/**
+ * Save every record of an archive as raw dump file, named with UID and timestamp.
+ * Records with the same UID and timestamp get a sequence number after the timestamp, in append order.
+ * @param archive pointer to SrixArchive
+ * @param directory directory where save dump files
+ * @return SrixError result
+ */
+SrixError SrixArchiveExport(SrixArchive *archive, const char *directory);
+
+#endif /* ARCHIVE_H */
@@ -0,0 +1,272 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include "async.h"
+#include "reader.h"
+
+/* Delay between tag polls while waiting for a tag */
+#define ASYNC_POLL_MICROS  20000
+
+/**
+ * Asynchronous runner of a Srix.
+ */
+struct SrixAsync {
+    Srix *srix;                               /* Srix used by the worker */
+    SrixAsyncCallback callback;               /* completion callback, can be null */
+    void *data;                               /* user data of callback */
+    int notify[2];                            /* completion pipe, read end is pollable */
+    pthread_t thread;                         /* worker thread */
+    pthread_mutex_t lock;                     /* state lock */
+    pthread_cond_t started;                   /* signaled when an operation starts or worker has to stop */
+    SrixAsyncProgress progress;               /* state of current operation */
+    bool pending;                             /* operation started but not taken by worker yet */
+    bool stopping;                            /* true when worker has to exit */
+    NfcCancel cancel;                         /* cancel handle of current operation */
+    bool lazy;                                /* lazy setting of the Srix, restored on delete */
+    SrixError result;                         /* result of completed operation */
+};
+
+/**
+ * Update the progress of the current operation.
+ * @param async pointer to SrixAsync
+ * @param state current state
+ * @param done completed blocks or steps
+ * @param total blocks or steps of current state
+ */
+static void asyncSetProgress(SrixAsync *async, SrixAsyncState state, uint8_t done, uint8_t total) {
+    pthread_mutex_lock(&async->lock);
+    async->progress = (SrixAsyncProgress) {.state = state, .done = done, .total = total};
+    pthread_mutex_unlock(&async->lock);
+}
+
+/**
+ * Wait for a tag, then read its UID and all its blocks one at a time.
+ * @param async pointer to SrixAsync
+ * @return SrixError result
+ */
+static SrixError asyncRead(SrixAsync *async) {
+    Srix *srix = async->srix;
+
+    /* Selection never waits inside the reader, so cancellation is checked between polls */
+    while (SrixNfcNextTag(srix, false)) {
+        SrixError error = SrixGetLatestError(srix);
+        if (error.errorType != NFC_TAG_MISSING) {
+            return error;
+        } else if (atomic_load(&async->cancel.cancelled)) {
+            return SRIX_ERROR(SRIX_CANCELLED, "operation cancelled");
+        }
+
+        struct timespec sleepTime = {.tv_sec = 0, .tv_nsec = ASYNC_POLL_MICROS * 1000};
+        nanosleep(&sleepTime, (void *) 0);
+    }
+
+    for (uint8_t i = 0; i < SRIX4K_BLOCKS; i++) {
+        asyncSetProgress(async, SRIX_ASYNC_READ, i, SRIX4K_BLOCKS);
+        if (atomic_load(&async->cancel.cancelled)) {
+            return SRIX_ERROR(SRIX_CANCELLED, "operation cancelled");
+        }
+
+        if (SrixPrefetchBlocks(srix, i, 1) != SRIX_SUCCESS) {
+            return SrixGetLatestError(srix);
+        }
+    }
+
+    return SRIX_NO_ERROR;
+}
+
+/**
+ * Write the modified blocks of the Srix one write plan step at a time.
+ * @param async pointer to SrixAsync
+ * @return SrixError result
+ */
+static SrixError asyncWrite(SrixAsync *async) {
+    Srix *srix = async->srix;
+    SrixWritePlan plan;
+    SrixCompileWritePlan(srix, &plan);
+
+    /* Nothing to send, only modified blocks are reset */
+    if (plan.count == 0) {
+        return SrixWriteBlocks(srix) != SRIX_SUCCESS ? SrixGetLatestError(srix) : SRIX_NO_ERROR;
+    }
+
+    for (uint8_t i = 0; i < plan.count; i++) {
+        asyncSetProgress(async, SRIX_ASYNC_WRITE, i, plan.count);
+        if (atomic_load(&async->cancel.cancelled)) {
+            return SRIX_ERROR(SRIX_CANCELLED, "operation cancelled");
+        }
+
+        if (SrixExecuteWriteStep(srix, &plan, i) != SRIX_SUCCESS) {
+            return SrixGetLatestError(srix);
+        }
+    }
+
+    return SRIX_NO_ERROR;
+}
+
+/**
+ * Worker thread: run the started operations until the runner is deleted.
+ * @param arg pointer to SrixAsync
+ * @return null
+ */
+static void *asyncWorker(void *arg) {
+    SrixAsync *async = arg;
+
+    pthread_mutex_lock(&async->lock);
+    for (;;) {
+        while (!async->pending && !async->stopping) {
+            pthread_cond_wait(&async->started, &async->lock);
+        }
+        if (async->stopping) {
+            break;
+        }
+
+        async->pending = false;
+        SrixAsyncState state = async->progress.state;
+        pthread_mutex_unlock(&async->lock);
+
+        SrixError result = state == SRIX_ASYNC_WRITE ? asyncWrite(async) : asyncRead(async);
+
+        /* Wake up the host, the byte is consumed by SrixAsyncFinish */
+        const uint8_t done = 1;
+        pthread_mutex_lock(&async->lock);
+        async->result = result;
+        async->progress.state = SRIX_ASYNC_DONE;
+        (void) !write(async->notify[1], &done, sizeof(done));
+        pthread_mutex_unlock(&async->lock);
+
+        if (async->callback) {
+            async->callback(async->srix, result, async->data);
+        }
+
+        pthread_mutex_lock(&async->lock);
+    }
+    pthread_mutex_unlock(&async->lock);
+
+    return (void *) 0;
+}
+
+/**
+ * Start an operation, if the runner is idle.
+ * @param async pointer to SrixAsync
+ * @param state first state of operation
+ * @return false if the runner isn't idle
+ */
+static bool asyncBegin(SrixAsync *async, SrixAsyncState state) {
+    pthread_mutex_lock(&async->lock);
+    bool idle = async->progress.state == SRIX_ASYNC_IDLE;
+    if (idle) {
+        async->progress = (SrixAsyncProgress) {.state = state};
+        async->pending = true;
+        NfcCancelReset(&async->cancel);
+        pthread_cond_signal(&async->started);
+    }
+    pthread_mutex_unlock(&async->lock);
+
+    return idle;
+}
+
+SrixAsync *SrixAsyncNew(Srix *srix, SrixAsyncCallback callback, void *data) {
+    SrixAsync *created = malloc(sizeof(SrixAsync));
+    if (!created) {
+        return (void *) 0;
+    }
+
+    if (pipe(created->notify) != 0) {
+        free(created);
+        return (void *) 0;
+    }
+    fcntl(created->notify[0], F_SETFL, O_NONBLOCK);
+    fcntl(created->notify[1], F_SETFL, O_NONBLOCK);
+
+    created->srix = srix;
+    created->callback = callback;
+    created->data = data;
+    created->progress = (SrixAsyncProgress) {.state = SRIX_ASYNC_IDLE};
+    created->pending = false;
+    created->stopping = false;
+    atomic_init(&created->cancel.cancelled, false);
+    created->result = SRIX_NO_ERROR;
+    pthread_mutex_init(&created->lock, (void *) 0);
+    pthread_cond_init(&created->started, (void *) 0);
+
+    /* Blocks are read by the worker one at a time, cancellation also stops retries of a block */
+    created->lazy = SrixGetLazy(srix);
+    SrixSetLazy(srix, true);
+    SrixSetDeadline(srix, 0, &created->cancel);
+
+    if (pthread_create(&created->thread, (void *) 0, asyncWorker, created) != 0) {
+        SrixSetDeadline(srix, 0, (void *) 0);
+        SrixSetLazy(srix, created->lazy);
+        pthread_mutex_destroy(&created->lock);
+        pthread_cond_destroy(&created->started);
+        close(created->notify[0]);
+        close(created->notify[1]);
+        free(created);
+        return (void *) 0;
+    }
+
+    return created;
+}
+
+int SrixAsyncGetFd(SrixAsync async[static 1]) {
+    return async->notify[0];
+}
+
+bool SrixAsyncBeginRead(SrixAsync async[static 1]) {
+    return asyncBegin(async, SRIX_ASYNC_SELECT);
+}
+
+bool SrixAsyncBeginWrite(SrixAsync async[static 1]) {
+    return asyncBegin(async, SRIX_ASYNC_WRITE);
+}
+
+void SrixAsyncCancel(SrixAsync async[static 1]) {
+    NfcCancelTrigger(&async->cancel);
+}
+
+SrixAsyncProgress SrixAsyncGetProgress(SrixAsync async[static 1]) {
+    pthread_mutex_lock(&async->lock);
+    SrixAsyncProgress progress = async->progress;
+    pthread_mutex_unlock(&async->lock);
+
+    return progress;
+}
+
+bool SrixAsyncFinish(SrixAsync async[static 1], SrixError result[static 1]) {
+    pthread_mutex_lock(&async->lock);
+    bool done = async->progress.state == SRIX_ASYNC_DONE;
+    if (done) {
+        *result = async->result;
+        async->progress = (SrixAsyncProgress) {.state = SRIX_ASYNC_IDLE};
+
+        /* Drain completion notification */
+        uint8_t buffer[16];
+        while (read(async->notify[0], buffer, sizeof(buffer)) > 0);
+    }
+    pthread_mutex_unlock(&async->lock);
+
+    return done;
+}
+
+void SrixAsyncDelete(SrixAsync async[static 1]) {
+    SrixAsyncCancel(async);
+
+    pthread_mutex_lock(&async->lock);
+    async->stopping = true;
+    pthread_cond_signal(&async->started);
+    pthread_mutex_unlock(&async->lock);
+
+    pthread_join(async->thread, (void *) 0);
+
+    /* The Srix can be used again, without references to the runner */
+    SrixSetDeadline(async->srix, 0, (void *) 0);
+    SrixSetLazy(async->srix, async->lazy);
+
+    pthread_mutex_destroy(&async->lock);
+    pthread_cond_destroy(&async->started);
+    close(async->notify[0]);
+    close(async->notify[1]);
+    free(async);
+}
@@ -0,0 +1,101 @@
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "error.h"
+#include "srix.h"
+
+/**
+ * State of an asynchronous operation.
+ */
+typedef enum {
+    SRIX_ASYNC_IDLE,     /* no operation started */
+    SRIX_ASYNC_SELECT,   /* waiting for a tag in the field, then reading its UID */
+    SRIX_ASYNC_READ,     /* reading blocks */
+    SRIX_ASYNC_WRITE,    /* executing write plan steps */
+    SRIX_ASYNC_DONE      /* operation completed, result not collected yet */
+} SrixAsyncState;
+
+/**
+ * Progress of an asynchronous operation.
+ */
+typedef struct SrixAsyncProgress {
+    SrixAsyncState state;             /* current state */
+    uint8_t done;                     /* blocks read or write steps executed in current state */
+    uint8_t total;                    /* blocks to read or write steps to execute in current state */
+} SrixAsyncProgress;
+
+/**
+ * Function called by the worker thread when an operation completes.
+ * @param srix Srix of the operation
+ * @param result operation result, SRIX_CANCELLED if it has been cancelled
+ * @param data user data passed to SrixAsyncNew
+ */
+typedef void (*SrixAsyncCallback)(Srix *srix, SrixError result, void *data);
+
+/**
+ * Runs reads and writes of a Srix in the background, one radio operation at a time,
+ * so a host thread can supervise many readers with poll() or callbacks.
+ */
+typedef struct SrixAsync SrixAsync;
+
+/**
+ * Create the asynchronous runner of a Srix, with its worker thread.
+ * Srix reader has to be open, and the Srix can't be used directly until the runner is deleted.
+ * @param srix pointer to Srix with an open reader
+ * @param callback function called at the end of every operation, can be null
+ * @param data user data passed to callback
+ * @return null if there is an error, else a SrixAsync pointer
+ */
+SrixAsync *SrixAsyncNew(Srix *srix, SrixAsyncCallback callback, void *data);
+
+/**
+ * Get a file descriptor that becomes readable when an operation completes, to use with poll() or select().
+ * @param async pointer to SrixAsync
+ * @return file descriptor, valid until the runner is deleted
+ */
+int SrixAsyncGetFd(SrixAsync *async);
+
+/**
+ * Start waiting for a tag, then read its UID and all its blocks.
+ * @param async pointer to SrixAsync
+ * @return false if another operation is running or its result hasn't been collected
+ */
+bool SrixAsyncBeginRead(SrixAsync *async);
+
+/**
+ * Start writing the modified blocks of the Srix to the selected tag.
+ * @param async pointer to SrixAsync
+ * @return false if another operation is running or its result hasn't been collected
+ */
+bool SrixAsyncBeginWrite(SrixAsync *async);
+
+/**
+ * Cancel the running operation, it completes with SRIX_CANCELLED after the current radio operation.
+ * @param async pointer to SrixAsync
+ */
+void SrixAsyncCancel(SrixAsync *async);
+
+/**
+ * Get the progress of the running operation.
+ * @param async pointer to SrixAsync
+ * @return copy of operation progress
+ */
+SrixAsyncProgress SrixAsyncGetProgress(SrixAsync *async);
+
+/**
+ * Collect the result of a completed operation without waiting, so a new one can be started.
+ * @param async pointer to SrixAsync
+ * @param result pointer where save the operation result
+ * @return false if there isn't a completed operation
+ */
+bool SrixAsyncFinish(SrixAsync *async, SrixError *result);
+
+/**
+ * Cancel the running operation, stop the worker thread and free the runner memory.
+ * @param async pointer to SrixAsync
+ */
+void SrixAsyncDelete(SrixAsync *async);
+
+#endif /* ASYNC_H */
@@ -0,0 +1,379 @@
+#include <dirent.h>
+#include <glob.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "batch.h"
+#include "dump.h"
+#include "srix.h"
+
+/* "[XX] -> XXXXXXXX\n" for every block, plus file and UID line */
+#define BATCH_PRINT_SIZE  (SRIX_OUTPUT_MAX_LENGTH + PATH_MAX + 2)
+
+/**
+ * State shared by batch workers.
+ */
+typedef struct BatchState {
+    const SrixBatchFiles *files;      /* files to process */
+    const SrixBatchOptions *options;  /* operations to apply */
+    const size_t *sequences;          /* number of previous files with the same name, null without output */
+    atomic_size_t next;               /* next file to process */
+    atomic_size_t failed;             /* files with an error */
+} BatchState;
+
+/**
+ * File name of a file list entry.
+ */
+typedef struct BatchName {
+    const char *name;                 /* file name, without directories */
+    size_t index;                     /* index in file list */
+} BatchName;
+
+/**
+ * Add a copy of a path to a file list.
+ * @param files pointer to file list
+ * @param path path to add
+ * @return boolean result
+ */
+static bool batchAddFile(SrixBatchFiles *files, const char *path) {
+    if (files->count == files->capacity) {
+        size_t capacity = files->capacity ? files->capacity * 2 : 64;
+        char **paths = realloc(files->paths, capacity * sizeof(char *));
+        if (!paths) {
+            return false;
+        }
+
+        files->paths = paths;
+        files->capacity = capacity;
+    }
+
+    char *copy = strdup(path);
+    if (!copy) {
+        return false;
+    }
+
+    files->paths[files->count++] = copy;
+    return true;
+}
+
+/**
+ * Add all regular files of a directory to a file list.
+ * @param files pointer to file list
+ * @param directoryPath path of directory
+ * @return boolean result
+ */
+static bool batchAddDirectory(SrixBatchFiles *files, const char *directoryPath) {
+    DIR *directory = opendir(directoryPath);
+    if (!directory) {
+        return false;
+    }
+
+    bool result = true;
+    char path[PATH_MAX];
+    struct dirent *entry;
+    while (result && (entry = readdir(directory))) {
+        struct stat info;
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", directoryPath, entry->d_name);
+        if (stat(path, &info) == 0 && S_ISREG(info.st_mode)) {
+            result = batchAddFile(files, path);
+        }
+    }
+
+    closedir(directory);
+    return result;
+}
+
+bool SrixBatchExpand(SrixBatchFiles files[static 1], char *const inputs[], size_t count) {
+    bool result = true;
+
+    for (size_t i = 0; i < count; i++) {
+        bool added = true;
+        struct stat info;
+        if (stat(inputs[i], &info) == 0) {
+            added = S_ISDIR(info.st_mode) ? batchAddDirectory(files, inputs[i]) : batchAddFile(files, inputs[i]);
+        } else {
+            /* Not an existing path, try it as a pattern */
+            glob_t matches;
+            if (glob(inputs[i], 0, (void *) 0, &matches) == 0) {
+                for (size_t j = 0; j < matches.gl_pathc && added; j++) {
+                    added = batchAddFile(files, matches.gl_pathv[j]);
+                }
+            } else {
+                fprintf(stderr, "No dump files found for %s\n", inputs[i]);
+            }
+            globfree(&matches);
+        }
+
+        if (!added) {
+            fprintf(stderr, "Unable to list dump files of %s\n", inputs[i]);
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Get the file name of a path.
+ * @param path file path
+ * @return pointer to the name in path
+ */
+static const char *batchFileName(const char *path) {
+    const char *name = strrchr(path, '/');
+    return name ? name + 1 : path;
+}
+
+/**
+ * Compare two file names, and then their index in the file list.
+ */
+static int batchCompareNames(const void *first, const void *second) {
+    const BatchName *a = first;
+    const BatchName *b = second;
+
+    int names = strcmp(a->name, b->name);
+    return names ? names : (a->index > b->index) - (a->index < b->index);
+}
+
+/**
+ * Count, for every file, the previous files with the same name, so their outputs don't overwrite each other.
+ * @param files file list
+ * @return array with a counter for every file, null if there is an error
+ */
+static size_t *batchSequences(const SrixBatchFiles *files) {
+    BatchName *names = malloc((files->count ? files->count : 1) * sizeof(BatchName));
+    size_t *sequences = malloc((files->count ? files->count : 1) * sizeof(size_t));
+    if (!names || !sequences) {
+        free(names);
+        free(sequences);
+        return (void *) 0;
+    }
+
+    for (size_t i = 0; i < files->count; i++) {
+        names[i] = (BatchName) {.name = batchFileName(files->paths[i]), .index = i};
+    }
+    qsort(names, files->count, sizeof(BatchName), batchCompareNames);
+
+    for (size_t i = 0; i < files->count; i++) {
+        bool repeated = i > 0 && strcmp(names[i].name, names[i - 1].name) == 0;
+        sequences[names[i].index] = repeated ? sequences[names[i - 1].index] + 1 : 0;
+    }
+
+    free(names);
+    return sequences;
+}
+
+/**
+ * Check the integrity of a single dump file, printing its layout.
+ * @param path path of dump file
+ * @return SrixError result
+ */
+static SrixError batchVerifyFile(const char *path) {
+    FILE *input = fopen(path, "rb");
+    if (!input) {
+        return SRIX_ERROR(SRIX_ERROR, "unable to open dump file");
+    }
+
+    /* A byte more detects longer files */
+    uint8_t dump[SRIX_DUMP_EXTENDED_LENGTH + 1];
+    size_t length = fread(dump, sizeof(uint8_t), sizeof(dump), input);
+    fclose(input);
+
+    if (length < SRIX_DUMP_LENGTH) {
+        return SRIX_ERROR(SRIX_ERROR, "incorrect dump file length");
+    }
+
+    SrixError error = SrixDumpVerify(dump, length);
+    if (SRIX_IS_ERROR(error)) {
+        return error;
+    }
+
+    /* Whole line printed with a single write, to avoid mixing output of different workers */
+    char line[PATH_MAX + 64];
+    int lineLength = snprintf(line, sizeof(line), "%s: %s\n", path,
+                              length == SRIX_DUMP_LENGTH ? "raw dump, no checksum" : "extended dump, checksum ok");
+    return SrixOutputWriteAll(STDOUT_FILENO, line,
+                              lineLength < (int) sizeof(line) ? (size_t) lineLength : sizeof(line) - 1);
+}
+
+/**
+ * Apply batch operations to a single dump file.
+ * @param srix Srix of worker
+ * @param path path of dump file
+ * @param sequence number of previous files with the same name
+ * @param options operations to apply
+ * @return SrixError result
+ */
+static SrixError batchProcessFile(Srix *srix, const char *path, size_t sequence, const SrixBatchOptions *options) {
+    if (options->verify) {
+        return batchVerifyFile(path);
+    }
+
+    uint32_t eeprom[SRIX4K_BLOCKS];
+    uint64_t uid;
+
+    SrixError error = SrixDumpLoad(path, eeprom, &uid);
+    if (SRIX_IS_ERROR(error)) {
+        return error;
+    }
+    SrixMemoryInit(srix, eeprom, uid);
+
+    if (options->resetOTP && SrixResetOtp(srix) != SRIX_SUCCESS) {
+        return SrixGetLatestError(srix);
+    }
+
+    for (size_t i = 0; i < options->editsCount; i++) {
+        SrixModifyBlock(srix, options->edits[i].value, options->edits[i].block);
+    }
+
+    for (uint8_t i = 0; i < SRIX4K_BLOCKS; i++) {
+        eeprom[i] = *SrixGetBlock(srix, i);
+    }
+
+    if (options->print) {
+        /* Whole dump printed with a single write, to avoid mixing output of different workers */
+        char buffer[BATCH_PRINT_SIZE];
+        size_t length = 0;
+        if (options->format == SRIX_OUTPUT_TEXT) {
+            int prefix = snprintf(buffer, PATH_MAX + 2, "%s: ", path);
+            length = prefix < PATH_MAX + 2 ? (size_t) prefix : PATH_MAX + 1;
+        }
+        length += SrixOutputEncode(options->format, uid, eeprom, buffer + length);
+        error = SrixOutputWriteAll(STDOUT_FILENO, buffer, length);
+        if (SRIX_IS_ERROR(error)) {
+            return error;
+        }
+    }
+
+    if (options->outputDirectory) {
+        const char *name = batchFileName(path);
+        char outputPath[PATH_MAX];
+
+        /* Files with the same name from different directories get a sequence number before the extension */
+        const char *extension = strrchr(name, '.');
+        int nameLength = extension && extension != name ? (int) (extension - name) : (int) strlen(name);
+        if (sequence) {
+            snprintf(outputPath, sizeof(outputPath), "%s/%.*s-%zu%s", options->outputDirectory, nameLength, name,
+                     sequence, name + nameLength);
+        } else {
+            snprintf(outputPath, sizeof(outputPath), "%s/%s", options->outputDirectory, name);
+        }
+
+        error = options->rawDumps ? SrixDumpSaveRaw(outputPath, eeprom, uid) : SrixDumpSave(outputPath, eeprom, uid);
+    }
+
+    return error;
+}
+
+/**
+ * Worker thread: process files until the list is empty.
+ * @param arg pointer to BatchState
+ * @return null
+ */
+static void *batchWorker(void *arg) {
+    BatchState *state = arg;
+
+    /* Srix used only in memory, NFC is never initialized */
+    Srix *srix = SrixNew((void *) 0);
+    if (!srix) {
+        return (void *) 0;
+    }
+
+    size_t index;
+    while ((index = atomic_fetch_add(&state->next, 1)) < state->files->count) {
+        const char *path = state->files->paths[index];
+
+        size_t sequence = state->sequences ? state->sequences[index] : 0;
+        SrixError error = batchProcessFile(srix, path, sequence, state->options);
+        if (SRIX_IS_ERROR(error)) {
+            atomic_fetch_add(&state->failed, 1);
+            fprintf(stderr, "%s: %s\n", path, error.message);
+        }
+    }
+
+    SrixDelete(srix);
+    return (void *) 0;
+}
+
+SrixBatchReport SrixBatchRun(char *const inputs[], size_t count, const SrixBatchOptions options[static 1]) {
+    SrixBatchReport report = {0};
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    SrixBatchFiles files = {0};
+    report.incomplete = !SrixBatchExpand(&files, inputs, count);
+
+    size_t *sequences = (void *) 0;
+    if (options->outputDirectory) {
+        sequences = batchSequences(&files);
+        if (!sequences) {
+            fprintf(stderr, "Unable to allocate memory for output names\n");
+            report.files = files.count;
+            report.failed = files.count;
+            SrixBatchFree(&files);
+            return report;
+        }
+    }
+
+    BatchState state = {.files = &files, .options = options, .sequences = sequences};
+    atomic_init(&state.next, 0);
+    atomic_init(&state.failed, 0);
+
+    /* One worker for every CPU, but not more than files */
+    size_t threads = options->threads;
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (size_t) cpus : 1;
+    }
+    if (threads > files.count) {
+        threads = files.count;
+    }
+
+    pthread_t *workers = malloc((threads ? threads : 1) * sizeof(pthread_t));
+    size_t started = 0;
+    if (workers) {
+        for (; started < threads; started++) {
+            if (pthread_create(&workers[started], (void *) 0, batchWorker, &state) != 0) {
+                break;
+            }
+        }
+    }
+
+    /* Without workers, process files in this thread */
+    if (started == 0) {
+        batchWorker(&state);
+    }
+
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(workers[i], (void *) 0);
+    }
+    free(workers);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    report.files = files.count;
+    report.failed = atomic_load(&state.failed);
+    report.threads = started ? started : 1;
+    report.seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    free(sequences);
+    SrixBatchFree(&files);
+    return report;
+}
+
+void SrixBatchFree(SrixBatchFiles files[static 1]) {
+    for (size_t i = 0; i < files->count; i++) {
+        free(files->paths[i]);
+    }
+    free(files->paths);
+    *files = (SrixBatchFiles) {0};
+}
@@ -0,0 +1,78 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "error.h"
+#include "output.h"
+
+/**
+ * New value of a single block.
+ */
+typedef struct SrixBlockEdit {
+    uint8_t block;                    /* block to modify */
+    uint32_t value;                   /* new block value */
+} SrixBlockEdit;
+
+/**
+ * Operations applied to every dump of a batch.
+ */
+typedef struct SrixBatchOptions {
+    bool resetOTP;                    /* reset OTP blocks */
+    bool print;                       /* print UID and EEPROM of every dump */
+    SrixOutputFormat format;          /* format of printed dumps, text ones start with the file path */
+    const SrixBlockEdit *edits;       /* blocks to modify, applied after OTP reset */
+    size_t editsCount;                /* number of block edits */
+    const char *outputDirectory;      /* where save processed dumps, null to not save them */
+    bool rawDumps;                    /* save raw dumps, without checksum */
+    bool verify;                      /* only check dumps, printing their layout, other operations are ignored */
+    size_t threads;                   /* worker threads, 0 = one for every online CPU */
+} SrixBatchOptions;
+
+/**
+ * List of dump files.
+ */
+typedef struct SrixBatchFiles {
+    char **paths;                     /* file paths */
+    size_t count;                     /* number of files */
+    size_t capacity;                  /* allocated paths */
+} SrixBatchFiles;
+
+/**
+ * Result of a batch.
+ */
+typedef struct SrixBatchReport {
+    size_t files;                     /* processed files */
+    size_t failed;                    /* files with an error */
+    bool incomplete;                  /* some inputs couldn't be listed */
+    size_t threads;                   /* used worker threads */
+    double seconds;                   /* elapsed time */
+} SrixBatchReport;
+
+/**
+ * Process many dump files in parallel, without NFC.
+ * Outputs of files with the same name get a sequence number before the extension, in input order.
+ * @param inputs dump files, directories (all their files) or glob patterns
+ * @param count number of inputs
+ * @param options operations to apply to every dump
+ * @return batch report
+ */
+SrixBatchReport SrixBatchRun(char *const inputs[], size_t count, const SrixBatchOptions *options);
+
+/**
+ * Expand inputs to a list of dump files.
+ * @param files pointer to file list, zero initialized or with files to keep
+ * @param inputs dump files, directories (all their files) or glob patterns
+ * @param count number of inputs
+ * @return false if some files couldn't be added, the others are in the list
+ */
+bool SrixBatchExpand(SrixBatchFiles *files, char *const inputs[], size_t count);
+
+/**
+ * Free the paths of a file list.
+ * @param files pointer to file list
+ */
+void SrixBatchFree(SrixBatchFiles *files);
+
+#endif /* BATCH_H */
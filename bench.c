@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
+#include <poll.h>
+#include "async.h"
+#include "crc32c.h"
+#include "dump.h"
+#include "emulator.h"
+#include "srix.h"
+
+#define BENCH_DEFAULT_ITERATIONS  200
+#define BENCH_SPARSE_BLOCKS       4
+#define BENCH_EMULATED_UID        0xD002000012345678U
+
+/**
+ * Operation measured by a benchmark, it returns the number of blocks transferred or -1 on error.
+ */
+typedef int (*BenchOperation)(Srix *srix, SrixEmulator *emulator, unsigned long iteration);
+
+/**
+ * Result of a benchmark.
+ */
+typedef struct BenchResult {
+    uint64_t *nanos;                  /* duration of every successful operation */
+    unsigned long operations;         /* successful operations */
+    unsigned long failed;             /* failed operations */
+    uint64_t blocks;                  /* blocks transferred by successful operations */
+    uint64_t roundTrips;              /* radio round trips of all operations */
+    uint64_t totalNanos;              /* duration of all operations */
+} BenchResult;
+
+/* Temporary dump file of file benchmark */
+static char dumpFile[] = "/tmp/srix-bench-XXXXXX";
+
+/* Asynchronous runner of async read benchmark */
+static SrixAsync *async = (void *) 0;
+
+
+/**
+ * Print help message.
+ * @param executable name of executable
+ */
+static void printUsage(const char *executable) {
+    printf("Usage: %s [-h] [-n iterations] [-l micros] [-d percent] [-c percent] [-v mode]\n\n", executable);
+    printf("Benchmark SRIX4K reads, writes and dump files against an emulated tag.\n\n");
+    printf("Options:\n");
+    printf("  -h        show this help message\n");
+    printf("  -n num    iterations of every benchmark (default %d)\n", BENCH_DEFAULT_ITERATIONS);
+    printf("  -l num    latency of every emulated frame in microseconds (default 0)\n");
+    printf("  -d num    percentage of dropped frames (default 0)\n");
+    printf("  -c num    percentage of corrupted frames (default 0)\n");
+    printf("  -v mode   verification of written blocks: block (default), full, sampled, final\n");
+}
+
+
+/**
+ * Get current time in nanoseconds from a monotonic clock.
+ * @return time in nanoseconds
+ */
+static uint64_t monotonicNanos() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000U + (uint64_t) now.tv_nsec;
+}
+
+
+/**
+ * Parse verification mode name.
+ * @param name name of verification mode
+ * @param mode pointer where save parsed mode
+ * @return boolean result
+ */
+static bool parseVerifyMode(const char *name, SrixVerifyMode *mode) {
+    static const char *const names[] = {
+            [SRIX_VERIFY_BLOCK] = "block",
+            [SRIX_VERIFY_FULL] = "full",
+            [SRIX_VERIFY_SAMPLED] = "sampled",
+            [SRIX_VERIFY_FINAL] = "final"
+    };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *mode = (SrixVerifyMode) i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ * Read the whole emulated tag.
+ */
+static int benchFullRead(Srix *srix, SrixEmulator *emulator, unsigned long iteration) {
+    (void) emulator;
+    (void) iteration;
+    return SrixNfcNextTag(srix, false) ? -1 : SRIX4K_BLOCKS;
+}
+
+
+/**
+ * Modify some generic blocks and write them.
+ */
+static int benchSparseWrite(Srix *srix, SrixEmulator *emulator, unsigned long iteration) {
+    (void) emulator;
+    for (uint8_t i = 0; i < BENCH_SPARSE_BLOCKS; i++) {
+        uint8_t blockNum = 16 + (iteration * 7 + i * 29) % (SRIX4K_BLOCKS - 16);
+        SrixModifyBlock(srix, *SrixGetBlock(srix, blockNum) + 1, blockNum);
+    }
+
+    uint8_t blocks = SrixGetDirtyBlocks(srix);
+    return SrixWriteBlocks(srix) != SRIX_SUCCESS ? -1 : blocks;
+}
+
+
+/**
+ * Modify all generic blocks and write them.
+ */
+static int benchFullWrite(Srix *srix, SrixEmulator *emulator, unsigned long iteration) {
+    (void) emulator;
+    for (uint8_t i = 16; i < SRIX4K_BLOCKS; i++) {
+        SrixModifyBlock(srix, (uint32_t) (iteration << 8U | i), i);
+    }
+
+    uint8_t blocks = SrixGetDirtyBlocks(srix);
+    return SrixWriteBlocks(srix) != SRIX_SUCCESS ? -1 : blocks;
+}
+
+
+/**
+ * Save the tag in a dump file and load it again.
+ */
+static int benchDumpFile(Srix *srix, SrixEmulator *emulator, unsigned long iteration) {
+    (void) emulator;
+    (void) iteration;
+    uint32_t eeprom[SRIX4K_BLOCKS];
+    uint64_t uid;
+
+    for (uint8_t i = 0; i < SRIX4K_BLOCKS; i++) {
+        eeprom[i] = *SrixGetBlock(srix, i);
+    }
+
+    if (SRIX_IS_ERROR(SrixDumpSave(dumpFile, eeprom, SrixGetUid(srix))) ||
+        SRIX_IS_ERROR(SrixDumpLoad(dumpFile, eeprom, &uid))) {
+        return -1;
+    }
+
+    return SRIX4K_BLOCKS;
+}
+
+
+/**
+ * Encode the tag as extended dump in memory and verify its checksum.
+ */
+static int benchDumpChecksum(Srix *srix, SrixEmulator *emulator, unsigned long iteration) {
+    (void) emulator;
+    uint32_t eeprom[SRIX4K_BLOCKS];
+    uint8_t dump[SRIX_DUMP_EXTENDED_LENGTH];
+
+    for (uint8_t i = 0; i < SRIX4K_BLOCKS; i++) {
+        eeprom[i] = *SrixGetBlock(srix, i) ^ (uint32_t) iteration;
+    }
+
+    SrixDumpEncodeExtended(eeprom, SrixGetUid(srix), dump);
+    return SRIX_IS_ERROR(SrixDumpVerify(dump, sizeof(dump))) ? -1 : SRIX4K_BLOCKS;
+}
+
+
+/**
+ * Read the whole emulated tag with the asynchronous API, waiting for completion with poll().
+ */
+static int benchAsyncRead(Srix *srix, SrixEmulator *emulator, unsigned long iteration) {
+    (void) srix;
+    (void) emulator;
+    (void) iteration;
+    SrixError result;
+
+    if (!SrixAsyncBeginRead(async)) {
+        return -1;
+    }
+
+    struct pollfd completion = {.fd = SrixAsyncGetFd(async), .events = POLLIN};
+    while (!SrixAsyncFinish(async, &result)) {
+        poll(&completion, 1, -1);
+    }
+
+    return SRIX_IS_ERROR(result) ? -1 : SRIX4K_BLOCKS;
+}
+
+
+/**
+ * Compare two durations for qsort.
+ */
+static int compareNanos(const void *first, const void *second) {
+    const uint64_t a = *(const uint64_t *) first;
+    const uint64_t b = *(const uint64_t *) second;
+    return (a > b) - (a < b);
+}
+
+
+/**
+ * Get a percentile of sorted durations.
+ * @param result pointer to benchmark result with sorted durations
+ * @param percentile percentile to get (0-100)
+ * @return duration in microseconds
+ */
+static double percentileMicros(const BenchResult *result, unsigned percentile) {
+    if (result->operations == 0) {
+        return 0;
+    }
+
+    size_t index = (result->operations - 1) * percentile / 100;
+    return (double) result->nanos[index] / 1e3;
+}
+
+
+/**
+ * Run a benchmark and print its result.
+ * @param name name of benchmark
+ * @param operation operation to measure
+ * @param srix Srix connected to the emulated tag
+ * @param emulator emulated tag
+ * @param iterations number of operations
+ * @param selectsTag true if the operation selects the tag again, resetting round trips
+ * @return false if an operation failed
+ */
+static bool runBenchmark(const char *name, BenchOperation operation, Srix *srix, SrixEmulator *emulator,
+                         unsigned long iterations, bool selectsTag) {
+    BenchResult result = {.nanos = malloc((iterations ? iterations : 1) * sizeof(uint64_t))};
+    if (!result.nanos) {
+        fprintf(stderr, "Unable to allocate memory for %s\n", name);
+        return false;
+    }
+
+    for (unsigned long i = 0; i < iterations; i++) {
+        uint32_t roundTrips = selectsTag ? 0 : SrixGetRoundTrips(srix);
+        uint64_t start = monotonicNanos();
+
+        int blocks = operation(srix, emulator, i);
+
+        uint64_t elapsed = monotonicNanos() - start;
+        result.totalNanos += elapsed;
+
+        result.roundTrips += SrixGetRoundTrips(srix) - roundTrips;
+
+        if (blocks < 0) {
+            result.failed++;
+            SrixGetLatestError(srix);
+        } else {
+            result.nanos[result.operations++] = elapsed;
+            result.blocks += blocks;
+        }
+    }
+
+    qsort(result.nanos, result.operations, sizeof(uint64_t), compareNanos);
+
+    double seconds = (double) result.totalNanos / 1e9;
+    printf("%-14s %8lu %6lu %10.1f %11.1f %9.1f %9.1f %9.1f %9.1f %8.1f\n", name, result.operations,
+           result.failed, seconds > 0 ? (double) result.operations / seconds : 0,
+           seconds > 0 ? (double) result.blocks / seconds : 0, percentileMicros(&result, 50),
+           percentileMicros(&result, 90), percentileMicros(&result, 99), percentileMicros(&result, 100),
+           iterations ? (double) result.roundTrips / iterations : 0);
+
+    free(result.nanos);
+    return result.failed == 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    unsigned long iterations = BENCH_DEFAULT_ITERATIONS;
+    SrixEmulatorConfig config = {0};
+    SrixVerifyMode verifyMode = SRIX_VERIFY_BLOCK;
+
+    /* Parse input arguments */
+    int param;
+    while ((param = getopt(argc, argv, "hn:l:d:c:v:")) != -1) {
+        switch (param) {
+            case 'h':
+                printUsage(argv[0]);
+                return EXIT_SUCCESS;
+            case 'n':
+                iterations = strtoul(optarg, (void *) 0, 10);
+                break;
+            case 'l':
+                config.latencyMicros = strtoul(optarg, (void *) 0, 10);
+                break;
+            case 'd':
+                config.dropPercent = strtoul(optarg, (void *) 0, 10);
+                break;
+            case 'c':
+                config.corruptPercent = strtoul(optarg, (void *) 0, 10);
+                break;
+            case 'v':
+                if (!parseVerifyMode(optarg, &verifyMode)) {
+                    fprintf(stderr, "Invalid verification mode: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                printUsage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    /* Emulated tag with a recognizable EEPROM */
+    uint32_t eeprom[SRIX4K_BLOCKS];
+    for (uint8_t i = 0; i < SRIX4K_BLOCKS; i++) {
+        eeprom[i] = 0x01010101U * i;
+    }
+    eeprom[5] = eeprom[6] = UINT32_MAX;
+
+    static SrixEmulator emulator;
+    SrixEmulatorInit(&emulator, eeprom, BENCH_EMULATED_UID, config);
+
+    /* Emulated tag doesn't need a libnfc context */
+    Srix *srix = SrixNew((void *) 0);
+    if (!srix) {
+        fprintf(stderr, "Unable to allocate memory for srix\n");
+        return EXIT_FAILURE;
+    }
+    SrixSetVerifyMode(srix, verifyMode);
+
+    const char *error = SrixNfcOpenTransport(srix, &SRIX_EMULATOR_TRANSPORT, &emulator);
+    if (!error) {
+        error = SrixNfcNextTag(srix, false);
+    }
+    if (error) {
+        fprintf(stderr, "Unable to read emulated tag: %s\n", error);
+        SrixDelete(srix);
+        return EXIT_FAILURE;
+    }
+
+    int file = mkstemp(dumpFile);
+    if (file < 0) {
+        fprintf(stderr, "Unable to create temporary dump file\n");
+        SrixDelete(srix);
+        return EXIT_FAILURE;
+    }
+    close(file);
+
+    printf("%lu iterations, %" PRIu32 " us frame latency, %" PRIu8 "%% dropped, %" PRIu8 "%% corrupted frames, "
+           "%s CRC32C\n\n", iterations, config.latencyMicros, config.dropPercent, config.corruptPercent,
+           SrixCrc32cImplementation());
+    printf("%-14s %8s %6s %10s %11s %9s %9s %9s %9s %8s\n", "benchmark", "ops", "failed", "ops/s", "blocks/s",
+           "p50 us", "p90 us", "p99 us", "max us", "trips");
+
+    bool result = runBenchmark("full read", benchFullRead, srix, &emulator, iterations, true);
+    result &= runBenchmark("sparse write", benchSparseWrite, srix, &emulator, iterations, false);
+    result &= runBenchmark("full write", benchFullWrite, srix, &emulator, iterations, false);
+    result &= runBenchmark("dump file", benchDumpFile, srix, &emulator, iterations, false);
+    result &= runBenchmark("dump checksum", benchDumpChecksum, srix, &emulator, iterations, false);
+
+    /* Asynchronous reads use their own Srix, the runner owns it until it's deleted */
+    Srix *asyncSrix = SrixNew((void *) 0);
+    if (asyncSrix && !SrixNfcOpenTransport(asyncSrix, &SRIX_EMULATOR_TRANSPORT, &emulator) &&
+        (async = SrixAsyncNew(asyncSrix, (void *) 0, (void *) 0))) {
+        SrixSetVerifyMode(asyncSrix, verifyMode);
+        result &= runBenchmark("async read", benchAsyncRead, asyncSrix, &emulator, iterations, true);
+        SrixAsyncDelete(async);
+    } else {
+        fprintf(stderr, "Unable to start asynchronous runner\n");
+        result = false;
+    }
+
+    if (asyncSrix) {
+        SrixDelete(asyncSrix);
+    }
+    unlink(dumpFile);
+    SrixDelete(srix);
+    return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,426 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "cache.h"
+#include "dump.h"
+
+/* Cache entry name: 16 hex digits of UID and extension */
+#define CACHE_EXTENSION    ".srix"
+#define CACHE_NAME_LENGTH  (16 + sizeof(CACHE_EXTENSION))
+
+/* Slot that doesn't exist, ends of the LRU list and empty hash buckets */
+#define CACHE_NONE  SIZE_MAX
+
+/**
+ * Entry of the cache index, linked in least recently used order.
+ */
+typedef struct CacheEntry {
+    uint64_t uid;                       /* UID of tag */
+    size_t older;                       /* slot of the previous used entry, CACHE_NONE for the oldest */
+    size_t newer;                       /* slot of the next used entry, CACHE_NONE for the newest */
+} CacheEntry;
+
+/**
+ * Dump file found in the cache directory.
+ */
+typedef struct CacheFile {
+    uint64_t uid;                       /* UID of tag */
+    uint64_t lastUse;                   /* modification time in nanoseconds */
+} CacheFile;
+
+/**
+ * Dump cache in a directory.
+ * Entries are found by UID with an open addressing hash table of their slots.
+ */
+struct SrixCache {
+    char *directory;                    /* cache directory path */
+    size_t maxEntries;                  /* maximum number of dumps */
+    CacheEntry *entries;                /* dumps in the directory, null until the first store */
+    size_t count;                       /* number of dumps in index */
+    size_t capacity;                    /* allocated index entries */
+    size_t *buckets;                    /* hash table of entry slots, twice the capacity */
+    size_t oldest;                      /* slot of the least recently used entry */
+    size_t newest;                      /* slot of the most recently used entry */
+};
+
+/**
+ * Build path of a cache entry.
+ * @param cache pointer to SrixCache
+ * @param uid UID of tag
+ * @param path buffer where save path
+ * @param size size of path buffer
+ */
+static void cachePath(SrixCache *cache, uint64_t uid, char *path, size_t size) {
+    snprintf(path, size, "%s/%016" PRIX64 CACHE_EXTENSION, cache->directory, uid);
+}
+
+/**
+ * Check if a directory entry is a cache dump.
+ * @param name name of directory entry
+ * @return true if it's a cache dump
+ */
+static bool cacheIsEntry(const char *name) {
+    size_t length = strlen(name);
+    return length == CACHE_NAME_LENGTH - 1 && strcmp(name + 16, CACHE_EXTENSION) == 0;
+}
+
+/**
+ * Get the first bucket of the probe sequence of a UID.
+ * @param cache pointer to SrixCache with an allocated index
+ * @param uid UID of tag
+ * @return bucket position
+ */
+static inline size_t cacheHome(const SrixCache *cache, uint64_t uid) {
+    return (size_t) (uid * 0x9E3779B97F4A7C15U >> 32U) & (cache->capacity * 2 - 1);
+}
+
+/**
+ * Get the hash bucket of a UID, or the empty bucket where it would be inserted.
+ * @param cache pointer to SrixCache with an allocated index
+ * @param uid UID of tag
+ * @return bucket position
+ */
+static size_t cacheBucket(const SrixCache *cache, uint64_t uid) {
+    const size_t mask = cache->capacity * 2 - 1;
+    size_t bucket = cacheHome(cache, uid);
+
+    while (cache->buckets[bucket] != CACHE_NONE && cache->entries[cache->buckets[bucket]].uid != uid) {
+        bucket = (bucket + 1) & mask;
+    }
+
+    return bucket;
+}
+
+/**
+ * Find a dump in the index.
+ * @param cache pointer to SrixCache
+ * @param uid UID of tag
+ * @return slot of dump, CACHE_NONE if it isn't in the index
+ */
+static size_t cacheIndexFind(const SrixCache *cache, uint64_t uid) {
+    return cache->buckets ? cache->buckets[cacheBucket(cache, uid)] : CACHE_NONE;
+}
+
+/**
+ * Remove an entry from the LRU list.
+ * @param cache pointer to SrixCache
+ * @param slot slot of entry
+ */
+static void cacheUnlink(SrixCache *cache, size_t slot) {
+    const CacheEntry *entry = &cache->entries[slot];
+    *(entry->older != CACHE_NONE ? &cache->entries[entry->older].newer : &cache->oldest) = entry->newer;
+    *(entry->newer != CACHE_NONE ? &cache->entries[entry->newer].older : &cache->newest) = entry->older;
+}
+
+/**
+ * Mark an entry as the most recently used one.
+ * @param cache pointer to SrixCache
+ * @param slot slot of entry, not in the LRU list
+ */
+static void cacheLinkNewest(SrixCache *cache, size_t slot) {
+    cache->entries[slot].older = cache->newest;
+    cache->entries[slot].newer = CACHE_NONE;
+    *(cache->newest != CACHE_NONE ? &cache->entries[cache->newest].newer : &cache->oldest) = slot;
+    cache->newest = slot;
+}
+
+/**
+ * Mark a dump of the index as the most recently used one.
+ * @param cache pointer to SrixCache
+ * @param slot slot of entry
+ */
+static void cacheTouch(SrixCache *cache, size_t slot) {
+    if (slot != cache->newest) {
+        cacheUnlink(cache, slot);
+        cacheLinkNewest(cache, slot);
+    }
+}
+
+/**
+ * Grow the index if it's full, the hash table is rebuilt with the new capacity.
+ * @param cache pointer to SrixCache
+ * @return false if there isn't enough memory
+ */
+static bool cacheIndexReserve(SrixCache *cache) {
+    if (cache->entries && cache->count < cache->capacity) {
+        return true;
+    }
+
+    size_t capacity = cache->capacity ? cache->capacity * 2 : 64;
+    CacheEntry *entries = realloc(cache->entries, capacity * sizeof(CacheEntry));
+    if (!entries) {
+        return false;
+    }
+    cache->entries = entries;
+
+    size_t *buckets = malloc(capacity * 2 * sizeof(size_t));
+    if (!buckets) {
+        return false;
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->capacity = capacity;
+
+    for (size_t i = 0; i < capacity * 2; i++) {
+        cache->buckets[i] = CACHE_NONE;
+    }
+    for (size_t i = 0; i < cache->count; i++) {
+        cache->buckets[cacheBucket(cache, cache->entries[i].uid)] = i;
+    }
+    return true;
+}
+
+/**
+ * Add a dump to the index as the most recently used one, growing the index if it's full.
+ * @param cache pointer to SrixCache
+ * @param uid UID of tag, not in the index
+ * @return false if there isn't enough memory
+ */
+static bool cacheIndexAdd(SrixCache *cache, uint64_t uid) {
+    if (!cacheIndexReserve(cache)) {
+        return false;
+    }
+
+    const size_t slot = cache->count++;
+    cache->entries[slot].uid = uid;
+    cache->buckets[cacheBucket(cache, uid)] = slot;
+    cacheLinkNewest(cache, slot);
+    return true;
+}
+
+/**
+ * Remove a dump from the index, the last entry takes its slot.
+ * @param cache pointer to SrixCache
+ * @param slot slot of entry
+ */
+static void cacheIndexRemove(SrixCache *cache, size_t slot) {
+    const size_t mask = cache->capacity * 2 - 1;
+    cacheUnlink(cache, slot);
+
+    /* Shift back the following entries of the probe sequence, so none of them is after a hole */
+    size_t hole = cacheBucket(cache, cache->entries[slot].uid);
+    for (size_t bucket = (hole + 1) & mask; cache->buckets[bucket] != CACHE_NONE; bucket = (bucket + 1) & mask) {
+        size_t home = cacheHome(cache, cache->entries[cache->buckets[bucket]].uid);
+        if (((bucket - home) & mask) >= ((bucket - hole) & mask)) {
+            cache->buckets[hole] = cache->buckets[bucket];
+            hole = bucket;
+        }
+    }
+    cache->buckets[hole] = CACHE_NONE;
+
+    /* Keep slots contiguous */
+    const size_t last = --cache->count;
+    if (slot != last) {
+        const CacheEntry *moved = &cache->entries[last];
+        *(moved->older != CACHE_NONE ? &cache->entries[moved->older].newer : &cache->oldest) = slot;
+        *(moved->newer != CACHE_NONE ? &cache->entries[moved->newer].older : &cache->newest) = slot;
+        cache->buckets[cacheBucket(cache, moved->uid)] = slot;
+        cache->entries[slot] = *moved;
+    }
+}
+
+/**
+ * Compare two dump files by last use.
+ */
+static int cacheCompareUse(const void *first, const void *second) {
+    uint64_t a = ((const CacheFile *) first)->lastUse;
+    uint64_t b = ((const CacheFile *) second)->lastUse;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Build the index from the dumps in the directory, ordered by modification time.
+ * Directory is scanned only once, later stores and removals update the index.
+ * @param cache pointer to SrixCache
+ * @return false if the directory can't be read
+ */
+static bool cacheIndexLoad(SrixCache *cache) {
+    if (cache->entries) {
+        return true;
+    }
+
+    DIR *directory = opendir(cache->directory);
+    if (!directory) {
+        return false;
+    }
+
+    char path[PATH_MAX];
+    struct dirent *entry;
+    CacheFile *files = (void *) 0;
+    size_t count = 0;
+    size_t capacity = 0;
+    bool result = true;
+
+    while (result && (entry = readdir(directory))) {
+        struct stat info;
+        if (!cacheIsEntry(entry->d_name)) {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", cache->directory, entry->d_name);
+        if (stat(path, &info) != 0) {
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            CacheFile *grown = realloc(files, capacity * sizeof(CacheFile));
+            if (!grown) {
+                result = false;
+                continue;
+            }
+            files = grown;
+        }
+
+        /* Modification time is the last use of the entry */
+        files[count++] = (CacheFile) {
+                .uid = strtoull(entry->d_name, (void *) 0, 16),
+                .lastUse = (uint64_t) info.st_mtim.tv_sec * 1000000000U + (uint64_t) info.st_mtim.tv_nsec
+        };
+    }
+    closedir(directory);
+
+    /* An allocated index marks the directory as scanned, even if it's empty */
+    result = result && cacheIndexReserve(cache);
+
+    /* LRU order follows modification times */
+    if (result) {
+        qsort(files, count, sizeof(CacheFile), cacheCompareUse);
+    }
+    for (size_t i = 0; result && i < count; i++) {
+        size_t slot = cacheIndexFind(cache, files[i].uid);
+        if (slot != CACHE_NONE) {
+            cacheTouch(cache, slot);
+        } else {
+            result = cacheIndexAdd(cache, files[i].uid);
+        }
+    }
+    free(files);
+
+    if (!result) {
+        free(cache->entries);
+        free(cache->buckets);
+        cache->entries = (void *) 0;
+        cache->buckets = (void *) 0;
+        cache->count = 0;
+        cache->capacity = 0;
+        cache->oldest = CACHE_NONE;
+        cache->newest = CACHE_NONE;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Remove least recently used dumps while they are more than the limit.
+ * @param cache pointer to SrixCache with a loaded index
+ */
+static void cacheEvict(SrixCache *cache) {
+    char path[PATH_MAX];
+
+    while (cache->count > cache->maxEntries) {
+        cachePath(cache, cache->entries[cache->oldest].uid, path, sizeof(path));
+        remove(path);
+        cacheIndexRemove(cache, cache->oldest);
+    }
+}
+
+SrixCache *SrixCacheNew(const char *directory, size_t maxEntries) {
+    /* Create directory if it doesn't exist */
+    mkdir(directory, 0755);
+
+    struct stat info;
+    if (stat(directory, &info) != 0 || !S_ISDIR(info.st_mode)) {
+        return (void *) 0;
+    }
+
+    SrixCache *created = malloc(sizeof(SrixCache));
+    if (!created) {
+        return (void *) 0;
+    }
+
+    created->directory = strdup(directory);
+    if (!created->directory) {
+        free(created);
+        return (void *) 0;
+    }
+
+    created->maxEntries = maxEntries ? maxEntries : 1;
+    created->entries = (void *) 0;
+    created->count = 0;
+    created->capacity = 0;
+    created->buckets = (void *) 0;
+    created->oldest = CACHE_NONE;
+    created->newest = CACHE_NONE;
+    return created;
+}
+
+void SrixCacheDelete(SrixCache cache[static 1]) {
+    free(cache->entries);
+    free(cache->buckets);
+    free(cache->directory);
+    free(cache);
+}
+
+bool SrixCacheLoad(SrixCache cache[static 1], uint64_t uid, uint32_t eeprom[const static SRIX4K_BLOCKS]) {
+    char path[PATH_MAX];
+    cachePath(cache, uid, path, sizeof(path));
+
+    uint64_t cachedUid;
+    if (SRIX_IS_ERROR(SrixDumpLoad(path, eeprom, &cachedUid)) || cachedUid != uid) {
+        return false;
+    }
+
+    /* Modification time is the last use of the entry, for the index of the next run */
+    utimensat(AT_FDCWD, path, (void *) 0, 0);
+
+    size_t slot = cacheIndexFind(cache, uid);
+    if (slot != CACHE_NONE) {
+        cacheTouch(cache, slot);
+    }
+    return true;
+}
+
+SrixError SrixCacheStore(SrixCache cache[static 1], uint64_t uid, const uint32_t eeprom[const static SRIX4K_BLOCKS]) {
+    char path[PATH_MAX];
+    cachePath(cache, uid, path, sizeof(path));
+
+    SrixError error = SrixDumpSave(path, eeprom, uid);
+    if (SRIX_IS_ERROR(error)) {
+        return error;
+    }
+
+    /* Without an index the cache can't be bounded, but the dump is still valid */
+    if (!cacheIndexLoad(cache)) {
+        return SRIX_NO_ERROR;
+    }
+
+    size_t slot = cacheIndexFind(cache, uid);
+    if (slot != CACHE_NONE) {
+        cacheTouch(cache, slot);
+    } else {
+        cacheIndexAdd(cache, uid);
+    }
+
+    /* First scan can also find a directory already over the limit */
+    cacheEvict(cache);
+    return SRIX_NO_ERROR;
+}
+
+void SrixCacheRemove(SrixCache cache[static 1], uint64_t uid) {
+    char path[PATH_MAX];
+    cachePath(cache, uid, path, sizeof(path));
+
+    remove(path);
+
+    size_t slot = cacheIndexFind(cache, uid);
+    if (slot != CACHE_NONE) {
+        cacheIndexRemove(cache, slot);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "error.h"
+
+#define SRIX_CACHE_DEFAULT_ENTRIES  4096
+#define SRIX_CACHE_VERIFY_SAMPLES   4
+
+typedef struct SrixCache SrixCache;
+
+/**
+ * Open a dump cache saved in a directory, one dump file for every UID.
+ * Least recently used entries are removed when the cache is full.
+ * @param directory path of cache directory, created if it doesn't exist
+ * @param maxEntries maximum number of dumps in cache
+ * @return null if there is an error, else a SrixCache pointer
+ */
+SrixCache *SrixCacheNew(const char *directory, size_t maxEntries);
+
+/**
+ * Close a dump cache and free its memory.
+ * @param cache pointer to SrixCache
+ */
+void SrixCacheDelete(SrixCache *cache);
+
+/**
+ * Search a dump in cache and mark it as recently used.
+ * @param cache pointer to SrixCache
+ * @param uid UID of tag
+ * @param eeprom array where save cached EEPROM
+ * @return true if the dump has been found
+ */
+bool SrixCacheLoad(SrixCache *cache, uint64_t uid, uint32_t eeprom[const static SRIX4K_BLOCKS]);
+
+/**
+ * Save a dump in cache, removing least recently used dumps if it's full.
+ * @param cache pointer to SrixCache
+ * @param uid UID of tag
+ * @param eeprom EEPROM to save
+ * @return SrixError result
+ */
+SrixError SrixCacheStore(SrixCache *cache, uint64_t uid, const uint32_t eeprom[const static SRIX4K_BLOCKS]);
+
+/**
+ * Remove a dump from cache (e.g. when it doesn't match the tag anymore).
+ * @param cache pointer to SrixCache
+ * @param uid UID of tag
+ */
+void SrixCacheRemove(SrixCache *cache, uint64_t uid);
+
+#endif /* CACHE_H */
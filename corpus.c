@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <string.h>
+#include "corpus.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define CORPUS_INITIAL_CAPACITY  1024
+
+/**
+ * Dumps stored by column.
+ * Columns are allocated for whole groups and unused values are zero, so kernels never handle partial groups.
+ */
+struct SrixCorpus {
+    uint32_t *columns[SRIX4K_BLOCKS]; /* values of every block */
+    uint64_t *uids;                   /* UID of every dump */
+    size_t count;                     /* number of dumps */
+    size_t capacity;                  /* allocated dumps, multiple of SRIX_CORPUS_GROUP */
+};
+
+/**
+ * Compare a group of block values with a value.
+ * @param column first value of group
+ * @param value value to search
+ * @param mask bits of values to compare
+ * @return bit i set if (column[i] & mask) == value
+ */
+static uint64_t corpusMatchGroup(const uint32_t column[static SRIX_CORPUS_GROUP], uint32_t value, uint32_t mask) {
+    uint64_t bits = 0;
+
+#if defined(__SSE2__)
+    const __m128i values = _mm_set1_epi32((int) value);
+    const __m128i masks = _mm_set1_epi32((int) mask);
+
+    for (size_t i = 0; i < SRIX_CORPUS_GROUP; i += 4) {
+        __m128i lanes = _mm_loadu_si128((const __m128i *) (column + i));
+        __m128i equal = _mm_cmpeq_epi32(_mm_and_si128(lanes, masks), values);
+        bits |= (uint64_t) _mm_movemask_ps(_mm_castsi128_ps(equal)) << i;
+    }
+#else
+    for (size_t i = 0; i < SRIX_CORPUS_GROUP; i++) {
+        bits |= (uint64_t) ((column[i] & mask) == value) << i;
+    }
+#endif
+
+    return bits;
+}
+
+SrixCorpus *SrixCorpusNew() {
+    return calloc(1, sizeof(SrixCorpus));
+}
+
+void SrixCorpusDelete(SrixCorpus corpus[static 1]) {
+    for (uint8_t i = 0; i < SRIX4K_BLOCKS; i++) {
+        free(corpus->columns[i]);
+    }
+    free(corpus->uids);
+    free(corpus);
+}
+
+/**
+ * Grow all columns of a corpus.
+ * @param corpus pointer to SrixCorpus
+ * @return boolean result
+ */
+static bool corpusGrow(SrixCorpus corpus[static 1]) {
+    size_t capacity = corpus->capacity ? corpus->capacity * 2 : CORPUS_INITIAL_CAPACITY;
+
+    uint64_t *uids = realloc(corpus->uids, capacity * sizeof(uint64_t));
+    if (!uids) {
+        return false;
+    }
+    corpus->uids = uids;
+
+    for (uint8_t i = 0; i < SRIX4K_BLOCKS; i++) {
+        uint32_t *column = realloc(corpus->columns[i], capacity * sizeof(uint32_t));
+        if (!column) {
+            return false;
+        }
+
+        memset(column + corpus->capacity, 0, (capacity - corpus->capacity) * sizeof(uint32_t));
+        corpus->columns[i] = column;
+    }
+
+    /* Capacity is updated only when all columns have been grown */
+    corpus->capacity = capacity;
+    return true;
+}
+
+bool SrixCorpusAdd(SrixCorpus corpus[static 1], const uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid) {
+    if (corpus->count == corpus->capacity && !corpusGrow(corpus)) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < SRIX4K_BLOCKS; i++) {
+        corpus->columns[i][corpus->count] = eeprom[i];
+    }
+    corpus->uids[corpus->count++] = uid;
+
+    return true;
+}
+
+size_t SrixCorpusCount(SrixCorpus corpus[static 1]) {
+    return corpus->count;
+}
+
+uint64_t SrixCorpusUid(SrixCorpus corpus[static 1], size_t index) {
+    return corpus->uids[index];
+}
+
+const uint32_t *SrixCorpusColumn(SrixCorpus corpus[static 1], uint8_t block) {
+    return corpus->columns[block];
+}
+
+void SrixCorpusSelectAll(SrixCorpus corpus[static 1], uint64_t selection[static 1]) {
+    size_t words = SRIX_CORPUS_WORDS(corpus->count);
+    for (size_t i = 0; i < words; i++) {
+        selection[i] = UINT64_MAX;
+    }
+
+    /* Dumps after the last one are never selected */
+    if (corpus->count % SRIX_CORPUS_GROUP) {
+        selection[words - 1] = (UINT64_C(1) << (corpus->count % SRIX_CORPUS_GROUP)) - 1;
+    }
+}
+
+size_t SrixCorpusScan(SrixCorpus corpus[static 1], uint8_t block, uint32_t value, uint32_t mask,
+                      uint64_t selection[static 1]) {
+    const uint32_t *column = corpus->columns[block];
+    size_t words = SRIX_CORPUS_WORDS(corpus->count);
+    size_t selected = 0;
+
+    value &= mask;
+    for (size_t i = 0; i < words; i++) {
+        if (selection[i]) {
+            selection[i] &= corpusMatchGroup(column + i * SRIX_CORPUS_GROUP, value, mask);
+            selected += __builtin_popcountll(selection[i]);
+        }
+    }
+
+    return selected;
+}
+
+void SrixCorpusDiff(SrixCorpus corpus[static 1], const uint32_t template[const static SRIX4K_BLOCKS],
+                    const uint64_t selection[static 1], uint64_t counts[const static SRIX4K_BLOCKS],
+                    uint64_t *different) {
+    size_t words = SRIX_CORPUS_WORDS(corpus->count);
+    if (different) {
+        memset(different, 0, words * sizeof(uint64_t));
+    }
+
+    for (uint8_t block = 0; block < SRIX4K_BLOCKS; block++) {
+        const uint32_t *column = corpus->columns[block];
+        counts[block] = 0;
+
+        for (size_t i = 0; i < words; i++) {
+            if (selection[i]) {
+                uint64_t differ = ~corpusMatchGroup(column + i * SRIX_CORPUS_GROUP, template[block], UINT32_MAX) &
+                                  selection[i];
+                counts[block] += __builtin_popcountll(differ);
+                if (different) {
+                    different[i] |= differ;
+                }
+            }
+        }
+    }
+}
+
+void SrixCorpusHistogram(SrixCorpus corpus[static 1], uint8_t block, uint8_t shift, const uint64_t selection[static 1],
+                         uint64_t bins[const static 256]) {
+    /* Four partial histograms, so consecutive equal values don't wait for each other */
+    uint64_t partial[4][256] = {{0}};
+    const uint32_t *column = corpus->columns[block];
+    size_t words = SRIX_CORPUS_WORDS(corpus->count);
+
+    for (size_t i = 0; i < words; i++) {
+        const uint32_t *group = column + i * SRIX_CORPUS_GROUP;
+
+        if (selection[i] == UINT64_MAX) {
+            for (size_t j = 0; j < SRIX_CORPUS_GROUP; j += 4) {
+                partial[0][(uint8_t) (group[j] >> shift)]++;
+                partial[1][(uint8_t) (group[j + 1] >> shift)]++;
+                partial[2][(uint8_t) (group[j + 2] >> shift)]++;
+                partial[3][(uint8_t) (group[j + 3] >> shift)]++;
+            }
+        } else {
+            for (uint64_t bits = selection[i]; bits; bits &= bits - 1) {
+                partial[0][(uint8_t) (group[__builtin_ctzll(bits)] >> shift)]++;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < 256; i++) {
+        bins[i] = partial[0][i] + partial[1][i] + partial[2][i] + partial[3][i];
+    }
+}
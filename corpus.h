@@ -0,0 +1,109 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "error.h"
+
+/**
+ * Dumps are stored in groups of 64, one selection word for every group.
+ */
+#define SRIX_CORPUS_GROUP  64
+
+/**
+ * Number of selection words needed for count dumps.
+ */
+#define SRIX_CORPUS_WORDS(count)  (((count) + SRIX_CORPUS_GROUP - 1) / SRIX_CORPUS_GROUP)
+
+/**
+ * Many dumps stored by column: every block has an array with its value in all dumps.
+ * Queries work on a selection bitmap, bit i of word i / 64 is set when dump i is selected.
+ */
+typedef struct SrixCorpus SrixCorpus;
+
+/**
+ * Create an empty corpus.
+ * @return null if there is an error, else a SrixCorpus pointer
+ */
+SrixCorpus *SrixCorpusNew();
+
+/**
+ * Free the memory of a corpus.
+ * @param corpus pointer to SrixCorpus
+ */
+void SrixCorpusDelete(SrixCorpus *corpus);
+
+/**
+ * Add a dump to a corpus.
+ * @param corpus pointer to SrixCorpus
+ * @param eeprom EEPROM blocks of dump
+ * @param uid UID of dump
+ * @return boolean result
+ */
+bool SrixCorpusAdd(SrixCorpus *corpus, const uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid);
+
+/**
+ * Get the number of dumps of a corpus.
+ * @param corpus pointer to SrixCorpus
+ * @return number of dumps
+ */
+size_t SrixCorpusCount(SrixCorpus *corpus);
+
+/**
+ * Get the UID of a dump.
+ * @param corpus pointer to SrixCorpus
+ * @param index index of dump
+ * @return UID of dump
+ */
+uint64_t SrixCorpusUid(SrixCorpus *corpus, size_t index);
+
+/**
+ * Get a block column, with the value of the block in all dumps.
+ * @param corpus pointer to SrixCorpus
+ * @param block index of block
+ * @return block column, valid until next SrixCorpusAdd
+ */
+const uint32_t *SrixCorpusColumn(SrixCorpus *corpus, uint8_t block);
+
+/**
+ * Select all dumps of a corpus.
+ * @param corpus pointer to SrixCorpus
+ * @param selection selection bitmap of SRIX_CORPUS_WORDS(count) words
+ */
+void SrixCorpusSelectAll(SrixCorpus *corpus, uint64_t *selection);
+
+/**
+ * Keep selected only the dumps where (block & mask) == value.
+ * @param corpus pointer to SrixCorpus
+ * @param block index of block
+ * @param value value to search
+ * @param mask bits of block to compare
+ * @param selection selection bitmap to update
+ * @return number of dumps still selected
+ */
+size_t SrixCorpusScan(SrixCorpus *corpus, uint8_t block, uint32_t value, uint32_t mask, uint64_t *selection);
+
+/**
+ * Compare selected dumps with a template.
+ * @param corpus pointer to SrixCorpus
+ * @param template EEPROM blocks to compare with
+ * @param selection selection bitmap of dumps to compare
+ * @param counts array where save, for every block, the number of selected dumps that differ from template
+ * @param different selection bitmap where save the dumps with at least a different block, null to ignore
+ */
+void SrixCorpusDiff(SrixCorpus *corpus, const uint32_t template[const static SRIX4K_BLOCKS], const uint64_t *selection,
+                    uint64_t counts[const static SRIX4K_BLOCKS], uint64_t *different);
+
+/**
+ * Count the values of a block byte in selected dumps.
+ * @param corpus pointer to SrixCorpus
+ * @param block index of block
+ * @param shift bits to shift the block right before taking the lowest byte (0, 8, 16 or 24)
+ * @param selection selection bitmap of dumps to count
+ * @param bins array where save the number of dumps with every byte value
+ */
+void SrixCorpusHistogram(SrixCorpus *corpus, uint8_t block, uint8_t shift, const uint64_t *selection,
+                         uint64_t bins[const static 256]);
+
+#endif /* CORPUS_H */
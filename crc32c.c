@@ -0,0 +1,144 @@
+#include <pthread.h>
+#include <string.h>
+#include "crc32c.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_X86
+#elif defined(__aarch64__) && defined(__linux__) && (defined(__GNUC__) || defined(__clang__))
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#define CRC32C_ARM
+#endif
+
+/* Reflected Castagnoli polynomial */
+#define CRC32C_POLYNOMIAL  0x82F63B78U
+
+/**
+ * Function that updates an inverted CRC32C with a buffer.
+ */
+typedef uint32_t (*Crc32cUpdate)(uint32_t crc, const uint8_t *data, size_t length);
+
+/* Slicing-by-8 tables of portable implementation */
+static uint32_t crc32cTable[8][256];
+
+/* Implementation selected for this CPU */
+static Crc32cUpdate crc32cUpdate;
+static const char *crc32cName;
+static pthread_once_t crc32cOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Load 8 bytes in little endian order.
+ * @param data bytes to load
+ * @return loaded value
+ */
+static inline uint64_t crc32cLoad64(const uint8_t *data) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = value << 8U | data[i];
+    }
+    return value;
+}
+
+/**
+ * Update a CRC32C 8 bytes at a time with lookup tables.
+ */
+static uint32_t crc32cPortable(uint32_t crc, const uint8_t *data, size_t length) {
+    for (; length >= 8; data += 8, length -= 8) {
+        uint64_t word = crc32cLoad64(data) ^ crc;
+        crc = crc32cTable[7][word & 0xFFU] ^ crc32cTable[6][word >> 8U & 0xFFU] ^
+              crc32cTable[5][word >> 16U & 0xFFU] ^ crc32cTable[4][word >> 24U & 0xFFU] ^
+              crc32cTable[3][word >> 32U & 0xFFU] ^ crc32cTable[2][word >> 40U & 0xFFU] ^
+              crc32cTable[1][word >> 48U & 0xFFU] ^ crc32cTable[0][word >> 56U];
+    }
+
+    for (; length > 0; data++, length--) {
+        crc = crc32cTable[0][(crc ^ *data) & 0xFFU] ^ crc >> 8U;
+    }
+    return crc;
+}
+
+#ifdef CRC32C_X86
+/**
+ * Update a CRC32C 8 bytes at a time with the SSE4.2 crc32 instruction.
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32cSse42(uint32_t crc, const uint8_t *data, size_t length) {
+    uint64_t crc64 = crc;
+    for (; length >= 8; data += 8, length -= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+
+    crc = (uint32_t) crc64;
+    for (; length > 0; data++, length--) {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+    return crc;
+}
+#endif
+
+#ifdef CRC32C_ARM
+/**
+ * Update a CRC32C 8 bytes at a time with the ARMv8 crc32c instructions.
+ */
+__attribute__((target("+crc")))
+static uint32_t crc32cArmv8(uint32_t crc, const uint8_t *data, size_t length) {
+    for (; length >= 8; data += 8, length -= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc = __crc32cd(crc, word);
+    }
+
+    for (; length > 0; data++, length--) {
+        crc = __crc32cb(crc, *data);
+    }
+    return crc;
+}
+#endif
+
+/**
+ * Build the lookup tables and select the fastest implementation for this CPU.
+ */
+static void crc32cInit() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1U ? crc >> 1U ^ CRC32C_POLYNOMIAL : crc >> 1U;
+        }
+        crc32cTable[0][i] = crc;
+    }
+
+    /* Table k gives the contribution of a byte followed by k zero bytes */
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            crc32cTable[k][i] = crc32cTable[0][crc32cTable[k - 1][i] & 0xFFU] ^ crc32cTable[k - 1][i] >> 8U;
+        }
+    }
+
+    crc32cUpdate = crc32cPortable;
+    crc32cName = "portable";
+
+#if defined(CRC32C_X86)
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc32cUpdate = crc32cSse42;
+        crc32cName = "sse4.2";
+    }
+#elif defined(CRC32C_ARM)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        crc32cUpdate = crc32cArmv8;
+        crc32cName = "armv8";
+    }
+#endif
+}
+
+uint32_t SrixCrc32c(uint32_t crc, const void *data, size_t length) {
+    pthread_once(&crc32cOnce, crc32cInit);
+    return ~crc32cUpdate(~crc, data, length);
+}
+
+const char *SrixCrc32cImplementation() {
+    pthread_once(&crc32cOnce, crc32cInit);
+    return crc32cName;
+}
@@ -0,0 +1,22 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Compute the CRC32C (Castagnoli) of a buffer, with SSE4.2 or ARMv8 CRC instructions when the CPU has them.
+ * @param crc CRC32C of previous data, 0 to start a new checksum
+ * @param data bytes to add to checksum
+ * @param length number of bytes
+ * @return CRC32C of previous data followed by the buffer
+ */
+uint32_t SrixCrc32c(uint32_t crc, const void *data, size_t length);
+
+/**
+ * Get the name of the CRC32C implementation selected for this CPU.
+ * @return "sse4.2", "armv8" or "portable"
+ */
+const char *SrixCrc32cImplementation();
+
+#endif /* CRC32C_H */
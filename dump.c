@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+#include "crc32c.h"
+#include "dump.h"
+
+void SrixDumpEncode(const uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid,
+                    uint8_t dump[const static SRIX_DUMP_LENGTH]) {
+    /* Blocks */
+    for (int i = 0; i < SRIX4K_BLOCKS; i++) {
+        dump[i * SRIX_BLOCK_LENGTH] = eeprom[i] >> 24;
+        dump[i * SRIX_BLOCK_LENGTH + 1] = eeprom[i] >> 16;
+        dump[i * SRIX_BLOCK_LENGTH + 2] = eeprom[i] >> 8;
+        dump[i * SRIX_BLOCK_LENGTH + 3] = eeprom[i];
+    }
+
+    /* UID */
+    for (int i = 0; i < SRIX_UID_LENGTH; i++) {
+        dump[SRIX4K_BYTES + i] = uid >> (8 * i);
+    }
+}
+
+void SrixDumpDecode(const uint8_t dump[const static SRIX_DUMP_LENGTH], uint32_t eeprom[const static SRIX4K_BLOCKS],
+                    uint64_t uid[static 1]) {
+    /* Blocks */
+    for (int i = 0; i < SRIX4K_BLOCKS; i++) {
+        const uint8_t *block = dump + i * SRIX_BLOCK_LENGTH;
+        eeprom[i] = (uint32_t) block[0] << 24 | (uint32_t) block[1] << 16 | (uint32_t) block[2] << 8 | block[3];
+    }
+
+    /* UID */
+    *uid = 0;
+    for (int i = SRIX_UID_LENGTH - 1; i >= 0; i--) {
+        *uid = *uid << 8U | dump[SRIX4K_BYTES + i];
+    }
+}
+
+void SrixDumpEncodeExtended(const uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid,
+                            uint8_t dump[const static SRIX_DUMP_EXTENDED_LENGTH]) {
+    SrixDumpEncode(eeprom, uid, dump);
+
+    /* Checksum trailer */
+    uint32_t crc = SrixCrc32c(0, dump, SRIX_DUMP_LENGTH);
+    memcpy(dump + SRIX_DUMP_LENGTH, SRIX_DUMP_MAGIC, 4);
+    for (int i = 0; i < 4; i++) {
+        dump[SRIX_DUMP_LENGTH + 4 + i] = crc >> (8 * i);
+    }
+}
+
+SrixError SrixDumpVerify(const uint8_t dump[static SRIX_DUMP_LENGTH], size_t length) {
+    if (length == SRIX_DUMP_LENGTH) {
+        return SRIX_NO_ERROR;
+    } else if (length != SRIX_DUMP_EXTENDED_LENGTH || memcmp(dump + SRIX_DUMP_LENGTH, SRIX_DUMP_MAGIC, 4) != 0) {
+        return SRIX_ERROR(SRIX_ERROR, "incorrect dump file length");
+    }
+
+    uint32_t expected = 0;
+    for (int i = 3; i >= 0; i--) {
+        expected = expected << 8U | dump[SRIX_DUMP_LENGTH + 4 + i];
+    }
+
+    if (SrixCrc32c(0, dump, SRIX_DUMP_LENGTH) != expected) {
+        return SRIX_ERROR(SRIX_ERROR, "dump file checksum mismatch");
+    }
+    return SRIX_NO_ERROR;
+}
+
+SrixError SrixDumpLoad(const char *filename, uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid[static 1]) {
+    FILE *input = fopen(filename, "rb");
+    if (!input) {
+        return SRIX_ERROR(SRIX_ERROR, "unable to open dump file");
+    }
+
+    /* Whole dump in a single read, a byte more detects longer files */
+    uint8_t dump[SRIX_DUMP_EXTENDED_LENGTH + 1];
+    size_t length = fread(dump, sizeof(uint8_t), sizeof(dump), input);
+    fclose(input);
+
+    SrixError error = SrixDumpVerify(dump, length);
+    if (SRIX_IS_ERROR(error)) {
+        return error;
+    }
+
+    SrixDumpDecode(dump, eeprom, uid);
+    return SRIX_NO_ERROR;
+}
+
+/**
+ * Write a dump file with a single write.
+ * @param filename name of file
+ * @param dump dump to write
+ * @param length length of dump
+ * @return SrixError result
+ */
+static SrixError dumpWrite(const char *filename, const uint8_t *dump, size_t length) {
+    FILE *output = fopen(filename, "wb");
+    if (!output) {
+        return SRIX_ERROR(SRIX_ERROR, "unable to open dump file");
+    }
+
+    size_t written = fwrite(dump, sizeof(uint8_t), length, output);
+    if (fclose(output) != 0 || written != length) {
+        return SRIX_ERROR(SRIX_ERROR, "incorrect dump file write");
+    }
+
+    return SRIX_NO_ERROR;
+}
+
+SrixError SrixDumpSave(const char *filename, const uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid) {
+    uint8_t dump[SRIX_DUMP_EXTENDED_LENGTH];
+    SrixDumpEncodeExtended(eeprom, uid, dump);
+    return dumpWrite(filename, dump, SRIX_DUMP_EXTENDED_LENGTH);
+}
+
+SrixError SrixDumpSaveRaw(const char *filename, const uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid) {
+    uint8_t dump[SRIX_DUMP_LENGTH];
+    SrixDumpEncode(eeprom, uid, dump);
+    return dumpWrite(filename, dump, SRIX_DUMP_LENGTH);
+}
@@ -0,0 +1,82 @@
+#ifndef DUMP_H
+#define DUMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "error.h"
+
+/**
+ * Raw dump layout: 128 big endian blocks followed by the little endian UID.
+ */
+#define SRIX_DUMP_LENGTH  (SRIX4K_BYTES + SRIX_UID_LENGTH)
+
+/**
+ * Extended dump layout: raw dump followed by SRIX_DUMP_MAGIC and the little endian CRC32C of the raw dump.
+ * Programs that read only the first SRIX_DUMP_LENGTH bytes still load it as a raw dump.
+ */
+#define SRIX_DUMP_MAGIC            "SRXC"
+#define SRIX_DUMP_EXTENDED_LENGTH  (SRIX_DUMP_LENGTH + 8)
+
+/**
+ * Convert EEPROM and UID to the raw dump layout.
+ * @param eeprom EEPROM blocks to convert
+ * @param uid UID to convert
+ * @param dump array where save the raw dump
+ */
+void SrixDumpEncode(const uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid,
+                    uint8_t dump[const static SRIX_DUMP_LENGTH]);
+
+/**
+ * Convert a raw dump to EEPROM and UID.
+ * @param dump raw dump to convert
+ * @param eeprom array where save EEPROM blocks
+ * @param uid pointer where save UID
+ */
+void SrixDumpDecode(const uint8_t dump[const static SRIX_DUMP_LENGTH], uint32_t eeprom[const static SRIX4K_BLOCKS],
+                    uint64_t *uid);
+
+/**
+ * Convert EEPROM and UID to the extended dump layout.
+ * @param eeprom EEPROM blocks to convert
+ * @param uid UID to convert
+ * @param dump array where save the extended dump
+ */
+void SrixDumpEncodeExtended(const uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid,
+                            uint8_t dump[const static SRIX_DUMP_EXTENDED_LENGTH]);
+
+/**
+ * Check the integrity of a dump.
+ * @param dump raw or extended dump
+ * @param length SRIX_DUMP_LENGTH for a raw dump (never corrupted), SRIX_DUMP_EXTENDED_LENGTH for an extended one
+ * @return SrixError result
+ */
+SrixError SrixDumpVerify(const uint8_t *dump, size_t length);
+
+/**
+ * Read a raw or extended dump file, checking the checksum of extended dumps.
+ * @param filename name of file
+ * @param eeprom array where save EEPROM blocks
+ * @param uid pointer where save UID
+ * @return SrixError result
+ */
+SrixError SrixDumpLoad(const char *filename, uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t *uid);
+
+/**
+ * Write an extended dump file.
+ * @param filename name of file
+ * @param eeprom EEPROM blocks to save
+ * @param uid UID to save
+ * @return SrixError result
+ */
+SrixError SrixDumpSave(const char *filename, const uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid);
+
+/**
+ * Write a raw dump file, without checksum, for programs that accept only SRIX_DUMP_LENGTH bytes.
+ * @param filename name of file
+ * @param eeprom EEPROM blocks to save
+ * @param uid UID to save
+ * @return SrixError result
+ */
+SrixError SrixDumpSaveRaw(const char *filename, const uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid);
+
+#endif /* DUMP_H */
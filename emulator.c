@@ -0,0 +1,367 @@
+#include <string.h>
+#include <time.h>
+#include "emulator.h"
+
+/**
+ * Get the next pseudo-random number of an emulator (xorshift).
+ * @param emulator pointer to SrixEmulator
+ * @return random number
+ */
+static uint64_t emulatorRandom(SrixEmulator *emulator) {
+    emulator->seed ^= emulator->seed << 13U;
+    emulator->seed ^= emulator->seed >> 7U;
+    emulator->seed ^= emulator->seed << 17U;
+    return emulator->seed;
+}
+
+/**
+ * Get the next pseudo-random percentage of an emulator.
+ * @param emulator pointer to SrixEmulator
+ * @return random number between 0 and 99
+ */
+static uint8_t emulatorPercent(SrixEmulator *emulator) {
+    return emulatorRandom(emulator) % 100;
+}
+
+/**
+ * Wait the frame latency of an emulator.
+ * @param emulator pointer to SrixEmulator
+ */
+static void emulatorDelay(const SrixEmulator *emulator) {
+    if (emulator->config.latencyMicros) {
+        struct timespec sleepTime = {
+                .tv_sec = emulator->config.latencyMicros / 1000000,
+                .tv_nsec = (long) (emulator->config.latencyMicros % 1000000) * 1000
+        };
+        nanosleep(&sleepTime, (void *) 0);
+    }
+}
+
+/**
+ * Get the numeric value of a block, SRIX4K sends the least significant byte first.
+ * @param block block in tag byte order
+ * @return block value
+ */
+static uint32_t emulatorBlockValue(const uint8_t block[static SRIX_BLOCK_LENGTH]) {
+    return block[0] | block[1] << 8U | block[2] << 16U | (uint32_t) block[3] << 24U;
+}
+
+/**
+ * Write a block of an emulated tag, following the SRIX4K write rules.
+ * Writes that the tag refuses are ignored, like on a real tag.
+ * @param emulator pointer to SrixEmulator
+ * @param blockNum index of block, SRIX_SYSTEM_BLOCK for the system area
+ * @param data block in tag byte order
+ */
+static void emulatorWrite(SrixEmulator *emulator, uint8_t blockNum, const uint8_t data[static SRIX_BLOCK_LENGTH]) {
+    if (blockNum == SRIX_SYSTEM_BLOCK) {
+        /* OTP_Lock_Reg and the other system bits can only be cleared */
+        for (uint8_t i = 0; i < SRIX_BLOCK_LENGTH; i++) {
+            emulator->system[i] &= data[i];
+        }
+        return;
+    }
+
+    uint8_t *block = emulator->memory[blockNum];
+    if (blockNum <= 4) {
+        /* Resettable OTP bits can only be cleared */
+        for (uint8_t i = 0; i < SRIX_BLOCK_LENGTH; i++) {
+            block[i] &= data[i];
+        }
+    } else if (blockNum <= 6) {
+        /* Count down counters, a decrement of block 6 resets the OTP blocks */
+        if (emulatorBlockValue(data) >= emulatorBlockValue(block)) {
+            return;
+        }
+
+        memcpy(block, data, SRIX_BLOCK_LENGTH);
+        if (blockNum == 6) {
+            memset(emulator->memory, 0xFF, 5 * SRIX_BLOCK_LENGTH);
+        }
+    } else if (blockNum <= 15) {
+        /* Bit b24 of OTP_Lock_Reg locks blocks 7 and 8, bits b25-b31 lock blocks 9-15 */
+        const uint8_t lockBit = blockNum == 7 ? 0 : blockNum - 8;
+        if (emulator->system[3] & 1U << lockBit) {
+            memcpy(block, data, SRIX_BLOCK_LENGTH);
+        }
+    } else {
+        memcpy(block, data, SRIX_BLOCK_LENGTH);
+    }
+}
+
+/**
+ * Answer a memory command sent to an emulated tag in the field.
+ * @param emulator pointer to SrixEmulator
+ * @param tx command bytes
+ * @param txSize number of command bytes
+ * @param rx array where save the response
+ * @param rxSize size of rx array
+ * @return response length, NFC_ETIMEOUT if the tag doesn't answer
+ */
+static int emulatorCommand(SrixEmulator *emulator, const uint8_t *tx, size_t txSize, uint8_t *rx, size_t rxSize) {
+    if (txSize == 0 || emulatorPercent(emulator) < emulator->config.dropPercent) {
+        return NFC_ETIMEOUT;
+    }
+    /* A frame with a bad CRC is dropped by the tag (commands) or reported by the reader (responses) */
+    const bool corrupt = emulatorPercent(emulator) < emulator->config.corruptPercent;
+
+    switch (tx[0]) {
+        case SRIX_GET_UID:
+            if (txSize != 1 || rxSize < SRIX_UID_LENGTH) {
+                return NFC_EINVARG;
+            }
+            if (corrupt) {
+                return NFC_ERFTRANS;
+            }
+
+            for (uint8_t i = 0; i < SRIX_UID_LENGTH; i++) {
+                rx[i] = emulator->uid >> i * 8U;
+            }
+            return SRIX_UID_LENGTH;
+        case SRIX_READ_BLOCK:
+            if (txSize != 2 || (tx[1] >= SRIX4K_BLOCKS && tx[1] != SRIX_SYSTEM_BLOCK) ||
+                rxSize < SRIX_BLOCK_LENGTH) {
+                return NFC_EINVARG;
+            }
+            if (corrupt) {
+                return NFC_ERFTRANS;
+            }
+
+            memcpy(rx, tx[1] == SRIX_SYSTEM_BLOCK ? emulator->system : emulator->memory[tx[1]], SRIX_BLOCK_LENGTH);
+            return SRIX_BLOCK_LENGTH;
+        case SRIX_WRITE_BLOCK:
+            if (txSize != 2 + SRIX_BLOCK_LENGTH || (tx[1] >= SRIX4K_BLOCKS && tx[1] != SRIX_SYSTEM_BLOCK)) {
+                return NFC_EINVARG;
+            }
+
+            /* Write command has no response */
+            if (!corrupt) {
+                emulatorWrite(emulator, tx[1], tx + 2);
+            }
+            return 0;
+        default:
+            return NFC_ETIMEOUT;
+    }
+}
+
+/**
+ * Answer a command sent to an emulated tag.
+ */
+static int emulatorTransceive(void *context, const uint8_t *tx, size_t txSize, uint8_t *rx, size_t rxSize,
+                              int timeoutMillis) {
+    SrixEmulator *emulator = context;
+    (void) timeoutMillis;
+    emulatorDelay(emulator);
+
+    return emulator->present ? emulatorCommand(emulator, tx, txSize, rx, rxSize) : NFC_ETIMEOUT;
+}
+
+/**
+ * Answer a command sent to a field, following the anticollision state of an emulated tag.
+ * @param emulator pointer to SrixEmulator in the field
+ * @param tx command bytes
+ * @param txSize number of command bytes
+ * @param rx array where save the response
+ * @param rxSize size of rx array
+ * @return response length, NFC_ETIMEOUT if the tag doesn't answer
+ */
+static int emulatorFieldCommand(SrixEmulator *emulator, const uint8_t *tx, size_t txSize, uint8_t *rx,
+                                size_t rxSize) {
+    const SrixEmulatorState state = emulator->state;
+    if (txSize == 0 || state == SRIX_EMULATOR_DEACTIVATED) {
+        return NFC_ETIMEOUT;
+    }
+
+    if (txSize == 2 && tx[0] == SRIX_INITIATE && tx[1] == 0x00 && state <= SRIX_EMULATOR_INVENTORY) {
+        emulator->state = SRIX_EMULATOR_INVENTORY;
+        emulator->chipId = emulatorRandom(emulator) >> 8U;
+        rx[0] = emulator->chipId;
+        return 1;
+    } else if (txSize == 2 && tx[0] == SRIX_PCALL16 && tx[1] == 0x04 && state <= SRIX_EMULATOR_INVENTORY) {
+        /* New random slot */
+        emulator->state = SRIX_EMULATOR_INVENTORY;
+        emulator->chipId = (emulator->chipId & 0xF0U) | (emulatorRandom(emulator) >> 8U & 0x0FU);
+        if ((emulator->chipId & 0x0FU) != 0) {
+            return NFC_ETIMEOUT;
+        }
+
+        rx[0] = emulator->chipId;
+        return 1;
+    } else if (txSize == 1 && (tx[0] & 0x0FU) == 0x06U && tx[0] != 0x06U) {
+        if (state != SRIX_EMULATOR_INVENTORY || (emulator->chipId & 0x0FU) != tx[0] >> 4U) {
+            return NFC_ETIMEOUT;
+        }
+
+        rx[0] = emulator->chipId;
+        return 1;
+    } else if (txSize == 2 && tx[0] == SRIX_SELECT) {
+        if (tx[1] == emulator->chipId && state != SRIX_EMULATOR_READY) {
+            emulator->state = SRIX_EMULATOR_SELECTED;
+            rx[0] = emulator->chipId;
+            return 1;
+        }
+
+        if (state == SRIX_EMULATOR_SELECTED) {
+            emulator->state = SRIX_EMULATOR_DESELECTED;
+        }
+        return NFC_ETIMEOUT;
+    } else if (txSize == 1 && tx[0] == SRIX_COMPLETION) {
+        emulator->state = state == SRIX_EMULATOR_SELECTED ? SRIX_EMULATOR_DEACTIVATED : state;
+        return NFC_ETIMEOUT;
+    } else if (txSize == 1 && tx[0] == SRIX_RESET_TO_INVENTORY) {
+        emulator->state = state == SRIX_EMULATOR_SELECTED ? SRIX_EMULATOR_INVENTORY : state;
+        return NFC_ETIMEOUT;
+    }
+
+    /* Memory commands are answered only by the selected tag */
+    return state == SRIX_EMULATOR_SELECTED ? emulatorCommand(emulator, tx, txSize, rx, rxSize) : NFC_ETIMEOUT;
+}
+
+/**
+ * Send a command to all tags of an emulated field.
+ */
+static int emulatorFieldTransceive(void *context, const uint8_t *tx, size_t txSize, uint8_t *rx, size_t rxSize,
+                                   int timeoutMillis) {
+    SrixEmulatorField *field = context;
+    (void) timeoutMillis;
+    if (field->count) {
+        emulatorDelay(&field->tags[0]);
+    }
+
+    uint8_t response[SRIX_UID_LENGTH];
+    int result = NFC_ETIMEOUT;
+    size_t answers = 0;
+
+    for (size_t i = 0; i < field->count; i++) {
+        /* A tag out of the field loses its anticollision state */
+        if (!field->tags[i].present) {
+            field->tags[i].state = SRIX_EMULATOR_READY;
+            continue;
+        }
+
+        int answer = emulatorFieldCommand(&field->tags[i], tx, txSize, response, sizeof(response));
+        if (answer != NFC_ETIMEOUT) {
+            result = answer;
+            answers++;
+        }
+    }
+
+    /* Answers of many tags overlap */
+    if (answers > 1) {
+        return NFC_ERFTRANS;
+    }
+
+    if (result > 0) {
+        memcpy(rx, response, (size_t) result < rxSize ? (size_t) result : rxSize);
+    }
+    return result;
+}
+
+/**
+ * Select a tag of an emulated field like libnfc: INITIATE, then SELECT if a single tag answered.
+ */
+static int emulatorFieldSelect(void *context, int timeoutMillis) {
+    (void) timeoutMillis;
+    SrixEmulatorField *field = context;
+    SrixEmulator *found = (void *) 0;
+    size_t count = 0;
+
+    if (field->count) {
+        emulatorDelay(&field->tags[0]);
+    }
+
+    for (size_t i = 0; i < field->count; i++) {
+        SrixEmulator *emulator = &field->tags[i];
+        if (emulator->present && emulator->state != SRIX_EMULATOR_DEACTIVATED) {
+            emulator->state = SRIX_EMULATOR_INVENTORY;
+            emulator->chipId = emulatorRandom(emulator) >> 8U;
+            found = emulator;
+            count++;
+        }
+    }
+
+    if (count == 1) {
+        found->state = SRIX_EMULATOR_SELECTED;
+    }
+    return count > 1 ? NFC_ERFTRANS : (int) count;
+}
+
+/**
+ * Check if a tag of an emulated field is selected.
+ */
+static bool emulatorFieldIsPresent(void *context) {
+    SrixEmulatorField *field = context;
+    for (size_t i = 0; i < field->count; i++) {
+        if (field->tags[i].present && field->tags[i].state == SRIX_EMULATOR_SELECTED) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Select an emulated tag, if it's in the field.
+ */
+static int emulatorSelect(void *context, int timeoutMillis) {
+    (void) timeoutMillis;
+    SrixEmulator *emulator = context;
+    emulatorDelay(emulator);
+    return emulator->present;
+}
+
+/**
+ * Check if an emulated tag is in the field.
+ */
+static bool emulatorIsPresent(void *context) {
+    SrixEmulator *emulator = context;
+    emulatorDelay(emulator);
+    return emulator->present;
+}
+
+/**
+ * Get last error of an emulated tag.
+ */
+static const char *emulatorStrerror(void *context) {
+    (void) context;
+    return "emulated tag error";
+}
+
+const NfcTransport SRIX_EMULATOR_TRANSPORT = {
+        .transceive = emulatorTransceive,
+        .select = emulatorSelect,
+        .isPresent = emulatorIsPresent,
+        .strerror = emulatorStrerror,
+        .close = (void *) 0
+};
+
+const NfcTransport SRIX_EMULATOR_FIELD_TRANSPORT = {
+        .transceive = emulatorFieldTransceive,
+        .select = emulatorFieldSelect,
+        .isPresent = emulatorFieldIsPresent,
+        .strerror = emulatorStrerror,
+        .close = (void *) 0
+};
+
+void SrixEmulatorInit(SrixEmulator emulator[static 1], const uint32_t eeprom[const static SRIX4K_BLOCKS],
+                      uint64_t uid, SrixEmulatorConfig config) {
+    for (uint8_t i = 0; i < SRIX4K_BLOCKS; i++) {
+        emulator->memory[i][0] = eeprom[i] >> 24U;
+        emulator->memory[i][1] = eeprom[i] >> 16U;
+        emulator->memory[i][2] = eeprom[i] >> 8U;
+        emulator->memory[i][3] = eeprom[i];
+    }
+
+    emulator->uid = uid;
+    emulator->config = config;
+    memset(emulator->system, 0xFF, SRIX_BLOCK_LENGTH);
+    emulator->present = true;
+    emulator->seed = uid ^ 0x9E3779B97F4A7C15U;
+    emulator->state = SRIX_EMULATOR_READY;
+    emulator->chipId = 0;
+}
+
+uint32_t SrixEmulatorGetBlock(SrixEmulator emulator[static 1], uint8_t blockNum) {
+    const uint8_t *block = emulator->memory[blockNum];
+    return (uint32_t) block[0] << 24U | (uint32_t) block[1] << 16U | (uint32_t) block[2] << 8U | block[3];
+}
@@ -0,0 +1,87 @@
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "error.h"
+#include "reader.h"
+
+/* Block address of the system area */
+#define SRIX_SYSTEM_BLOCK 0xFF
+
+/**
+ * Radio conditions of an emulated tag.
+ */
+typedef struct SrixEmulatorConfig {
+    uint32_t latencyMicros;           /* delay of every frame */
+    uint8_t dropPercent;              /* frames lost (no response, writes not applied) */
+    uint8_t corruptPercent;           /* frames with a bad CRC (read failed, write not applied) */
+} SrixEmulatorConfig;
+
+/**
+ * Anticollision state of an emulated tag in a field.
+ */
+typedef enum {
+    SRIX_EMULATOR_READY,        /* powered, waiting for INITIATE or PCALL16 */
+    SRIX_EMULATOR_INVENTORY,    /* taking part in the anticollision */
+    SRIX_EMULATOR_SELECTED,     /* answers to UID, read and write commands */
+    SRIX_EMULATOR_DESELECTED,   /* waits to be selected again */
+    SRIX_EMULATOR_DEACTIVATED   /* silent until it leaves the field */
+} SrixEmulatorState;
+
+/**
+ * SRIX4K/ST25TB04K tag emulated in memory.
+ * It answers get UID (0x0B), read block (0x08) and write block (0x09) commands.
+ * Writes follow the tag rules: OTP bits are only cleared, counters only decrease and locked blocks are read-only.
+ * In a field it also answers the anticollision commands.
+ */
+typedef struct SrixEmulator {
+    uint8_t memory[SRIX4K_BLOCKS][SRIX_BLOCK_LENGTH]; /* EEPROM in tag byte order */
+    uint8_t system[SRIX_BLOCK_LENGTH]; /* system block, OTP_Lock_Reg is its last byte */
+    uint64_t uid;                     /* SRIX UID */
+    SrixEmulatorConfig config;        /* radio conditions */
+    bool present;                     /* tag is in the field */
+    uint64_t seed;                    /* state of drop, corruption and Chip_ID generator */
+    SrixEmulatorState state;          /* anticollision state, used in a field */
+    uint8_t chipId;                   /* random Chip_ID, the 4 low bits are the PCALL16 slot */
+} SrixEmulator;
+
+/**
+ * Many emulated tags in the field of the same reader.
+ */
+typedef struct SrixEmulatorField {
+    SrixEmulator *tags;               /* emulated tags, not present ones are out of the field */
+    size_t count;                     /* number of tags */
+} SrixEmulatorField;
+
+/**
+ * Transport that connects a NFC reader to an emulated tag, the context is a SrixEmulator pointer.
+ */
+extern const NfcTransport SRIX_EMULATOR_TRANSPORT;
+
+/**
+ * Transport that connects a NFC reader to a field of emulated tags, the context is a SrixEmulatorField pointer.
+ * Tags must be selected with the anticollision, answers of many tags collide.
+ * Frame latency is the one of the first tag.
+ */
+extern const NfcTransport SRIX_EMULATOR_FIELD_TRANSPORT;
+
+/**
+ * Initialize an emulated tag.
+ * @param emulator pointer to SrixEmulator to initialize
+ * @param eeprom EEPROM blocks of tag
+ * @param uid UID of tag
+ * @param config radio conditions
+ */
+void SrixEmulatorInit(SrixEmulator *emulator, const uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid,
+                      SrixEmulatorConfig config);
+
+/**
+ * Get a block of an emulated tag.
+ * @param emulator pointer to SrixEmulator
+ * @param blockNum index of block
+ * @return block value
+ */
+uint32_t SrixEmulatorGetBlock(SrixEmulator *emulator, uint8_t blockNum);
+
+#endif /* EMULATOR_H */
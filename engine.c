@@ -0,0 +1,309 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include "engine.h"
+#include "reader.h"
+#include "srix.h"
+
+/* Delay between tag polls and removal checks */
+#define ENGINE_POLL_MICROS  20000
+
+typedef struct SrixEngineWorker {
+    SrixEngine *engine;                       /* engine that owns the worker */
+    Srix *srix;                               /* Srix with the worker reader */
+    int reader;                               /* index of reader */
+    pthread_t thread;                         /* worker thread */
+} SrixEngineWorker;
+
+/**
+ * Engine that drives many NFC readers in parallel.
+ */
+struct SrixEngine {
+    SrixContext *context;                     /* library context of readers */
+    SrixEngineOperation operation;            /* operation to do on every tag */
+    uint32_t eeprom[SRIX4K_BLOCKS];           /* EEPROM to write */
+    bool hasEeprom;                           /* false to keep tag content */
+    SrixEngineSettings settings;              /* settings of readers and tags */
+    SrixBlockEdit edits[SRIX4K_BLOCKS];       /* blocks to modify, referenced by settings */
+    atomic_bool running;                      /* false when workers have to stop */
+    SrixEngineWorker workers[MAX_DEVICE_COUNT];
+    size_t workersCount;                      /* number of started workers */
+    size_t traceCapacity;                     /* events of every reader trace, 0 = tracing disabled */
+    NfcTrace *traces[MAX_DEVICE_COUNT];       /* trace of every reader, created on start */
+    pthread_mutex_t lock;                     /* results queue lock */
+    pthread_cond_t notEmpty;                  /* signaled when a result is added */
+    pthread_cond_t notFull;                   /* signaled when a result is removed */
+    SrixEngineResult queue[ENGINE_QUEUE_SIZE];/* results ring buffer */
+    size_t queueHead;                         /* index of first result */
+    size_t queueCount;                        /* number of results in queue */
+};
+
+/**
+ * Sleep for a short time between two polls.
+ */
+static void enginePollDelay() {
+    struct timespec sleepTime = {.tv_sec = 0, .tv_nsec = ENGINE_POLL_MICROS * 1000};
+    nanosleep(&sleepTime, (void *) 0);
+}
+
+/**
+ * Add a result to the engine queue, waiting if the queue is full.
+ * @param engine pointer to SrixEngine
+ * @param result result to add
+ */
+static void enginePush(SrixEngine *engine, const SrixEngineResult *result) {
+    pthread_mutex_lock(&engine->lock);
+    while (engine->queueCount == ENGINE_QUEUE_SIZE && atomic_load(&engine->running)) {
+        pthread_cond_wait(&engine->notFull, &engine->lock);
+    }
+
+    if (engine->queueCount < ENGINE_QUEUE_SIZE) {
+        engine->queue[(engine->queueHead + engine->queueCount) % ENGINE_QUEUE_SIZE] = *result;
+        engine->queueCount++;
+        pthread_cond_signal(&engine->notEmpty);
+    }
+    pthread_mutex_unlock(&engine->lock);
+}
+
+/**
+ * Process a single tag selected by a worker.
+ * @param worker pointer to worker
+ * @param result pointer where save the result
+ */
+static void engineProcessTag(SrixEngineWorker *worker, SrixEngineResult *result) {
+    Srix *srix = worker->srix;
+    const SrixEngine *engine = worker->engine;
+
+    if (engine->operation == SRIX_ENGINE_WRITE) {
+        if (engine->hasEeprom) {
+            SrixMemoryInit(srix, engine->eeprom, SrixGetUid(srix));
+        }
+
+        if (engine->settings.resetOTP && SrixResetOtp(srix) != SRIX_SUCCESS) {
+            result->error = SrixGetLatestError(srix);
+            return;
+        }
+
+        for (size_t i = 0; i < engine->settings.editsCount; i++) {
+            SrixModifyBlock(srix, engine->settings.edits[i].value, engine->settings.edits[i].block);
+        }
+
+        if (SrixWriteBlocks(srix) != SRIX_SUCCESS) {
+            result->error = SrixGetLatestError(srix);
+        }
+    }
+
+    result->uid = SrixGetUid(srix);
+    for (uint8_t i = 0; i < SRIX4K_BLOCKS; i++) {
+        result->eeprom[i] = *SrixGetBlock(srix, i);
+    }
+    result->roundTrips = SrixGetRoundTrips(srix);
+}
+
+/**
+ * Worker thread: wait for tags on a reader and process them until the engine is stopped.
+ * @param arg pointer to SrixEngineWorker
+ * @return null
+ */
+static void *engineWorker(void *arg) {
+    SrixEngineWorker *worker = arg;
+    SrixEngine *engine = worker->engine;
+
+    while (atomic_load(&engine->running)) {
+        SrixEngineResult result = {.reader = worker->reader, .error = SRIX_NO_ERROR};
+
+        if (SrixNfcNextTag(worker->srix, false)) {
+            result.error = SrixGetLatestError(worker->srix);
+            if (result.error.errorType == NFC_TAG_MISSING) {
+                /* Field is empty, poll again */
+                enginePollDelay();
+                continue;
+            }
+        } else {
+            engineProcessTag(worker, &result);
+        }
+
+        enginePush(engine, &result);
+
+        /* Wait for tag removal, to avoid processing the same tag again */
+        while (atomic_load(&engine->running) && SrixNfcTagIsPresent(worker->srix)) {
+            enginePollDelay();
+        }
+    }
+
+    return (void *) 0;
+}
+
+SrixEngine *SrixEngineNew(SrixContext *context, SrixEngineOperation operation, const uint32_t *eeprom,
+                          const SrixEngineSettings *settings) {
+    if (settings && settings->editsCount > SRIX4K_BLOCKS) {
+        return (void *) 0;
+    }
+
+    SrixEngine *created = malloc(sizeof(SrixEngine));
+    if (!created) {
+        return (void *) 0;
+    }
+
+    created->context = context;
+    created->operation = operation;
+    created->hasEeprom = eeprom;
+    if (eeprom) {
+        memcpy(created->eeprom, eeprom, sizeof(created->eeprom));
+    }
+
+    created->settings = settings ? *settings : (SrixEngineSettings) {.verifyMode = SRIX_VERIFY_BLOCK};
+    if (created->settings.editsCount) {
+        memcpy(created->edits, created->settings.edits, created->settings.editsCount * sizeof(SrixBlockEdit));
+    }
+    created->settings.edits = created->edits;
+
+    atomic_init(&created->running, false);
+    created->workersCount = 0;
+    created->traceCapacity = 0;
+    memset(created->traces, 0, sizeof(created->traces));
+    created->queueHead = 0;
+    created->queueCount = 0;
+    pthread_mutex_init(&created->lock, (void *) 0);
+    pthread_cond_init(&created->notEmpty, (void *) 0);
+    pthread_cond_init(&created->notFull, (void *) 0);
+
+    return created;
+}
+
+void SrixEngineEnableTrace(SrixEngine engine[static 1], size_t capacity) {
+    engine->traceCapacity = capacity;
+}
+
+SrixError SrixEngineExportTrace(SrixEngine engine[static 1], const char *filename) {
+    NfcTrace *traces[MAX_DEVICE_COUNT];
+    size_t count = 0;
+
+    for (size_t i = 0; i < MAX_DEVICE_COUNT; i++) {
+        if (engine->traces[i]) {
+            traces[count++] = engine->traces[i];
+        }
+    }
+
+    return NfcTraceExport(filename, traces, count);
+}
+
+size_t SrixEngineStart(SrixEngine engine[static 1]) {
+    if (atomic_load(&engine->running)) {
+        return engine->workersCount;
+    }
+
+    /* Search readers before opening them, an open device could be skipped by the enumeration */
+    Srix *srix[MAX_DEVICE_COUNT];
+    size_t readers = MAX_DEVICE_COUNT;
+    for (size_t i = 0; i < readers; i++) {
+        srix[i] = SrixNew(engine->context);
+        size_t found = srix[i] ? NfcGetReadersCount(srix[i]) : 0;
+
+        if (found <= i) {
+            if (srix[i]) {
+                SrixDelete(srix[i]);
+            }
+            readers = i;
+            break;
+        } else if (found < readers) {
+            readers = found;
+        }
+    }
+
+    atomic_store(&engine->running, true);
+    for (size_t i = 0; i < readers; i++) {
+        /* Devices are opened serially, only exchanges run in parallel */
+        if (SrixNfcOpen(srix[i], (int) i)) {
+            SrixDelete(srix[i]);
+            continue;
+        }
+
+        /* Every reader has its own trace, so workers never share it */
+        if (engine->traceCapacity && !engine->traces[i]) {
+            engine->traces[i] = NfcTraceNew(engine->traceCapacity, (uint32_t) i,
+                                            NfcGetDescription(srix[i], (int) i));
+        }
+        SrixSetTrace(srix[i], engine->traces[i]);
+        SrixSetVerifyMode(srix[i], engine->settings.verifyMode);
+        SrixSetTagTimeout(srix[i], engine->settings.timeoutMillis);
+        if (engine->settings.maxAttempts) {
+            SrixSetRetryPolicy(srix[i], engine->settings.maxAttempts, 1000);
+        }
+
+        SrixEngineWorker *worker = &engine->workers[engine->workersCount];
+        worker->engine = engine;
+        worker->srix = srix[i];
+        worker->reader = (int) i;
+
+        if (pthread_create(&worker->thread, (void *) 0, engineWorker, worker) != 0) {
+            SrixDelete(srix[i]);
+            continue;
+        }
+
+        engine->workersCount++;
+    }
+
+    if (engine->workersCount == 0) {
+        atomic_store(&engine->running, false);
+    }
+
+    return engine->workersCount;
+}
+
+bool SrixEngineNextResult(SrixEngine engine[static 1], SrixEngineResult result[static 1], uint32_t timeoutMillis) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutMillis / 1000;
+    deadline.tv_nsec += (long) (timeoutMillis % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&engine->lock);
+    while (engine->queueCount == 0) {
+        if (pthread_cond_timedwait(&engine->notEmpty, &engine->lock, &deadline) != 0) {
+            pthread_mutex_unlock(&engine->lock);
+            return false;
+        }
+    }
+
+    *result = engine->queue[engine->queueHead];
+    engine->queueHead = (engine->queueHead + 1) % ENGINE_QUEUE_SIZE;
+    engine->queueCount--;
+    pthread_cond_signal(&engine->notFull);
+    pthread_mutex_unlock(&engine->lock);
+
+    return true;
+}
+
+void SrixEngineStop(SrixEngine engine[static 1]) {
+    /* Wake up workers waiting for queue space */
+    pthread_mutex_lock(&engine->lock);
+    atomic_store(&engine->running, false);
+    pthread_cond_broadcast(&engine->notFull);
+    pthread_mutex_unlock(&engine->lock);
+
+    for (size_t i = 0; i < engine->workersCount; i++) {
+        pthread_join(engine->workers[i].thread, (void *) 0);
+        SrixDelete(engine->workers[i].srix);
+    }
+
+    engine->workersCount = 0;
+}
+
+void SrixEngineDelete(SrixEngine engine[static 1]) {
+    SrixEngineStop(engine);
+    pthread_mutex_destroy(&engine->lock);
+    pthread_cond_destroy(&engine->notEmpty);
+    pthread_cond_destroy(&engine->notFull);
+
+    for (size_t i = 0; i < MAX_DEVICE_COUNT; i++) {
+        if (engine->traces[i]) {
+            NfcTraceDelete(engine->traces[i]);
+        }
+    }
+    free(engine);
+}
@@ -0,0 +1,102 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "batch.h"
+#include "error.h"
+#include "srix.h"
+#include "trace.h"
+
+#define ENGINE_QUEUE_SIZE  32
+
+/**
+ * Operation done by the engine on every tag.
+ */
+typedef enum {
+    SRIX_ENGINE_READ,   /* read UID and EEPROM */
+    SRIX_ENGINE_WRITE   /* read tag, then write the engine EEPROM on it */
+} SrixEngineOperation;
+
+/**
+ * Result of a tag processed by one of the readers.
+ */
+typedef struct SrixEngineResult {
+    int reader;                       /* index of reader that processed the tag */
+    uint64_t uid;                     /* SRIX UID */
+    uint32_t eeprom[SRIX4K_BLOCKS];   /* SRIX4K EEPROM after the operation */
+    uint32_t roundTrips;              /* radio round trips used by the tag */
+    SrixError error;                  /* operation result */
+} SrixEngineResult;
+
+/**
+ * Settings applied by every worker to its reader and tags.
+ */
+typedef struct SrixEngineSettings {
+    uint8_t maxAttempts;              /* attempts of every block exchange, 0 = default */
+    SrixVerifyMode verifyMode;        /* verification of written blocks */
+    uint32_t timeoutMillis;           /* time available to a tag after its selection, 0 = no limit */
+    bool resetOTP;                    /* reset OTP blocks before writing a tag */
+    const SrixBlockEdit *edits;       /* blocks to modify before writing a tag, copied by SrixEngineNew */
+    size_t editsCount;                /* number of edits */
+} SrixEngineSettings;
+
+typedef struct SrixEngine SrixEngine;
+
+/**
+ * Create a new engine that will drive all available NFC readers.
+ * Readers are opened serially with the library context, that can't be used elsewhere while the engine is started.
+ * @param context library context used to search and open readers
+ * @param operation operation to do on every tag
+ * @param eeprom EEPROM to write with SRIX_ENGINE_WRITE (generic blocks), null to keep tag content
+ * @param settings settings of readers and tags, null for defaults
+ * @return null if there is an error, else an engine pointer
+ */
+SrixEngine *SrixEngineNew(SrixContext *context, SrixEngineOperation operation, const uint32_t *eeprom,
+                          const SrixEngineSettings *settings);
+
+/**
+ * Record the radio operations of every reader, from the next SrixEngineStart.
+ * @param engine pointer to SrixEngine
+ * @param capacity maximum number of events recorded for every reader
+ */
+void SrixEngineEnableTrace(SrixEngine *engine, size_t capacity);
+
+/**
+ * Save the radio operations recorded by all readers as Chrome trace event JSON.
+ * Engine has to be stopped, so traces aren't modified while they are saved.
+ * @param engine pointer to SrixEngine
+ * @param filename name of JSON file
+ * @return SrixError result
+ */
+SrixError SrixEngineExportTrace(SrixEngine *engine, const char *filename);
+
+/**
+ * Open every available reader and start a worker thread for each of them.
+ * @param engine pointer to SrixEngine
+ * @return number of readers started
+ */
+size_t SrixEngineStart(SrixEngine *engine);
+
+/**
+ * Get the next processed tag.
+ * @param engine pointer to SrixEngine
+ * @param result pointer where save the result
+ * @param timeoutMillis maximum time to wait for a result
+ * @return true if a result has been saved, false if timeout expired
+ */
+bool SrixEngineNextResult(SrixEngine *engine, SrixEngineResult *result, uint32_t timeoutMillis);
+
+/**
+ * Stop all worker threads and close their readers.
+ * @param engine pointer to SrixEngine
+ */
+void SrixEngineStop(SrixEngine *engine);
+
+/**
+ * Stop the engine and free its memory.
+ * @param engine pointer to SrixEngine
+ */
+void SrixEngineDelete(SrixEngine *engine);
+
+#endif /* ENGINE_H */
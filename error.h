@@ -11,7 +11,13 @@
 typedef enum {
     SRIX_SUCCESS,
     NFC_ERROR = INT8_MIN,
-    SRIX_ERROR
+    SRIX_ERROR,
+    NFC_SHORT_RESPONSE,  /* tag answered with an unexpected length */
+    NFC_TAG_MISSING,     /* tag left the field and can't be selected again */
+    NFC_WRITE_MISMATCH,  /* read-back of a written block differs */
+    SRIX_CANCELLED,      /* operation cancelled before its completion */
+    SRIX_TIMEOUT,        /* deadline of operation expired */
+    SRIX_DENIED          /* tag rejected by the UID filter */
 } SrixErrorCode;
 
 /**
@@ -20,10 +26,13 @@ typedef enum {
 typedef struct SrixError {
     SrixErrorCode errorType;
     char const *message;
+    uint8_t attempts;    /* attempts used by the failed operation */
 } SrixError;
 
 #define SRIX_NO_ERROR                     ((SrixError) {.errorType = SRIX_SUCCESS})
 #define SRIX_ERROR(type, errorMessage)    ((SrixError) {.errorType = (type), .message = (errorMessage)})
+#define SRIX_ERROR_ATTEMPTS(type, errorMessage, attemptsCount) \
+    ((SrixError) {.errorType = (type), .message = (errorMessage), .attempts = (attemptsCount)})
 #define SRIX_IS_ERROR(isError)            ((isError).errorType != SRIX_SUCCESS)
 
 /**
@@ -0,0 +1,182 @@
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "journal.h"
+
+#define JOURNAL_MAGIC       "SRIXJRNL"
+#define JOURNAL_VERSION     1
+#define JOURNAL_BYTE_ORDER  0x01020304U
+#define JOURNAL_EXTENSION   ".jrnl"
+
+/**
+ * Journal file header, followed by a byte for every confirmed block.
+ */
+typedef struct JournalHeader {
+    char magic[8];                      /* JOURNAL_MAGIC */
+    uint32_t version;                   /* JOURNAL_VERSION */
+    uint32_t byteOrder;                 /* JOURNAL_BYTE_ORDER written in host order */
+    uint64_t uid;                       /* UID of tag */
+    uint32_t planned[4];                /* blocks of planned write set */
+    uint32_t values[SRIX4K_BLOCKS];     /* value to write of every planned block */
+} JournalHeader;
+
+/**
+ * Write journal in a directory.
+ */
+struct SrixJournal {
+    char *directory;                    /* journal directory path */
+    int file;                           /* journal file of current write, -1 if there isn't one */
+    uint64_t uid;                       /* UID of current write */
+};
+
+/**
+ * Build path of a journal file.
+ * @param journal pointer to SrixJournal
+ * @param uid UID of tag
+ * @param suffix added after the extension
+ * @param path buffer where save path
+ * @param size size of path buffer
+ */
+static void journalPath(SrixJournal *journal, uint64_t uid, const char *suffix, char *path, size_t size) {
+    snprintf(path, size, "%s/%016" PRIX64 JOURNAL_EXTENSION "%s", journal->directory, uid, suffix);
+}
+
+/**
+ * Check if a block is set in a bitmap.
+ * @param bitmap bitmap of blocks
+ * @param block block to check
+ * @return true if block is set
+ */
+static inline bool journalBlockGet(const uint32_t bitmap[static 4], uint8_t block) {
+    return bitmap[block / 32] & 1U << block % 32;
+}
+
+SrixJournal *SrixJournalNew(const char *directory) {
+    /* Create directory if it doesn't exist */
+    mkdir(directory, 0755);
+
+    struct stat info;
+    if (stat(directory, &info) != 0 || !S_ISDIR(info.st_mode)) {
+        return (void *) 0;
+    }
+
+    SrixJournal *created = malloc(sizeof(SrixJournal));
+    if (!created) {
+        return (void *) 0;
+    }
+
+    created->directory = strdup(directory);
+    if (!created->directory) {
+        free(created);
+        return (void *) 0;
+    }
+
+    created->file = -1;
+    created->uid = 0;
+    return created;
+}
+
+void SrixJournalDelete(SrixJournal journal[static 1]) {
+    SrixJournalEnd(journal, false);
+    free(journal->directory);
+    free(journal);
+}
+
+bool SrixJournalLoad(SrixJournal journal[static 1], uint64_t uid, SrixJournalRecord record[static 1]) {
+    char path[PATH_MAX];
+    journalPath(journal, uid, "", path, sizeof(path));
+
+    FILE *input = fopen(path, "rb");
+    if (!input) {
+        return false;
+    }
+
+    JournalHeader header;
+    if (fread(&header, sizeof(header), 1, input) != 1 || memcmp(header.magic, JOURNAL_MAGIC, 8) != 0 ||
+        header.version != JOURNAL_VERSION || header.byteOrder != JOURNAL_BYTE_ORDER || header.uid != uid) {
+        fclose(input);
+        return false;
+    }
+
+    *record = (SrixJournalRecord) {.uid = uid};
+    memcpy(record->planned, header.planned, sizeof(record->planned));
+    memcpy(record->values, header.values, sizeof(record->values));
+
+    /* Confirmations are single bytes, so an interrupted append can't leave a partial one */
+    int block;
+    while ((block = fgetc(input)) != EOF) {
+        if (block < SRIX4K_BLOCKS && journalBlockGet(record->planned, block)) {
+            record->confirmed[block / 32] |= 1U << block % 32;
+        }
+    }
+
+    fclose(input);
+    return true;
+}
+
+void SrixJournalRemove(SrixJournal journal[static 1], uint64_t uid) {
+    char path[PATH_MAX];
+    journalPath(journal, uid, "", path, sizeof(path));
+    remove(path);
+}
+
+SrixError SrixJournalBegin(SrixJournal journal[static 1], const SrixJournalRecord record[static 1]) {
+    SrixJournalEnd(journal, false);
+
+    JournalHeader header = {
+            .version = JOURNAL_VERSION,
+            .byteOrder = JOURNAL_BYTE_ORDER,
+            .uid = record->uid
+    };
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    memcpy(header.planned, record->planned, sizeof(header.planned));
+    memcpy(header.values, record->values, sizeof(header.values));
+
+    char temporary[PATH_MAX];
+    char path[PATH_MAX];
+    journalPath(journal, record->uid, ".tmp", temporary, sizeof(temporary));
+    journalPath(journal, record->uid, "", path, sizeof(path));
+
+    /* Planned set replaces the previous write only when it's completely on disk */
+    int file = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (file < 0) {
+        return SRIX_ERROR(SRIX_ERROR, "unable to create journal file");
+    }
+
+    if (write(file, &header, sizeof(header)) != sizeof(header) || fsync(file) != 0 ||
+        rename(temporary, path) != 0) {
+        close(file);
+        remove(temporary);
+        return SRIX_ERROR(SRIX_ERROR, "incorrect journal file write");
+    }
+
+    journal->file = file;
+    journal->uid = record->uid;
+    return SRIX_NO_ERROR;
+}
+
+void SrixJournalConfirm(SrixJournal journal[static 1], uint8_t block) {
+    if (journal->file >= 0) {
+        (void) !write(journal->file, &block, sizeof(block));
+    }
+}
+
+void SrixJournalEnd(SrixJournal journal[static 1], bool completed) {
+    if (journal->file < 0) {
+        return;
+    }
+
+    close(journal->file);
+    journal->file = -1;
+
+    if (completed) {
+        char path[PATH_MAX];
+        journalPath(journal, journal->uid, "", path, sizeof(path));
+        remove(path);
+    }
+}
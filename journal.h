@@ -0,0 +1,75 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "error.h"
+
+typedef struct SrixJournal SrixJournal;
+
+/**
+ * Write of a tag recorded in a journal.
+ * Bitmaps have a bit for every block: bit (block % 32) of word (block / 32).
+ */
+typedef struct SrixJournalRecord {
+    uint64_t uid;                       /* UID of tag */
+    uint32_t planned[4];                /* blocks of planned write set */
+    uint32_t confirmed[4];              /* planned blocks confirmed by read-back */
+    uint32_t values[SRIX4K_BLOCKS];     /* value to write of every planned block */
+} SrixJournalRecord;
+
+/**
+ * Open a write journal saved in a directory, one journal file for every tag with an unfinished write.
+ * A journal keeps a single write open, so it has to be used by one Srix at a time.
+ * @param directory path of journal directory, created if it doesn't exist
+ * @return null if there is an error, else a SrixJournal pointer
+ */
+SrixJournal *SrixJournalNew(const char *directory);
+
+/**
+ * Close a write journal and free its memory, journal files of unfinished writes are kept.
+ * @param journal pointer to SrixJournal
+ */
+void SrixJournalDelete(SrixJournal *journal);
+
+/**
+ * Load the unfinished write of a tag.
+ * @param journal pointer to SrixJournal
+ * @param uid UID of tag
+ * @param record pointer where save the write
+ * @return true if the tag has an unfinished write
+ */
+bool SrixJournalLoad(SrixJournal *journal, uint64_t uid, SrixJournalRecord *record);
+
+/**
+ * Remove the unfinished write of a tag, if there is one.
+ * @param journal pointer to SrixJournal
+ * @param uid UID of tag
+ */
+void SrixJournalRemove(SrixJournal *journal, uint64_t uid);
+
+/**
+ * Start recording a write, replacing the unfinished write of the same tag.
+ * The planned write set is on disk when this function returns.
+ * @param journal pointer to SrixJournal
+ * @param record planned write, its confirmed blocks are ignored
+ * @return SrixError result
+ */
+SrixError SrixJournalBegin(SrixJournal *journal, const SrixJournalRecord *record);
+
+/**
+ * Record a block of the current write confirmed by read-back.
+ * Confirmations aren't synced to disk: a lost confirmation only makes the block written again.
+ * @param journal pointer to SrixJournal
+ * @param block confirmed block
+ */
+void SrixJournalConfirm(SrixJournal *journal, uint8_t block);
+
+/**
+ * Close the current write, removing it from the journal if it has been completed.
+ * @param journal pointer to SrixJournal
+ * @param completed true if all planned blocks have been written
+ */
+void SrixJournalEnd(SrixJournal *journal, bool completed);
+
+#endif /* JOURNAL_H */
@@ -1,10 +1,76 @@
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdbool.h>
 #include <inttypes.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include "archive.h"
+#include "batch.h"
+#include "cache.h"
+#include "dump.h"
+#include "engine.h"
+#include "journal.h"
+#include "output.h"
+#include "pipeline.h"
+#include "pn532.h"
+#include "reader.h"
+#include "session.h"
 #include "srix.h"
+#include "trace.h"
+#include "uidindex.h"
+
+/* Set by SIGINT to stop long running modes */
+static volatile sig_atomic_t interrupted = 0;
+
+/* Trace of NFC reader, saved at exit */
+static NfcTrace *trace = (void *) 0;
+static const char *traceFile = (void *) 0;
+
+/* Library context of NFC readers, deleted at exit */
+static SrixContext *context = (void *) 0;
+
+/* NFC session recorded from the reader, or replayed instead of the reader */
+static const char *recordFile = (void *) 0;
+static NfcReplay *replay = (void *) 0;
+
+/* Write journal, closed at exit */
+static SrixJournal *journal = (void *) 0;
+
+/* Index of allowed UIDs, closed at exit */
+static SrixUidIndex *allowIndex = (void *) 0;
+
+/* Requested baud rate of PN532 UART readers, 0 = default */
+static uint32_t linkBaudRate = 0;
+
+/* Format of printed tags */
+static SrixOutputFormat outputFormat = SRIX_OUTPUT_TEXT;
+
+/* Save raw dumps without checksum, for programs that read only the legacy layout */
+static bool rawDumps = false;
+
+/**
+ * Outputs of stream and tray modes, written by the pipeline workers while the reader processes the next tag.
+ */
+typedef struct TagOutputs {
+    bool print;                       /* print UID and EEPROM of every tag */
+    const char *dumpDirectory;        /* directory where save a dump of every tag, can be null */
+    const char *archiveFile;          /* archive where append every tag, can be null */
+    pthread_mutex_t archiveLock;      /* serializes appends of different workers */
+} TagOutputs;
+
+
+/**
+ * Get the stream of status messages, so stdout holds only printed tags when their format isn't text.
+ * @return stdout with the text format, else stderr
+ */
+static FILE *statusStream(void) {
+    return outputFormat == SRIX_OUTPUT_TEXT ? stdout : stderr;
+}
 
 
 /**
@@ -12,146 +78,912 @@
  * @param executable name of executable
  */
 static void printUsage(const char *executable) {
-    printf("Usage: %s [-h] [-p] [-r file] [-w file] [-c] [-o]\n\n", executable);
+    printf("Usage: %s [-h] [-p] [-r file] [-w file] [-c] [-o] [-a attempts] [-v mode] [-m count] [-s count] [-l] [-k dir] [-A archive] [-i archive] [-e block=value] [-n] [-t trace] [-R session] [-P session [-x speed]] [-T millis] [-M] [-W workers] [-L baud] [-j dir] [-g index] [-f format] [-F]\n", executable);
+    printf("       %s -b threads [-p] [-f format] [-o] [-e block=value] [-w directory] [-F] dump...\n", executable);
+    printf("       %s -b threads -V dump...\n", executable);
+    printf("       %s -I archive dump...\n", executable);
+    printf("       %s -U index list...\n", executable);
+    printf("       %s -E archive [directory]\n\n", executable);
     printf("Options:\n");
     printf("  -h        show this help message\n");
     printf("  -p        print information about NFC tag\n");
+    printf("  -f fmt    format of printed tags: text (default), jsonl, csv, hex\n");
     printf("  -r file   read eeprom from a file, if not present read from NFC tag\n");
-    printf("  -w file   write eeprom to a file\n");
+    printf("  -w file   write eeprom to a file, a dump for every tag in a directory with -s and -M\n");
     printf("  -c        write changes to NFC tag eeprom\n");
     printf("  -o        reset SRIX4K OTP blocks\n");
+    printf("  -a num    maximum attempts for every block read or write (default 8)\n");
+    printf("  -v mode   verification of written blocks: block (default), full, sampled, final\n");
+    printf("  -m count  process count tags on all NFC readers in parallel (0 = until interrupted)\n");
+    printf("  -s count  process a stream of count tags keeping the reader open (0 = until interrupted)\n");
+    printf("  -l        read NFC tag blocks only when they are needed\n");
+    printf("  -k dir    cache dumps of known tags in a directory, to read only their volatile blocks\n");
+    printf("  -j dir    journal writes in a directory, to resume them when an interrupted tag is presented again\n");
+    printf("  -g file   allow only tags with a UID in the index file, printing the decision before reading blocks\n");
+    printf("  -U file   build a UID index file from text lists with a hexadecimal UID on every line\n");
+    printf("  -A file   append eeprom to an archive file\n");
+    printf("  -i file   load the latest dump of the tag in the field from an archive file, like -r\n");
+    printf("  -I file   import raw dump files into an archive file\n");
+    printf("  -E file   export every record of an archive file as raw dump\n");
+    printf("  -e b=v    set block b to value v (hexadecimal), can be repeated\n");
+    printf("  -n        print the write plan with its estimated cost instead of writing the tag\n");
+    printf("  -t file   save a Chrome trace JSON of every NFC command\n");
+    printf("  -R file   record the NFC session in a file\n");
+    printf("  -P file   replay a recorded NFC session instead of using a reader\n");
+    printf("  -x num    speed of replayed session (default 1 = original timing, 0 = no delay)\n");
+    printf("  -T ms     stop reading and writing the NFC tag ms milliseconds after its selection\n");
+    printf("  -M        process every tag in the reader field one after another, with anticollision\n");
+    printf("  -L num    negotiate a faster PN532 UART link, up to %d baud, keeping the default if it fails\n",
+           PN532_UART_MAX_BAUD_RATE);
+    printf("  -W num    output threads of -s and -M, so the reader never waits for files (default 1)\n");
+    printf("  -b num    process dump files, directories or patterns with num threads (0 = all CPUs),\n");
+    printf("            saving results in the -w directory\n");
+    printf("  -V        with -b, only check dump files and their checksum\n");
+    printf("  -F        save -w dumps in the raw %d bytes layout, without checksum\n", SRIX_DUMP_LENGTH);
+}
+
+
+/**
+ * Signal handler that stops long running modes.
+ * @param signal received signal
+ */
+static void onInterrupt(int signal) {
+    (void) signal;
+    interrupted = 1;
+}
+
+
+/**
+ * Save the NFC trace, called at exit so also failed runs are traced.
+ */
+static void saveTrace() {
+    SrixError error = NfcTraceExport(traceFile, &trace, 1);
+    if (SRIX_IS_ERROR(error)) {
+        fprintf(stderr, "Unable to save trace: %s\n", error.message);
+    } else if (trace->dropped) {
+        fprintf(stderr, "Trace buffer full, %zu events dropped\n", trace->dropped);
+    }
+
+    NfcTraceDelete(trace);
+}
+
+
+/**
+ * Delete the library context, called at exit.
+ */
+static void deleteContext() {
+    SrixContextDelete(context);
+}
+
+
+/**
+ * Print the counters of the replayed session and close it, called at exit.
+ */
+static void closeReplay() {
+    NfcReplayStats stats = NfcReplayGetStats(replay);
+    fprintf(stderr, "Replayed %zu of %zu session records (%zu skipped, %zu operations diverged)\n",
+            stats.replayed, stats.records, stats.skipped, stats.diverged);
+    NfcReplayClose(replay);
+}
+
+
+/**
+ * Close the write journal, keeping unfinished writes, called at exit.
+ */
+static void closeJournal() {
+    SrixJournalDelete(journal);
+}
+
+
+/**
+ * Close the index of allowed UIDs, called at exit.
+ */
+static void closeAllowIndex() {
+    SrixUidIndexClose(allowIndex);
+}
+
+
+/**
+ * Print the allow or deny decision of a tag as soon as its UID is known.
+ * @param uid UID of tag
+ * @param data pointer to SrixUidIndex of allowed UIDs
+ * @return true if tag is allowed
+ */
+static bool checkUid(uint64_t uid, void *data) {
+    bool allowed = SrixUidIndexContains(data, uid);
+    fprintf(statusStream(), "UID %016" PRIX64 " %s\n", uid, allowed ? "allowed" : "denied");
+    fflush(statusStream());
+    return allowed;
+}
+
+
+/**
+ * Get current time in seconds from a monotonic clock.
+ * @return time in seconds
+ */
+static double monotonicSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+
+/**
+ * Parse verification mode name.
+ * @param name name of verification mode
+ * @param mode pointer where save parsed mode
+ * @return boolean result
+ */
+static bool parseVerifyMode(const char *name, SrixVerifyMode *mode) {
+    static const char *const names[] = {
+            [SRIX_VERIFY_BLOCK] = "block",
+            [SRIX_VERIFY_FULL] = "full",
+            [SRIX_VERIFY_SAMPLED] = "sampled",
+            [SRIX_VERIFY_FINAL] = "final"
+    };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *mode = (SrixVerifyMode) i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ * Parse a decimal count of tags.
+ * @param text text to parse
+ * @param count pointer where save parsed count
+ * @return boolean result
+ */
+static bool parseCount(const char *text, unsigned long *count) {
+    char *end;
+    errno = 0;
+    unsigned long value = strtoul(text, &end, 10);
+    if (end == text || *end != '\0' || *text == '-' || errno == ERANGE) {
+        return false;
+    }
+
+    *count = value;
+    return true;
+}
+
+
+/**
+ * Parse a replay speed, a decimal number not lower than 0.
+ * @param text text to parse
+ * @param speed pointer where save parsed speed
+ * @return boolean result
+ */
+static bool parseSpeed(const char *text, double *speed) {
+    char *end;
+    double value = strtod(text, &end);
+    if (end == text || *end != '\0' || !(value >= 0)) {
+        return false;
+    }
+
+    *speed = value;
+    return true;
+}
+
+
+/**
+ * Parse a block edit in "block=value" format, both hexadecimal.
+ * @param text text to parse
+ * @param edit pointer where save parsed edit
+ * @return boolean result
+ */
+static bool parseBlockEdit(const char *text, SrixBlockEdit *edit) {
+    char *end;
+    unsigned long block = strtoul(text, &end, 16);
+    if (end == text || *end != '=' || block >= SRIX4K_BLOCKS) {
+        return false;
+    }
+
+    const char *valueText = end + 1;
+    unsigned long long value = strtoull(valueText, &end, 16);
+    if (end == valueText || *end != '\0' || value > UINT32_MAX) {
+        return false;
+    }
+
+    edit->block = (uint8_t) block;
+    edit->value = (uint32_t) value;
+    return true;
+}
+
+
+/**
+ * List available NFC readers and let the user choose one.
+ * @param srix struct used to search readers
+ * @return index of selected reader, -1 if there are no readers
+ */
+static int selectReader(Srix *srix) {
+    /* Get readers number */
+    size_t readersNumber = NfcGetReadersCount(srix);
+
+    /* Exit if no readers available */
+    if (readersNumber == 0) {
+        fprintf(stderr, "Unable to find an NFC reader\n");
+        return -1;
+    }
+
+    /* Print all readers */
+    fprintf(statusStream(), "Readers:\n");
+    for (size_t i = 0; i < readersNumber; i++) {
+        fprintf(statusStream(), "[%" PRIu8 "] -> %s\n", (uint8_t) i, NfcGetDescription(srix, (int) i));
+    }
+
+    /* Reader selector */
+    uint8_t targetReader = 0;
+    if (readersNumber > 1) {
+        fprintf(statusStream(), "Found %zu readers available\n", readersNumber);
+
+        /* Retry while input is out of range */
+        do {
+            fprintf(statusStream(), "Insert the target reader [0-%zu]: ", readersNumber - 1);
+            fflush(statusStream());
+            /* While input is invalid, clean input and retry */
+            char buffer[8];
+            fgets(buffer, sizeof(buffer), stdin);
+            targetReader = strtol(buffer, (void *) 0, 10);
+        } while (targetReader >= readersNumber);
+    }
+
+    return targetReader;
+}
+
+
+/**
+ * Open the selected NFC reader, or the replayed session, and start recording if requested.
+ * @param srix struct where open the reader
+ * @return null if there is no error, else string error result
+ */
+static const char *openReader(Srix *srix) {
+    const char *error;
+    if (replay) {
+        error = SrixNfcOpenTransport(srix, &NFC_REPLAY_TRANSPORT, replay);
+    } else {
+        int targetReader = selectReader(srix);
+        error = targetReader < 0 ? "no reader available" : SrixNfcOpen(srix, targetReader);
+    }
+
+    if (!error && linkBaudRate) {
+        uint32_t effective = SrixNfcGetLinkBaudRate(srix);
+        if (effective == linkBaudRate) {
+            fprintf(statusStream(), "Reader link at %" PRIu32 " baud\n", effective);
+        } else if (effective) {
+            fprintf(stderr, "Reader link refused %" PRIu32 " baud, using %" PRIu32 " baud\n", linkBaudRate,
+                    effective);
+        } else {
+            fprintf(stderr, "Reader link speed can't be changed, using its default one\n");
+        }
+    }
+
+    if (!error && recordFile) {
+        error = SrixNfcRecord(srix, recordFile);
+    }
+    return error;
+}
+
+
+/**
+ * Print what an interrupted NFC operation has done.
+ * @param srix struct of interrupted operation
+ */
+static void printProgress(Srix *srix) {
+    SrixProgress progress = SrixGetProgress(srix);
+    fprintf(stderr, "%" PRIu8 " blocks read, %" PRIu8 " blocks written, %" PRIu8 " blocks still to write\n",
+            progress.loadedCount, progress.writtenCount, progress.pendingCount);
+}
+
+
+/**
+ * Initialize srix from NFC.
+ * @param srix struct to initialize
+ * @param timeoutMillis time available to all NFC operations on the tag after its selection, 0 for no limit
+ * @return boolean result
+ */
+static bool readFromNfc(Srix *srix, uint32_t timeoutMillis) {
+    /* Open reader and wait for a SRIX4K */
+    const char *error = openReader(srix);
+    if (!error) {
+        SrixSetTagTimeout(srix, timeoutMillis);
+        error = SrixNfcNextTag(srix, true);
+    }
+    if (error) {
+        /* If result isn't null, print error */
+        fprintf(stderr, "Unable to read NFC tag: %s\n", error);
+        if (SrixGetLatestError(srix).errorType == SRIX_TIMEOUT) {
+            printProgress(srix);
+        }
+        return false;
+    }
+
+    fprintf(statusStream(), "Tag read in %" PRIu32 " round trips\n", SrixGetRoundTrips(srix));
+    return true;
+}
+
+
+/**
+ * Print UID and EEPROM of a srix.
+ * @param srix struct to print
+ */
+static void printSrix(Srix *srix) {
+    if (SrixPrefetchBlocks(srix, 0, SRIX4K_BLOCKS) != SRIX_SUCCESS) {
+        fprintf(stderr, "Unable to read NFC tag: %s\n", SrixGetLatestError(srix).message);
+        return;
+    }
+
+    uint32_t eeprom[SRIX4K_BLOCKS];
+    for (int i = 0; i < SRIX4K_BLOCKS; i++) {
+        eeprom[i] = *SrixGetBlock(srix, i);
+    }
+
+    /* Whole tag printed with a single write, after messages still buffered by stdio */
+    fflush(stdout);
+    SrixError error = SrixOutputWrite(STDOUT_FILENO, outputFormat, SrixGetUid(srix), eeprom);
+    if (SRIX_IS_ERROR(error)) {
+        fprintf(stderr, "Unable to print NFC tag: %s\n", error.message);
+    }
+}
+
+
+/**
+ * Print the header of the output format, if it has one.
+ */
+static void printOutputHeader(void) {
+    char buffer[SRIX_OUTPUT_MAX_LENGTH];
+    size_t length = SrixOutputEncodeHeader(outputFormat, buffer);
+    if (length > 0) {
+        fflush(stdout);
+        (void) SrixOutputWriteAll(STDOUT_FILENO, buffer, length);
+    }
+}
+
+
+/**
+ * Print the write plan of a Srix.
+ * @param srix pointer to Srix
+ */
+static void printWritePlan(Srix *srix) {
+    SrixWritePlan plan;
+    SrixCompileWritePlan(srix, &plan);
+
+    printf("Write plan: %" PRIu8 " blocks, about %" PRIu32 " round trips\n", plan.blocks, plan.roundTrips);
+    for (uint8_t i = 0; i < plan.count; i++) {
+        const SrixWriteStep *step = &plan.steps[i];
+        switch (step->type) {
+            case SRIX_STEP_WRITE:
+                printf("  [%02X] <- %08" PRIX32 " write and read back (%" PRIu16 ")\n", step->block, step->value,
+                       step->roundTrips);
+                break;
+            case SRIX_STEP_WRITE_UNCHECKED:
+                printf("  [%02X] <- %08" PRIX32 " write (%" PRIu16 ")\n", step->block, step->value,
+                       step->roundTrips);
+                break;
+            case SRIX_STEP_VERIFY:
+                printf("  read back %" PRIu8 " blocks, one every %" PRIu8 " (%" PRIu16 ")\n", step->block,
+                       step->sampleStep, step->roundTrips);
+                break;
+        }
+    }
+}
+
+
+/**
+ * Reset SRIX4K OTP blocks, decreasing the block 6 counter.
+ * @param srix struct to modify
+ * @return boolean result, false if counter can't be decreased
+ */
+static bool resetOtpBlocks(Srix *srix) {
+    if (SrixResetOtp(srix) != SRIX_SUCCESS) {
+        fprintf(stderr, "Unable to reset OTP blocks: %s\n", SrixGetLatestError(srix).message);
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Initialize srix from a file.
+ * @param srix struct to initialize
+ * @param filename name of file
+ * @return boolean result
+ */
+static bool readFromFile(Srix *srix, char *filename) {
+    uint32_t blocks[SRIX4K_BLOCKS];
+    uint64_t uid;
+
+    SrixError error = SrixDumpLoad(filename, blocks, &uid);
+    if (SRIX_IS_ERROR(error)) {
+        fprintf(stderr, "Unable to read input file: %s\n", error.message);
+        return false;
+    }
+
+    /* Save data to SRIX struct */
+    SrixMemoryInit(srix, blocks, uid);
+    return true;
+}
+
+
+/**
+ * Initialize srix with the most recent archive record of its tag.
+ * @param srix struct with a read tag
+ * @param filename name of archive file
+ * @return boolean result
+ */
+static bool readFromArchive(Srix *srix, const char *filename) {
+    SrixArchive *archive = SrixArchiveOpen(filename);
+    if (!archive) {
+        fprintf(stderr, "Unable to open archive file\n");
+        return false;
+    }
+
+    const SrixArchiveRecord *record = SrixArchiveFind(archive, SrixGetUid(srix));
+    if (!record) {
+        fprintf(stderr, "UID %016" PRIX64 " isn't in the archive\n", SrixGetUid(srix));
+        SrixArchiveClose(archive);
+        return false;
+    }
+
+    /* Record is copied, archive mapping can be closed */
+    SrixMemoryInit(srix, record->eeprom, record->uid);
+    SrixArchiveClose(archive);
+    return true;
+}
+
+
+/**
+ * Save data to a file.
+ * @param srix struct to save
+ * @param filename name of file
+ * @return boolean result
+ */
+static bool writeToFile(Srix *srix, char *filename) {
+    if (SrixPrefetchBlocks(srix, 0, SRIX4K_BLOCKS) != SRIX_SUCCESS) {
+        fprintf(stderr, "Unable to read NFC tag: %s\n", SrixGetLatestError(srix).message);
+        return false;
+    }
+
+    uint32_t blocks[SRIX4K_BLOCKS];
+    for (int i = 0; i < SRIX4K_BLOCKS; i++) {
+        blocks[i] = *SrixGetBlock(srix, i);
+    }
+
+    SrixError error = rawDumps ? SrixDumpSaveRaw(filename, blocks, SrixGetUid(srix))
+                               : SrixDumpSave(filename, blocks, SrixGetUid(srix));
+    if (SRIX_IS_ERROR(error)) {
+        fprintf(stderr, "Unable to write output file: %s\n", error.message);
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Append data to an archive file.
+ * @param srix struct to save
+ * @param filename name of archive file
+ * @return boolean result
+ */
+static bool appendToArchive(Srix *srix, const char *filename) {
+    if (SrixPrefetchBlocks(srix, 0, SRIX4K_BLOCKS) != SRIX_SUCCESS) {
+        fprintf(stderr, "Unable to read NFC tag: %s\n", SrixGetLatestError(srix).message);
+        return false;
+    }
+
+    SrixArchiveRecord record = {.uid = SrixGetUid(srix), .timestamp = time((void *) 0)};
+    for (int i = 0; i < SRIX4K_BLOCKS; i++) {
+        record.eeprom[i] = *SrixGetBlock(srix, i);
+    }
+
+    SrixError error = SrixArchiveAppend(filename, &record, 1);
+    if (SRIX_IS_ERROR(error)) {
+        fprintf(stderr, "Unable to write archive: %s\n", error.message);
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Apply the requested operations to the tag read by a Srix.
+ * @param srix struct with a read tag
+ * @param eeprom EEPROM to load on the tag before processing it, null to keep tag content
+ * @param resetOTP true to reset OTP blocks
+ * @param writeTag true to write changes to the tag
+ * @return boolean result
+ */
+static bool processTag(Srix *srix, const uint32_t *eeprom, bool resetOTP, bool writeTag) {
+    bool result = true;
+
+    /* An interrupted write already contains the planned changes, counters aren't decreased twice */
+    if (writeTag && SrixResumeWrite(srix)) {
+        fprintf(statusStream(), "UID %016" PRIX64 " resuming interrupted write\n", SrixGetUid(srix));
+        eeprom = (void *) 0;
+        resetOTP = false;
+    }
+
+    if (eeprom) {
+        SrixMemoryInit(srix, eeprom, SrixGetUid(srix));
+    }
+
+    if (resetOTP) {
+        result = resetOtpBlocks(srix);
+    }
+
+    if (result && writeTag && SrixWriteBlocks(srix) != SRIX_SUCCESS) {
+        fprintf(stderr, "Unable to write blocks to SRIX4K: %s\n", SrixGetLatestError(srix).message);
+        result = false;
+    }
+
+    return result;
+}
+
+
+/**
+ * Pipeline stage: save the dump of a tag in the dump directory.
+ * @param snapshot tag to save
+ * @param data pointer to TagOutputs
+ * @return boolean result
+ */
+static bool saveTag(SrixSnapshot *snapshot, void *data) {
+    const TagOutputs *outputs = data;
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%016" PRIX64 ".bin", outputs->dumpDirectory, snapshot->uid);
+
+    SrixError error = rawDumps ? SrixDumpSaveRaw(path, snapshot->eeprom, snapshot->uid)
+                               : SrixDumpSave(path, snapshot->eeprom, snapshot->uid);
+    if (SRIX_IS_ERROR(error)) {
+        fprintf(stderr, "UID %016" PRIX64 " unable to write output file: %s\n", snapshot->uid, error.message);
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Pipeline stage: append a tag to the archive file.
+ * @param snapshot tag to append
+ * @param data pointer to TagOutputs
+ * @return boolean result
+ */
+static bool archiveTag(SrixSnapshot *snapshot, void *data) {
+    TagOutputs *outputs = data;
+
+    SrixArchiveRecord record = {.uid = snapshot->uid, .timestamp = time((void *) 0)};
+    memcpy(record.eeprom, snapshot->eeprom, sizeof(record.eeprom));
+
+    /* A new archive gets its header from the first append */
+    pthread_mutex_lock(&outputs->archiveLock);
+    SrixError error = SrixArchiveAppend(outputs->archiveFile, &record, 1);
+    pthread_mutex_unlock(&outputs->archiveLock);
+
+    if (SRIX_IS_ERROR(error)) {
+        fprintf(stderr, "UID %016" PRIX64 " unable to write archive: %s\n", snapshot->uid, error.message);
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Pipeline stage: print the result of a tag, with its EEPROM if requested, in a single write.
+ * @param snapshot tag to print
+ * @param data pointer to TagOutputs
+ * @return boolean result
+ */
+static bool reportTag(SrixSnapshot *snapshot, void *data) {
+    const TagOutputs *outputs = data;
+    char buffer[SRIX_OUTPUT_MAX_LENGTH + 128];
+
+    int length = 0;
+    if (snapshot->chipId >= 0) {
+        length = snprintf(buffer, 128, "Chip %02X ", (unsigned int) snapshot->chipId);
+    }
+    length += snprintf(buffer + length, 128 - length, "UID %016" PRIX64 " done in %" PRIu32 " round trips, %.1f ms\n",
+                       snapshot->uid, snapshot->roundTrips, snapshot->millis);
+
+    size_t total = length < 128 ? (size_t) length : 127;
+
+    /* Records that aren't text are written alone, the status line goes to stderr */
+    if (statusStream() == stderr) {
+        if (SRIX_IS_ERROR(SrixOutputWriteAll(STDERR_FILENO, buffer, total))) {
+            return false;
+        }
+        total = 0;
+    }
+
+    if (outputs->print) {
+        total += SrixOutputEncode(outputFormat, snapshot->uid, snapshot->eeprom, buffer + total);
+    }
+
+    return total == 0 || !SRIX_IS_ERROR(SrixOutputWriteAll(STDOUT_FILENO, buffer, total));
 }
 
 
 /**
- * Initialize srix from NFC.
- * @param srix struct to initialize
- * @return boolean result
+ * Create the pipeline that writes the outputs of stream and tray modes.
+ * @param outputs outputs to write, they have to live until the pipeline is deleted
+ * @param workers number of output threads, 0 = one for every online CPU
+ * @return null if there is an error, else a started SrixPipeline
  */
-static bool readFromNfc(Srix *srix) {
-    /* Get readers number */
-    size_t readersNumber = NfcGetReadersCount(srix);
+static SrixPipeline *startOutputs(TagOutputs *outputs, unsigned long workers) {
+    fflush(stdout);
+    SrixPipeline *pipeline = SrixPipelineNew(PIPELINE_DEFAULT_CAPACITY, workers);
+    if (!pipeline) {
+        return (void *) 0;
+    }
 
-    /* Exit if no readers available */
-    if (readersNumber == 0) {
-        fprintf(stderr, "Unable to find an NFC reader\n");
-        return false;
+    /* Results are printed after the files, so a printed tag is already saved */
+    if (outputs->dumpDirectory) {
+        SrixPipelineAddStage(pipeline, saveTag, outputs);
+    }
+    if (outputs->archiveFile) {
+        SrixPipelineAddStage(pipeline, archiveTag, outputs);
     }
+    SrixPipelineAddStage(pipeline, reportTag, outputs);
 
-    /* Print all readers */
-    printf("Readers:\n");
-    for (size_t i = 0; i < readersNumber; i++) {
-        printf("[%" PRIu8 "] -> %s\n", (uint8_t) i, NfcGetDescription(srix, (int) i));
+    if (SrixPipelineStart(pipeline) == 0) {
+        SrixPipelineDelete(pipeline);
+        return (void *) 0;
     }
 
-    /* Reader selector */
-    uint8_t targetReader = 0;
-    if (readersNumber > 1) {
-        printf("Found %zu readers available\n", readersNumber);
+    return pipeline;
+}
 
-        /* Retry while input is out of range */
-        do {
-            printf("Insert the target reader [0-%zu]: ", readersNumber - 1);
-            /* While input is invalid, clean input and retry */
-            char buffer[8];
-            fgets(buffer, sizeof(buffer), stdin);
-            targetReader = strtol(buffer, (void *) 0, 10);
-        } while (targetReader >= readersNumber);
+
+/**
+ * Pass a processed tag to the pipeline workers, or print its failure.
+ * Blocks are read from the tag only if they are needed by an output.
+ * @param srix struct with the processed tag
+ * @param pipeline pipeline of outputs
+ * @param outputs outputs written by the pipeline
+ * @param tagResult result of the tag processing
+ * @param chipId chip ID selected by the anticollision, -1 if it isn't known
+ * @param tagStart time when the tag processing started
+ * @return true if the tag has been passed to the pipeline
+ */
+static bool pushTag(Srix *srix, SrixPipeline *pipeline, const TagOutputs *outputs, bool tagResult, int chipId,
+                    double tagStart) {
+    SrixSnapshot snapshot = {.chipId = chipId};
+    bool withBlocks = outputs->print || outputs->dumpDirectory || outputs->archiveFile;
+
+    if (tagResult) {
+        SrixError error = SrixSnapshotTake(srix, &snapshot, withBlocks);
+        if (SRIX_IS_ERROR(error)) {
+            fprintf(stderr, "Unable to read NFC tag: %s\n", error.message);
+            tagResult = false;
+        }
     }
 
-    /* Init nfc */
-    if (!SrixNfcInit(srix, targetReader)) {
-        /* If result is null, print error */
-        fprintf(stderr, "Selected reader is invalid\n");
+    if (!tagResult) {
+        if (chipId >= 0) {
+            fprintf(statusStream(), "Chip %02X ", (unsigned int) chipId);
+        }
+        fprintf(statusStream(), "UID %016" PRIX64 " failed in %" PRIu32 " round trips, %.1f ms\n",
+                SrixGetUid(srix), SrixGetRoundTrips(srix), (monotonicSeconds() - tagStart) * 1000);
+        fflush(statusStream());
         return false;
     }
 
+    /* Messages of the reader thread are printed before the outputs of the tag */
+    fflush(stdout);
+    snapshot.millis = (monotonicSeconds() - tagStart) * 1000;
+    SrixPipelinePush(pipeline, &snapshot);
     return true;
 }
 
 
 /**
- * Initialize srix from a file.
- * @param srix struct to initialize
- * @param filename name of file
+ * Wait for the outputs of all pushed tags and print the processing rate.
+ * @param pipeline pipeline of outputs, deleted by this function
+ * @param processed number of processed tags
+ * @param failed number of tags failed before the pipeline
+ * @param start time when the processing started
+ * @return number of failed tags, including the ones failed in the pipeline
+ */
+static unsigned long finishOutputs(SrixPipeline *pipeline, unsigned long processed, unsigned long failed,
+                                   double start) {
+    SrixPipelineStats stats = SrixPipelineFinish(pipeline);
+    SrixPipelineDelete(pipeline);
+    failed += stats.rejected;
+
+    double elapsed = monotonicSeconds() - start;
+    fprintf(statusStream(), "%lu tags (%lu failed) in %.2f s, %.2f tags/s\n", processed, failed, elapsed,
+            elapsed > 0 ? (double) processed / elapsed : 0);
+    if (stats.stalls) {
+        fprintf(stderr, "Reader waited for output threads %" PRIu64 " times\n", stats.stalls);
+    }
+
+    return failed;
+}
+
+
+/**
+ * Process a stream of tags with the same reader, keeping it open between tags.
+ * The reader thread only exchanges with tags, outputs are written by the pipeline workers.
+ * @param srix struct with an open reader
+ * @param eeprom EEPROM to load on every tag before processing it, null to keep tag content
+ * @param resetOTP true to reset OTP blocks of every tag
+ * @param writeTag true to write changes to every tag
+ * @param outputs outputs of every tag
+ * @param workers number of output threads
+ * @param count number of tags to process, 0 to run until interrupted
  * @return boolean result
  */
-static bool readFromFile(Srix *srix, char *filename) {
-    FILE *eeprom = fopen(filename, "r");
-    if (!eeprom) {
-        fprintf(stderr, "Unable to read input file\n");
+static bool streamFromNfc(Srix *srix, const uint32_t *eeprom, bool resetOTP, bool writeTag, TagOutputs *outputs,
+                          unsigned long workers, unsigned long count) {
+    const struct timespec pollDelay = {.tv_sec = 0, .tv_nsec = 20000000};
+
+    SrixPipeline *pipeline = startOutputs(outputs, workers);
+    if (!pipeline) {
+        fprintf(stderr, "Unable to start output threads\n");
         return false;
     }
 
-    // Read blocks
-    uint32_t blocks[SRIX4K_BLOCKS];
-    for (int i = 0; i < SRIX4K_BLOCKS; i++) {
-        uint8_t buffer[SRIX_BLOCK_LENGTH];
-        if (fread(buffer, sizeof(uint8_t), SRIX_BLOCK_LENGTH, eeprom) != SRIX_BLOCK_LENGTH) {
-            fprintf(stderr, "Incorrect read value from input file\n");
-            fclose(eeprom);
-            return false;
+    signal(SIGINT, onInterrupt);
+    double start = monotonicSeconds();
+    unsigned long processed = 0;
+    unsigned long failed = 0;
+
+    while (!interrupted && (count == 0 || processed < count)) {
+        /* Wait for the next tag */
+        double tagStart = monotonicSeconds();
+        if (SrixNfcNextTag(srix, false)) {
+            SrixError error = SrixGetLatestError(srix);
+            if (error.errorType == NFC_TAG_MISSING) {
+                nanosleep(&pollDelay, (void *) 0);
+                continue;
+            }
+
+            processed++;
+            failed++;
+            fprintf(stderr, "Tag error: %s\n", error.message);
+        } else {
+            processed++;
+            bool tagResult = processTag(srix, eeprom, resetOTP, writeTag);
+            failed += !pushTag(srix, pipeline, outputs, tagResult, -1, tagStart);
+        }
+
+        /* Wait for tag removal */
+        while (!interrupted && SrixNfcTagIsPresent(srix)) {
+            nanosleep(&pollDelay, (void *) 0);
         }
+    }
+
+    return finishOutputs(pipeline, processed, failed, start) == 0;
+}
+
 
-        blocks[i] = buffer[0] << 24 | buffer[1] << 16 | buffer[2] << 8 | buffer[3];
+/**
+ * Process every tag in the field of the reader, selecting them one after another with the anticollision.
+ * @param srix struct with an open reader
+ * @param eeprom EEPROM to load on every tag before processing it, null to keep tag content
+ * @param resetOTP true to reset OTP blocks of every tag
+ * @param writeTag true to write changes to every tag
+ * @param outputs outputs of every tag
+ * @param workers number of output threads
+ * @return boolean result
+ */
+static bool trayFromNfc(Srix *srix, const uint32_t *eeprom, bool resetOTP, bool writeTag, TagOutputs *outputs,
+                        unsigned long workers) {
+    double start = monotonicSeconds();
+    NfcInventory inventory;
+
+    const char *error = SrixNfcInventory(srix, &inventory);
+    if (error) {
+        fprintf(stderr, "Unable to find tags: %s\n", error);
+        return false;
+    }
+
+    if (!inventory.complete) {
+        fprintf(stderr, "Some tags kept colliding, only %" PRIu8 " tags will be processed\n", inventory.count);
     }
 
-    // Read UID
-    uint8_t uidBytes[SRIX_UID_LENGTH];
-    if (fread(uidBytes, sizeof(uint8_t), SRIX_UID_LENGTH, eeprom) != SRIX_UID_LENGTH) {
-        fprintf(stderr, "Incorrect read value from input file\n");
-        fclose(eeprom);
+    SrixPipeline *pipeline = startOutputs(outputs, workers);
+    if (!pipeline) {
+        fprintf(stderr, "Unable to start output threads\n");
         return false;
     }
 
-    uint64_t uid = (uint64_t) uidBytes[7] << 56U | (uint64_t) uidBytes[6] << 48U | (uint64_t) uidBytes[5] << 40U |
-                   (uint64_t) uidBytes[4] << 32U | (uint64_t) uidBytes[3] << 24U | (uint64_t) uidBytes[2] << 16U |
-                   (uint64_t) uidBytes[1] << 8U | (uint64_t) uidBytes[0];
+    unsigned long failed = 0;
+    for (uint8_t i = 0; i < inventory.count; i++) {
+        double tagStart = monotonicSeconds();
 
-    /* Save data to SRIX struct */
-    SrixMemoryInit(srix, blocks, uid);
-    fclose(eeprom);
-    return true;
+        error = SrixNfcSelectChip(srix, inventory.chipIds[i]);
+        if (error) {
+            failed++;
+            fprintf(stderr, "Chip %02" PRIX8 " error: %s\n", inventory.chipIds[i], error);
+            continue;
+        }
+
+        bool tagResult = processTag(srix, eeprom, resetOTP, writeTag);
+        failed += !pushTag(srix, pipeline, outputs, tagResult, inventory.chipIds[i], tagStart);
+    }
+
+    return finishOutputs(pipeline, inventory.count, failed, start) == 0 && inventory.complete;
 }
 
 
 /**
- * Save data to a file.
- * @param srix struct to save
- * @param filename name of file
+ * Read (or write) tags on all available readers at the same time.
+ * @param eeprom EEPROM to write on every tag, null to keep tag content
+ * @param writeTag true to write every tag, else they are only read
+ * @param settings settings of readers and tags
+ * @param printInformation true to print EEPROM of every tag
+ * @param count number of tags to process, 0 to run until interrupted
  * @return boolean result
  */
-static bool writeToFile(Srix *srix, char *filename) {
-    FILE *outputFile = fopen(filename, "w");
-    if (!outputFile) {
-        fprintf(stderr, "Unable to open output file\n");
+static bool readFromReaders(const uint32_t *eeprom, bool writeTag, const SrixEngineSettings *settings,
+                            bool printInformation, unsigned long count) {
+    SrixEngine *engine = SrixEngineNew(context, writeTag ? SRIX_ENGINE_WRITE : SRIX_ENGINE_READ, eeprom, settings);
+    if (!engine) {
+        fprintf(stderr, "Unable to allocate memory for engine\n");
         return false;
     }
 
-    // Write blocks
-    for (int i = 0; i < SRIX4K_BLOCKS; i++) {
-        uint32_t block = *SrixGetBlock(srix, i);
-        uint8_t buffer[SRIX_BLOCK_LENGTH] = {block >> 24, block >> 16, block >> 8, block};
+    if (traceFile) {
+        SrixEngineEnableTrace(engine, NFC_TRACE_DEFAULT_EVENTS);
+    }
 
-        if (fwrite(buffer, sizeof(uint8_t), SRIX_BLOCK_LENGTH, outputFile) != SRIX_BLOCK_LENGTH) {
-            fprintf(stderr, "Incorrect written value to output file\n");
-            fclose(outputFile);
-            return false;
+    size_t readers = SrixEngineStart(engine);
+    if (readers == 0) {
+        fprintf(stderr, "Unable to find an NFC reader\n");
+        SrixEngineDelete(engine);
+        return false;
+    }
+    fprintf(statusStream(), "Started %zu readers\n", readers);
+
+    signal(SIGINT, onInterrupt);
+    double start = monotonicSeconds();
+    unsigned long processed = 0;
+    unsigned long failed = 0;
+
+    while (!interrupted && (count == 0 || processed < count)) {
+        SrixEngineResult result;
+        if (!SrixEngineNextResult(engine, &result, 200)) {
+            continue;
+        }
+
+        processed++;
+        if (SRIX_IS_ERROR(result.error)) {
+            failed++;
+            fprintf(stderr, "[%d] error: %s\n", result.reader, result.error.message);
+            continue;
+        }
+
+        fprintf(statusStream(), "[%d] UID %016" PRIX64 " in %" PRIu32 " round trips\n", result.reader, result.uid,
+                result.roundTrips);
+        if (printInformation) {
+            fflush(stdout);
+            (void) SrixOutputWrite(STDOUT_FILENO, outputFormat, result.uid, result.eeprom);
         }
     }
 
-    // Write UID
-    uint64_t uid = SrixGetUid(srix);
-    uint8_t uidBytes[SRIX_UID_LENGTH] = {uid, uid >> 8, uid >> 16, uid >> 24, uid >> 32,
-                                         uid >> 40, uid >> 48, uid >> 56};
-    if (fwrite(uidBytes, sizeof(uint8_t), SRIX_UID_LENGTH, outputFile) != SRIX_UID_LENGTH) {
-        fprintf(stderr, "Incorrect written value to output file\n");
-        fclose(outputFile);
-        return false;
+    double elapsed = monotonicSeconds() - start;
+    SrixEngineStop(engine);
+
+    if (traceFile) {
+        SrixError error = SrixEngineExportTrace(engine, traceFile);
+        if (SRIX_IS_ERROR(error)) {
+            fprintf(stderr, "Unable to save trace: %s\n", error.message);
+        }
     }
+    SrixEngineDelete(engine);
 
-    fclose(outputFile);
-    return true;
+    fprintf(statusStream(), "%lu tags (%lu failed) in %.2f s, %.2f tags/s\n", processed, failed, elapsed,
+            elapsed > 0 ? (double) processed / elapsed : 0);
+    return failed == 0;
 }
 
 int main(int argc, char *argv[]) {
@@ -166,10 +998,35 @@ int main(int argc, char *argv[]) {
     char *writeFile = (void *) 0;
     bool writeTag = false;
     bool resetOTP = false;
+    long maxAttempts = 0;
+    SrixVerifyMode verifyMode = SRIX_VERIFY_BLOCK;
+    bool multiReader = false;
+    bool streamMode = false;
+    bool trayMode = false;
+    bool lazyRead = false;
+    char *cacheDirectory = (void *) 0;
+    char *journalDirectory = (void *) 0;
+    char *archiveFile = (void *) 0;
+    char *restoreArchive = (void *) 0;
+    char *importArchive = (void *) 0;
+    char *allowFile = (void *) 0;
+    char *buildIndex = (void *) 0;
+    char *exportArchive = (void *) 0;
+    SrixBlockEdit edits[SRIX4K_BLOCKS];
+    size_t editsCount = 0;
+    bool dryRun = false;
+    bool batchMode = false;
+    unsigned long batchThreads = 0;
+    bool verifyDumps = false;
+    unsigned long tagCount = 0;
+    char *replayFile = (void *) 0;
+    double replaySpeed = 1;
+    unsigned long timeoutMillis = 0;
+    unsigned long outputWorkers = 1;
 
     /* Parse input arguments */
     int param;
-    while ((param = getopt(argc, argv, "hpr:w:co")) != -1) {
+    while ((param = getopt(argc, argv, "hpf:r:w:coa:v:m:s:lk:j:g:U:A:i:I:E:e:nt:b:VFR:P:x:T:MW:L:")) != -1) {
         switch (param) {
             case 'h':
                 printUsage(argv[0]);
@@ -177,6 +1034,12 @@ int main(int argc, char *argv[]) {
             case 'p':
                 printInformation = true;
                 break;
+            case 'f':
+                if (!SrixOutputParseFormat(optarg, &outputFormat)) {
+                    fprintf(stderr, "Invalid output format: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
             case 'r':
                 readFile = optarg;
                 break;
@@ -189,81 +1052,435 @@ int main(int argc, char *argv[]) {
             case 'o':
                 resetOTP = true;
                 break;
+            case 'a':
+                maxAttempts = strtol(optarg, (void *) 0, 10);
+                if (maxAttempts < 1 || maxAttempts > UINT8_MAX) {
+                    fprintf(stderr, "Attempts must be between 1 and %d\n", UINT8_MAX);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'v':
+                if (!parseVerifyMode(optarg, &verifyMode)) {
+                    fprintf(stderr, "Unknown verification mode: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'm':
+                multiReader = true;
+                if (!parseCount(optarg, &tagCount)) {
+                    fprintf(stderr, "Invalid tag count: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 's':
+                streamMode = true;
+                if (!parseCount(optarg, &tagCount)) {
+                    fprintf(stderr, "Invalid tag count: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'l':
+                lazyRead = true;
+                break;
+            case 'k':
+                cacheDirectory = optarg;
+                break;
+            case 'j':
+                journalDirectory = optarg;
+                break;
+            case 'g':
+                allowFile = optarg;
+                break;
+            case 'U':
+                buildIndex = optarg;
+                break;
+            case 'A':
+                archiveFile = optarg;
+                break;
+            case 'i':
+                restoreArchive = optarg;
+                break;
+            case 'I':
+                importArchive = optarg;
+                break;
+            case 'E':
+                exportArchive = optarg;
+                break;
+            case 'e':
+                if (editsCount == SRIX4K_BLOCKS || !parseBlockEdit(optarg, &edits[editsCount])) {
+                    fprintf(stderr, "Invalid block edit: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                editsCount++;
+                break;
+            case 'n':
+                dryRun = true;
+                break;
+            case 't':
+                traceFile = optarg;
+                break;
+            case 'b':
+                batchMode = true;
+                if (!parseCount(optarg, &batchThreads)) {
+                    fprintf(stderr, "Invalid number of threads: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'V':
+                verifyDumps = true;
+                break;
+            case 'F':
+                rawDumps = true;
+                break;
+            case 'R':
+                recordFile = optarg;
+                break;
+            case 'P':
+                replayFile = optarg;
+                break;
+            case 'x':
+                if (!parseSpeed(optarg, &replaySpeed)) {
+                    fprintf(stderr, "Replay speed must be a number not lower than 0: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'T':
+                if (!parseCount(optarg, &timeoutMillis) || timeoutMillis > UINT32_MAX) {
+                    fprintf(stderr, "Invalid timeout: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'M':
+                trayMode = true;
+                break;
+            case 'W':
+                if (!parseCount(optarg, &outputWorkers) || outputWorkers == 0) {
+                    fprintf(stderr, "Output threads must be a positive number: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'L':
+                linkBaudRate = strtoul(optarg, (void *) 0, 10);
+                if (!NfcPn532BaudRateSupported(linkBaudRate) || linkBaudRate > PN532_UART_MAX_BAUD_RATE) {
+                    fprintf(stderr, "Unsupported baud rate: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
             default:
                 printUsage(argv[0]);
                 return EXIT_FAILURE;
         }
     }
 
-    Srix *srix = SrixNew();
+    /* UID index build */
+    if (buildIndex) {
+        size_t indexed;
+        SrixError error = SrixUidIndexImport(buildIndex, argv + optind, argc - optind, &indexed);
+        if (SRIX_IS_ERROR(error)) {
+            fprintf(stderr, "Unable to build UID index: %s\n", error.message);
+            return EXIT_FAILURE;
+        }
+
+        printf("Indexed %zu UIDs\n", indexed);
+        return EXIT_SUCCESS;
+    }
+
+    /* Archive import */
+    if (importArchive) {
+        SrixError error = SrixArchiveImport(importArchive, argv + optind, argc - optind);
+        if (SRIX_IS_ERROR(error)) {
+            fprintf(stderr, "Unable to import dumps: %s\n", error.message);
+            return EXIT_FAILURE;
+        }
+
+        printf("Imported %d dumps\n", argc - optind);
+        return EXIT_SUCCESS;
+    }
+
+    /* Archive export */
+    if (exportArchive) {
+        SrixArchive *archive = SrixArchiveOpen(exportArchive);
+        if (!archive) {
+            fprintf(stderr, "Unable to open archive file\n");
+            return EXIT_FAILURE;
+        }
+
+        SrixError error = SrixArchiveExport(archive, optind < argc ? argv[optind] : ".");
+        printf("Exported %zu dumps\n", SrixArchiveCount(archive));
+        SrixArchiveClose(archive);
+
+        if (SRIX_IS_ERROR(error)) {
+            fprintf(stderr, "Unable to export dumps: %s\n", error.message);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    /* Checked dumps aren't processed */
+    if (verifyDumps && (!batchMode || printInformation || resetOTP || editsCount || writeFile)) {
+        fprintf(stderr, "Dumps can only be checked with -b, without other operations\n");
+        return EXIT_FAILURE;
+    }
+
+    if (printInformation) {
+        printOutputHeader();
+    }
+
+    /* Batch processing of dump files */
+    if (batchMode) {
+        SrixBatchOptions options = {
+                .resetOTP = resetOTP,
+                .print = printInformation,
+                .format = outputFormat,
+                .edits = edits,
+                .editsCount = editsCount,
+                .outputDirectory = writeFile,
+                .rawDumps = rawDumps,
+                .verify = verifyDumps,
+                .threads = batchThreads
+        };
+
+        SrixBatchReport report = SrixBatchRun(argv + optind, argc - optind, &options);
+        fprintf(stderr, "%zu files (%zu failed) with %zu threads in %.2f s, %.2f files/s\n", report.files,
+                report.failed, report.threads, report.seconds,
+                report.seconds > 0 ? (double) report.files / report.seconds : 0);
+        return report.failed == 0 && !report.incomplete ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    /* Archive records are found with the UID of a single tag */
+    if (restoreArchive && (readFile || multiReader || streamMode || trayMode)) {
+        fprintf(stderr, "Archive dumps can only be loaded instead of -r, on a single tag\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Tags are processed by one of all readers, stream and tray modes */
+    if (multiReader + streamMode + trayMode > 1) {
+        fprintf(stderr, "Options -m, -s and -M can't be used together\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Sessions are recorded and replayed on a single reader */
+    if (multiReader && (recordFile || replayFile)) {
+        fprintf(stderr, "NFC sessions can't be recorded or replayed on all readers\n");
+        return EXIT_FAILURE;
+    }
+
+    if (multiReader && cacheDirectory) {
+        fprintf(stderr, "Dumps can't be cached on all readers\n");
+        return EXIT_FAILURE;
+    }
+
+    if (multiReader && journalDirectory) {
+        fprintf(stderr, "Writes can't be journaled on all readers\n");
+        return EXIT_FAILURE;
+    }
+
+    if (multiReader && linkBaudRate) {
+        fprintf(stderr, "Link speed can't be negotiated on all readers\n");
+        return EXIT_FAILURE;
+    }
+
+    if (multiReader && allowFile) {
+        fprintf(stderr, "UIDs can't be checked on all readers\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Every reader returns the whole EEPROM of its tags, only printing is available */
+    if (multiReader && (lazyRead || writeFile || archiveFile || dryRun)) {
+        fprintf(stderr, "Tags of all readers can only be printed, not read lazily, saved or planned\n");
+        return EXIT_FAILURE;
+    }
+
+    if (multiReader && (resetOTP || editsCount) && !writeTag) {
+        fprintf(stderr, "Blocks of all readers can only be changed while writing them\n");
+        return EXIT_FAILURE;
+    }
+
+    if (replayFile) {
+        replay = NfcReplayOpen(replayFile, replaySpeed);
+        if (!replay) {
+            fprintf(stderr, "Unable to open NFC session file\n");
+            return EXIT_FAILURE;
+        }
+        atexit(closeReplay);
+    }
+
+    context = SrixContextNew();
+    if (!context) {
+        fprintf(stderr, "Unable to allocate memory for library context\n");
+        return EXIT_FAILURE;
+    }
+    atexit(deleteContext);
+
+    Srix *srix = SrixNew(context);
     if (srix == (void *) 0) {
         fprintf(stderr, "Unable to allocate memory for SRIX\n");
         return EXIT_FAILURE;
     }
 
-    /* Initialize NFC if read tag or write tag is enabled */
-    if (!readFile || writeTag) {
-        if (!readFromNfc(srix)) {
+    if (maxAttempts) {
+        SrixSetRetryPolicy(srix, (uint8_t) maxAttempts, 1000);
+    }
+    SrixSetVerifyMode(srix, verifyMode);
+    SrixSetLazy(srix, lazyRead);
+    SrixSetLinkBaudRate(srix, linkBaudRate);
+
+    /* Trace the single reader modes, the engine traces its readers by itself */
+    if (traceFile && !multiReader) {
+        trace = NfcTraceNew(NFC_TRACE_DEFAULT_EVENTS, 0, "reader");
+        if (!trace) {
+            fprintf(stderr, "Unable to allocate memory for trace\n");
+            SrixDelete(srix);
             return EXIT_FAILURE;
         }
+
+        SrixSetTrace(srix, trace);
+        atexit(saveTrace);
     }
 
-    /* Get data from file */
-    if (readFile) {
-        if (!readFromFile(srix, readFile)) {
+    SrixCache *cache = (void *) 0;
+    if (cacheDirectory) {
+        cache = SrixCacheNew(cacheDirectory, SRIX_CACHE_DEFAULT_ENTRIES);
+        if (!cache) {
+            fprintf(stderr, "Unable to open cache directory\n");
+            SrixDelete(srix);
             return EXIT_FAILURE;
         }
+
+        SrixSetCache(srix, cache, SRIX_CACHE_VERIFY_SAMPLES);
     }
 
-    /* Print information in stdout */
-    if (printInformation) {
-        printf("UID: %lu\n\n", SrixGetUid(srix));
+    if (journalDirectory) {
+        journal = SrixJournalNew(journalDirectory);
+        if (!journal) {
+            fprintf(stderr, "Unable to open journal directory\n");
+            SrixDelete(srix);
+            return EXIT_FAILURE;
+        }
+
+        SrixSetJournal(srix, journal);
+        atexit(closeJournal);
+    }
+
+    if (allowFile) {
+        allowIndex = SrixUidIndexOpen(allowFile);
+        if (!allowIndex) {
+            fprintf(stderr, "Unable to open UID index file\n");
+            SrixDelete(srix);
+            return EXIT_FAILURE;
+        }
+
+        SrixSetUidFilter(srix, checkUid, allowIndex);
+        atexit(closeAllowIndex);
+    }
+
+    /* Load the EEPROM to apply to every tag */
+    uint32_t eeprom[SRIX4K_BLOCKS];
+    if ((multiReader || streamMode || trayMode) && readFile) {
+        if (!readFromFile(srix, readFile)) {
+            SrixDelete(srix);
+            return EXIT_FAILURE;
+        }
 
-        printf("EEPROM:\n");
         for (int i = 0; i < SRIX4K_BLOCKS; i++) {
-            printf("[%02X] -> %08X", i, *SrixGetBlock(srix, i));
+            eeprom[i] = *SrixGetBlock(srix, i);
         }
     }
 
-    /* Reset OTP blocks */
-    if (resetOTP) {
-        /* If at least one OTP block is different than
-         * 0xFFFFFFFF, reset OTP.
-         * OTP Blocks: 0x00, 0x01, 0x02, 0x03, 0x04
-         */
-        bool toReset = false;
-        for (int i = 0x00; i <= 0x04; i++) {
-            if (*SrixGetBlock(srix, i) != 0xFFFFFFFF) {
-                toReset = true;
-            }
+    /* Process tags on all readers */
+    if (multiReader) {
+        if (writeTag && !readFile && !resetOTP && !editsCount) {
+            fprintf(stderr, "Writing tags on all readers requires an input file or block changes\n");
+            SrixDelete(srix);
+            return EXIT_FAILURE;
         }
 
-        if (toReset) {
-            /* Decrease block 6 */
-            uint32_t block6old = *SrixGetBlock(srix, 0x06);
-            uint32_t block6 =
-                    (block6old << 24) | ((block6old & 0x0C) << 8) | ((block6old & 0x30) >> 8) | (block6old >> 24);
+        SrixEngineSettings settings = {
+                .maxAttempts = (uint8_t) maxAttempts,
+                .verifyMode = verifyMode,
+                .timeoutMillis = timeoutMillis,
+                .resetOTP = resetOTP,
+                .edits = edits,
+                .editsCount = editsCount
+        };
 
-            uint32_t toDecrease = 0x00200000;
-            if (block6 < toDecrease) {
-                fprintf(stderr, "Unable to decrease block6 counter");
-                return EXIT_FAILURE;
-            } else {
-                /* If result will be higher than 0, subtract. */
-                block6 -= toDecrease;
-            }
+        SrixDelete(srix);
+        return readFromReaders(readFile ? eeprom : (void *) 0, writeTag, &settings, printInformation, tagCount)
+               ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    /* Process a stream of tags, or all tags in the field, on the same reader */
+    if (streamMode || trayMode) {
+        const char *error = openReader(srix);
+        if (error) {
+            fprintf(stderr, "Unable to open NFC reader: %s\n", error);
+            SrixDelete(srix);
+            return EXIT_FAILURE;
+        }
+
+        TagOutputs outputs = {
+                .print = printInformation,
+                .dumpDirectory = writeFile,
+                .archiveFile = archiveFile
+        };
+        pthread_mutex_init(&outputs.archiveLock, (void *) 0);
+
+        const uint32_t *tagEeprom = readFile ? eeprom : (void *) 0;
+        bool result = trayMode ? trayFromNfc(srix, tagEeprom, resetOTP, writeTag, &outputs, outputWorkers)
+                               : streamFromNfc(srix, tagEeprom, resetOTP, writeTag, &outputs, outputWorkers,
+                                               tagCount);
+        pthread_mutex_destroy(&outputs.archiveLock);
+        SrixDelete(srix);
+        if (cache) {
+            SrixCacheDelete(cache);
+        }
+        return result ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    /* Initialize NFC if read tag or write tag is enabled */
+    if (!readFile || writeTag) {
+        if (!readFromNfc(srix, timeoutMillis)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Complete an interrupted write before applying new changes */
+    bool resumed = writeTag && SrixResumeWrite(srix);
+    if (resumed) {
+        fprintf(statusStream(), "Resuming interrupted write, run again to apply new changes\n");
+    }
+
+    /* Get data from file */
+    if (readFile && !resumed) {
+        if (!readFromFile(srix, readFile)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Get data from archive */
+    if (restoreArchive && !resumed) {
+        if (!readFromArchive(srix, restoreArchive)) {
+            return EXIT_FAILURE;
+        }
+    }
 
-            block6 = (block6 << 24) | ((block6 & 0x0C) << 8) | ((block6 & 0x30) >> 8) | (block6 >> 24);
+    /* Print information in stdout */
+    if (printInformation) {
+        printSrix(srix);
+    }
 
-            SrixModifyBlock(srix, block6, 0x06);
-            SrixModifyBlock(srix, 0xFFFFFFFF, 0x00);
-            SrixModifyBlock(srix, 0xFFFFFFFF, 0x01);
-            SrixModifyBlock(srix, 0xFFFFFFFF, 0x02);
-            SrixModifyBlock(srix, 0xFFFFFFFF, 0x03);
-            SrixModifyBlock(srix, 0xFFFFFFFF, 0x04);
+    /* Reset OTP blocks */
+    if (resetOTP && !resumed) {
+        if (!resetOtpBlocks(srix)) {
+            return EXIT_FAILURE;
         }
     }
 
+    /* Modify blocks */
+    for (size_t i = 0; i < editsCount && !resumed; i++) {
+        SrixModifyBlock(srix, edits[i].value, edits[i].block);
+    }
+
     /* Write result to file */
     if (writeFile) {
         if (!writeToFile(srix, writeFile)) {
@@ -271,15 +1488,39 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    /* Write result to tag */
-    if (writeTag) {
+    /* Append result to archive */
+    if (archiveFile) {
+        if (!appendToArchive(srix, archiveFile)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Print write plan instead of writing */
+    if (dryRun) {
+        printWritePlan(srix);
+    } else if (writeTag) {
+        uint32_t roundTrips = SrixGetRoundTrips(srix);
+        uint8_t dirtyBlocks = SrixGetDirtyBlocks(srix);
         if (SrixWriteBlocks(srix) != SRIX_SUCCESS) {
-            fprintf(stderr, "Unable to write blocks to SRIX4K");
+            SrixError error = SrixGetLatestError(srix);
+            fprintf(stderr, "Unable to write blocks to SRIX4K: %s (%" PRIu8 " attempts)\n", error.message,
+                    error.attempts);
+            if (error.errorType == SRIX_TIMEOUT) {
+                printProgress(srix);
+            }
+            SrixDelete(srix);
+            return EXIT_FAILURE;
         }
+
+        fprintf(statusStream(), "Tag written (%" PRIu8 " changed blocks) in %" PRIu32 " round trips\n",
+                dirtyBlocks, SrixGetRoundTrips(srix) - roundTrips);
     }
 
     /* Delete srix at the end */
     SrixDelete(srix);
+    if (cache) {
+        SrixCacheDelete(cache);
+    }
 
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "dump.h"
+#include "output.h"
+
+static const char outputUpperDigits[] = "0123456789ABCDEF";
+static const char outputLowerDigits[] = "0123456789abcdef";
+
+/**
+ * Write a value as fixed-width hexadecimal digits.
+ * @param cursor where write the digits
+ * @param value value to write
+ * @param digits number of digits
+ * @param alphabet hexadecimal digits, upper or lower case
+ * @return position after the digits
+ */
+static inline char *outputHex(char *cursor, uint64_t value, int digits, const char *alphabet) {
+    for (int i = digits - 1; i >= 0; i--) {
+        cursor[i] = alphabet[value & 0xFU];
+        value >>= 4U;
+    }
+    return cursor + digits;
+}
+
+/**
+ * Copy a string literal.
+ * @param cursor where copy the string
+ * @param text string to copy
+ * @param length length of string
+ * @return position after the string
+ */
+static inline char *outputCopy(char *cursor, const char *text, size_t length) {
+    memcpy(cursor, text, length);
+    return cursor + length;
+}
+
+#define OUTPUT_COPY(cursor, literal)  outputCopy((cursor), (literal), sizeof(literal) - 1)
+
+/**
+ * Format a record as text.
+ */
+static char *outputText(char *cursor, uint64_t uid, const uint32_t *eeprom) {
+    cursor = OUTPUT_COPY(cursor, "UID ");
+    cursor = outputHex(cursor, uid, 16, outputUpperDigits);
+    *cursor++ = '\n';
+
+    for (int i = 0; i < SRIX4K_BLOCKS; i++) {
+        *cursor++ = '[';
+        cursor = outputHex(cursor, i, 2, outputUpperDigits);
+        cursor = OUTPUT_COPY(cursor, "] -> ");
+        cursor = outputHex(cursor, eeprom[i], 8, outputUpperDigits);
+        *cursor++ = '\n';
+    }
+    return cursor;
+}
+
+/**
+ * Format a record as a JSON object.
+ */
+static char *outputJson(char *cursor, uint64_t uid, const uint32_t *eeprom) {
+    cursor = OUTPUT_COPY(cursor, "{\"uid\":\"");
+    cursor = outputHex(cursor, uid, 16, outputUpperDigits);
+    cursor = OUTPUT_COPY(cursor, "\",\"eeprom\":[");
+
+    for (int i = 0; i < SRIX4K_BLOCKS; i++) {
+        *cursor++ = '"';
+        cursor = outputHex(cursor, eeprom[i], 8, outputUpperDigits);
+        *cursor++ = '"';
+        *cursor++ = i + 1 < SRIX4K_BLOCKS ? ',' : ']';
+    }
+
+    cursor = OUTPUT_COPY(cursor, "}\n");
+    return cursor;
+}
+
+/**
+ * Format a record as a CSV line.
+ */
+static char *outputCsv(char *cursor, uint64_t uid, const uint32_t *eeprom) {
+    cursor = outputHex(cursor, uid, 16, outputUpperDigits);
+
+    for (int i = 0; i < SRIX4K_BLOCKS; i++) {
+        *cursor++ = ',';
+        cursor = outputHex(cursor, eeprom[i], 8, outputUpperDigits);
+    }
+
+    *cursor++ = '\n';
+    return cursor;
+}
+
+/**
+ * Format a record as canonical hex dump of the raw dump layout.
+ */
+static char *outputHexDump(char *cursor, uint64_t uid, const uint32_t *eeprom) {
+    uint8_t dump[SRIX_DUMP_LENGTH];
+    SrixDumpEncode(eeprom, uid, dump);
+
+    for (size_t offset = 0; offset < SRIX_DUMP_LENGTH; offset += 16) {
+        size_t count = SRIX_DUMP_LENGTH - offset < 16 ? SRIX_DUMP_LENGTH - offset : 16;
+
+        cursor = outputHex(cursor, offset, 8, outputLowerDigits);
+        *cursor++ = ' ';
+
+        /* Byte columns, in two groups of 8, missing bytes of the last line are blank */
+        for (size_t i = 0; i < 16; i++) {
+            if (i % 8 == 0) {
+                *cursor++ = ' ';
+            }
+
+            if (i < count) {
+                cursor = outputHex(cursor, dump[offset + i], 2, outputLowerDigits);
+                *cursor++ = ' ';
+            } else {
+                cursor = OUTPUT_COPY(cursor, "   ");
+            }
+        }
+
+        *cursor++ = ' ';
+        *cursor++ = '|';
+        for (size_t i = 0; i < count; i++) {
+            uint8_t byte = dump[offset + i];
+            *cursor++ = byte >= 0x20 && byte < 0x7F ? (char) byte : '.';
+        }
+        *cursor++ = '|';
+        *cursor++ = '\n';
+    }
+
+    /* Total length */
+    cursor = outputHex(cursor, SRIX_DUMP_LENGTH, 8, outputLowerDigits);
+    *cursor++ = '\n';
+    return cursor;
+}
+
+bool SrixOutputParseFormat(const char *name, SrixOutputFormat format[static 1]) {
+    static const char *const names[] = {
+            [SRIX_OUTPUT_TEXT] = "text",
+            [SRIX_OUTPUT_JSONL] = "jsonl",
+            [SRIX_OUTPUT_CSV] = "csv",
+            [SRIX_OUTPUT_HEX] = "hex"
+    };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *format = (SrixOutputFormat) i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+size_t SrixOutputEncodeHeader(SrixOutputFormat format, char buffer[static SRIX_OUTPUT_MAX_LENGTH]) {
+    if (format != SRIX_OUTPUT_CSV) {
+        return 0;
+    }
+
+    char *cursor = OUTPUT_COPY(buffer, "uid");
+    for (int i = 0; i < SRIX4K_BLOCKS; i++) {
+        cursor = OUTPUT_COPY(cursor, ",block");
+        cursor = outputHex(cursor, i, 2, outputUpperDigits);
+    }
+
+    *cursor++ = '\n';
+    return cursor - buffer;
+}
+
+size_t SrixOutputEncode(SrixOutputFormat format, uint64_t uid, const uint32_t eeprom[const static SRIX4K_BLOCKS],
+                        char buffer[static SRIX_OUTPUT_MAX_LENGTH]) {
+    char *end;
+
+    switch (format) {
+        case SRIX_OUTPUT_JSONL:
+            end = outputJson(buffer, uid, eeprom);
+            break;
+        case SRIX_OUTPUT_CSV:
+            end = outputCsv(buffer, uid, eeprom);
+            break;
+        case SRIX_OUTPUT_HEX:
+            end = outputHexDump(buffer, uid, eeprom);
+            break;
+        default:
+            end = outputText(buffer, uid, eeprom);
+            break;
+    }
+
+    return end - buffer;
+}
+
+SrixError SrixOutputWriteAll(int fd, const char *buffer, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, buffer, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written <= 0) {
+            return SRIX_ERROR(SRIX_ERROR, "unable to write output");
+        }
+
+        buffer += written;
+        length -= written;
+    }
+
+    return SRIX_NO_ERROR;
+}
+
+SrixError SrixOutputWrite(int fd, SrixOutputFormat format, uint64_t uid,
+                          const uint32_t eeprom[const static SRIX4K_BLOCKS]) {
+    char buffer[SRIX_OUTPUT_MAX_LENGTH];
+    size_t length = SrixOutputEncode(format, uid, eeprom, buffer);
+    return SrixOutputWriteAll(fd, buffer, length);
+}
@@ -0,0 +1,72 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "error.h"
+
+/**
+ * Maximum length of a tag record in any output format.
+ */
+#define SRIX_OUTPUT_MAX_LENGTH  4096
+
+/**
+ * Format of tag records.
+ */
+typedef enum {
+    SRIX_OUTPUT_TEXT,    /* UID line followed by a "[block] -> value" line for every block */
+    SRIX_OUTPUT_JSONL,   /* a JSON object on a single line: {"uid":"...","eeprom":["...",...]} */
+    SRIX_OUTPUT_CSV,     /* UID and the 128 blocks on a single line, after a header line */
+    SRIX_OUTPUT_HEX      /* canonical hex dump (hexdump -C -v) of the raw dump layout */
+} SrixOutputFormat;
+
+/**
+ * Parse an output format name.
+ * @param name name of output format: text, jsonl, csv or hex
+ * @param format pointer where save parsed format
+ * @return boolean result
+ */
+bool SrixOutputParseFormat(const char *name, SrixOutputFormat *format);
+
+/**
+ * Format the header that precedes all records, CSV column names.
+ * @param format output format
+ * @param buffer buffer of SRIX_OUTPUT_MAX_LENGTH bytes where save the header
+ * @return header length, 0 if the format doesn't have a header
+ */
+size_t SrixOutputEncodeHeader(SrixOutputFormat format, char buffer[static SRIX_OUTPUT_MAX_LENGTH]);
+
+/**
+ * Format UID and EEPROM of a tag as a single record, ending with a newline.
+ * @param format output format
+ * @param uid UID of tag
+ * @param eeprom EEPROM of tag
+ * @param buffer buffer of SRIX_OUTPUT_MAX_LENGTH bytes where save the record
+ * @return record length
+ */
+size_t SrixOutputEncode(SrixOutputFormat format, uint64_t uid, const uint32_t eeprom[const static SRIX4K_BLOCKS],
+                        char buffer[static SRIX_OUTPUT_MAX_LENGTH]);
+
+/**
+ * Write a whole buffer on a file descriptor.
+ * @param fd file descriptor
+ * @param buffer bytes to write
+ * @param length number of bytes
+ * @return SrixError result
+ */
+SrixError SrixOutputWriteAll(int fd, const char *buffer, size_t length);
+
+/**
+ * Format a tag record and write it on a file descriptor with a single write.
+ * Records written by different threads on a pipe aren't mixed.
+ * @param fd file descriptor
+ * @param format output format
+ * @param uid UID of tag
+ * @param eeprom EEPROM of tag
+ * @return SrixError result
+ */
+SrixError SrixOutputWrite(int fd, SrixOutputFormat format, uint64_t uid,
+                          const uint32_t eeprom[const static SRIX4K_BLOCKS]);
+
+#endif /* OUTPUT_H */
@@ -0,0 +1,266 @@
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "pipeline.h"
+
+#define PIPELINE_MAX_WORKERS  64
+#define PIPELINE_CACHE_LINE   64
+
+/**
+ * Slot of the ring. Its sequence tells who can use it: the producer when it's equal to the push position,
+ * a worker when it's equal to the pop position + 1.
+ */
+typedef struct PipelineCell {
+    atomic_size_t sequence;                         /* turn of the slot */
+    SrixSnapshot snapshot;                          /* snapshot stored in the slot */
+} PipelineCell;
+
+/**
+ * Stage with its user data.
+ */
+typedef struct PipelineStage {
+    SrixPipelineStage function;                     /* stage function */
+    void *data;                                     /* user data */
+} PipelineStage;
+
+/**
+ * Radio stage and worker pool connected by a bounded ring.
+ */
+struct SrixPipeline {
+    PipelineCell *cells;                            /* ring slots */
+    size_t mask;                                    /* capacity - 1 */
+    PipelineStage stages[PIPELINE_MAX_STAGES];      /* processing stages, in order */
+    size_t stagesCount;                             /* number of stages */
+    pthread_t workers[PIPELINE_MAX_WORKERS];        /* worker threads */
+    size_t workersCount;                            /* number of workers to start */
+    bool started;                                   /* true while workers are running */
+    atomic_bool closing;                            /* true when workers have to stop after the last snapshot */
+    sem_t filled;                                   /* snapshots in the ring, plus a wake up for every worker at close */
+    sem_t vacant;                                   /* free slots */
+    uint64_t pushed;                                /* snapshots pushed, written only by the producer */
+    uint64_t stalls;                                /* pushes that waited a free slot */
+    atomic_uint_fast64_t completed;                 /* snapshots that passed all stages */
+    atomic_uint_fast64_t rejected;                  /* snapshots rejected by a stage */
+
+    /* Positions are written by different threads, so they don't share a cache line */
+    _Alignas(PIPELINE_CACHE_LINE) atomic_size_t pushPosition;
+    _Alignas(PIPELINE_CACHE_LINE) atomic_size_t popPosition;
+};
+
+/**
+ * Take the oldest snapshot of the ring.
+ * @param pipeline pointer to SrixPipeline
+ * @param snapshot pointer where save the snapshot
+ * @return false if the ring is empty
+ */
+static bool pipelinePop(SrixPipeline *pipeline, SrixSnapshot *snapshot) {
+    size_t position = atomic_load_explicit(&pipeline->popPosition, memory_order_relaxed);
+    PipelineCell *cell;
+
+    for (;;) {
+        cell = &pipeline->cells[position & pipeline->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) (position + 1);
+
+        if (difference == 0) {
+            /* Slot is ready, claim it against the other workers */
+            if (atomic_compare_exchange_weak_explicit(&pipeline->popPosition, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = atomic_load_explicit(&pipeline->popPosition, memory_order_relaxed);
+        }
+    }
+
+    *snapshot = cell->snapshot;
+
+    /* Give the slot back to the producer for its next lap */
+    atomic_store_explicit(&cell->sequence, position + pipeline->mask + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * Worker thread: run the stages on snapshots until the pipeline is closed and empty.
+ * @param argument pointer to SrixPipeline
+ * @return null
+ */
+static void *pipelineWorker(void *argument) {
+    SrixPipeline *pipeline = argument;
+    SrixSnapshot snapshot;
+
+    for (;;) {
+        while (sem_wait(&pipeline->filled) != 0) {
+            /* Interrupted by a signal */
+        }
+
+        /* A token is posted after its snapshot is published, retry only if another push is half done */
+        while (!pipelinePop(pipeline, &snapshot)) {
+            if (atomic_load(&pipeline->closing)) {
+                return (void *) 0;
+            }
+            sched_yield();
+        }
+        sem_post(&pipeline->vacant);
+
+        bool accepted = true;
+        for (size_t i = 0; i < pipeline->stagesCount && accepted; i++) {
+            accepted = pipeline->stages[i].function(&snapshot, pipeline->stages[i].data);
+        }
+
+        atomic_fetch_add_explicit(accepted ? &pipeline->completed : &pipeline->rejected, 1, memory_order_relaxed);
+    }
+}
+
+SrixPipeline *SrixPipelineNew(size_t capacity, size_t workers) {
+    if (workers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (size_t) cpus : 1;
+    }
+    if (workers > PIPELINE_MAX_WORKERS) {
+        workers = PIPELINE_MAX_WORKERS;
+    }
+
+    size_t slots = 2;
+    while (slots < capacity) {
+        slots <<= 1U;
+    }
+
+    /* Aligned size is a multiple of the alignment, as required by aligned_alloc */
+    size_t size = (sizeof(SrixPipeline) + PIPELINE_CACHE_LINE - 1) / PIPELINE_CACHE_LINE * PIPELINE_CACHE_LINE;
+    SrixPipeline *created = aligned_alloc(PIPELINE_CACHE_LINE, size);
+    if (!created) {
+        return (void *) 0;
+    }
+
+    created->cells = malloc(slots * sizeof(PipelineCell));
+    if (!created->cells) {
+        free(created);
+        return (void *) 0;
+    }
+
+    for (size_t i = 0; i < slots; i++) {
+        atomic_init(&created->cells[i].sequence, i);
+    }
+
+    created->mask = slots - 1;
+    created->stagesCount = 0;
+    created->workersCount = workers;
+    created->started = false;
+    atomic_init(&created->closing, false);
+    sem_init(&created->filled, 0, 0);
+    sem_init(&created->vacant, 0, (unsigned int) slots);
+    created->pushed = 0;
+    created->stalls = 0;
+    atomic_init(&created->completed, 0);
+    atomic_init(&created->rejected, 0);
+    atomic_init(&created->pushPosition, 0);
+    atomic_init(&created->popPosition, 0);
+
+    return created;
+}
+
+bool SrixPipelineAddStage(SrixPipeline pipeline[static 1], SrixPipelineStage stage, void *data) {
+    if (pipeline->started || pipeline->stagesCount == PIPELINE_MAX_STAGES) {
+        return false;
+    }
+
+    pipeline->stages[pipeline->stagesCount++] = (PipelineStage) {.function = stage, .data = data};
+    return true;
+}
+
+size_t SrixPipelineStart(SrixPipeline pipeline[static 1]) {
+    if (pipeline->started) {
+        return pipeline->workersCount;
+    }
+
+    atomic_store(&pipeline->closing, false);
+    for (size_t i = 0; i < pipeline->workersCount; i++) {
+        if (pthread_create(&pipeline->workers[i], (void *) 0, pipelineWorker, pipeline) != 0) {
+            /* Keep the workers already started */
+            pipeline->workersCount = i;
+            break;
+        }
+    }
+
+    pipeline->started = pipeline->workersCount > 0;
+    return pipeline->workersCount;
+}
+
+SrixError SrixSnapshotTake(Srix *srix, SrixSnapshot snapshot[static 1], bool withBlocks) {
+    if (withBlocks) {
+        if (SrixPrefetchBlocks(srix, 0, SRIX4K_BLOCKS) != SRIX_SUCCESS) {
+            return SrixGetLatestError(srix);
+        }
+
+        for (uint8_t i = 0; i < SRIX4K_BLOCKS; i++) {
+            snapshot->eeprom[i] = *SrixGetBlock(srix, i);
+        }
+    }
+
+    snapshot->uid = SrixGetUid(srix);
+    snapshot->roundTrips = SrixGetRoundTrips(srix);
+
+    return SRIX_NO_ERROR;
+}
+
+void SrixPipelinePush(SrixPipeline pipeline[static 1], const SrixSnapshot snapshot[static 1]) {
+    /* The radio waits only when every slot is still being processed */
+    if (sem_trywait(&pipeline->vacant) != 0) {
+        pipeline->stalls++;
+        while (sem_wait(&pipeline->vacant) != 0) {
+            /* Interrupted by a signal */
+        }
+    }
+
+    /* Single producer: a free slot is always the one at the push position */
+    size_t position = atomic_load_explicit(&pipeline->pushPosition, memory_order_relaxed);
+    PipelineCell *cell = &pipeline->cells[position & pipeline->mask];
+    while (atomic_load_explicit(&cell->sequence, memory_order_acquire) != position) {
+        /* A worker that claimed this slot before a newer one can still be copying it */
+        sched_yield();
+    }
+
+    cell->snapshot = *snapshot;
+    cell->snapshot.sequence = pipeline->pushed++;
+    atomic_store_explicit(&pipeline->pushPosition, position + 1, memory_order_relaxed);
+    atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+
+    sem_post(&pipeline->filled);
+}
+
+SrixPipelineStats SrixPipelineFinish(SrixPipeline pipeline[static 1]) {
+    if (pipeline->started) {
+        /* Every worker takes one of the close tokens after the snapshots left in the ring */
+        atomic_store(&pipeline->closing, true);
+        for (size_t i = 0; i < pipeline->workersCount; i++) {
+            sem_post(&pipeline->filled);
+        }
+
+        for (size_t i = 0; i < pipeline->workersCount; i++) {
+            pthread_join(pipeline->workers[i], (void *) 0);
+        }
+        pipeline->started = false;
+    }
+
+    return (SrixPipelineStats) {
+            .pushed = pipeline->pushed,
+            .completed = atomic_load(&pipeline->completed),
+            .rejected = atomic_load(&pipeline->rejected),
+            .stalls = pipeline->stalls
+    };
+}
+
+void SrixPipelineDelete(SrixPipeline pipeline[static 1]) {
+    SrixPipelineFinish(pipeline);
+    sem_destroy(&pipeline->filled);
+    sem_destroy(&pipeline->vacant);
+    free(pipeline->cells);
+    free(pipeline);
+}
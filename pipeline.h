@@ -0,0 +1,100 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "error.h"
+#include "srix.h"
+
+#define PIPELINE_DEFAULT_CAPACITY  64
+#define PIPELINE_MAX_STAGES        8
+
+/**
+ * Copy of a tag taken by the radio stage, processed by the pipeline workers.
+ */
+typedef struct SrixSnapshot {
+    uint64_t sequence;                /* position of tag in the stream, from 0 */
+    uint64_t uid;                     /* SRIX UID */
+    uint32_t eeprom[SRIX4K_BLOCKS];   /* SRIX4K EEPROM after the radio operations */
+    uint32_t roundTrips;              /* radio round trips used by the tag */
+    double millis;                    /* time spent by the radio on the tag */
+    int chipId;                       /* chip ID selected by the anticollision, -1 if it isn't known */
+} SrixSnapshot;
+
+/**
+ * Processing stage, run by a worker thread on every snapshot.
+ * Stages of the same pipeline are called concurrently on different snapshots.
+ * @param snapshot snapshot to process, it can be modified by the stage for the next stages
+ * @param data user data of the stage
+ * @return false to reject the snapshot, skipping the next stages
+ */
+typedef bool (*SrixPipelineStage)(SrixSnapshot *snapshot, void *data);
+
+/**
+ * Counters of a pipeline.
+ */
+typedef struct SrixPipelineStats {
+    uint64_t pushed;                  /* snapshots added by the radio stage */
+    uint64_t completed;               /* snapshots that passed all stages */
+    uint64_t rejected;                /* snapshots rejected by a stage */
+    uint64_t stalls;                  /* pushes that found the ring full and waited for a worker */
+} SrixPipelineStats;
+
+typedef struct SrixPipeline SrixPipeline;
+
+/**
+ * Create a pipeline that feeds snapshots to a pool of workers through a bounded lock-free ring.
+ * Snapshots are pushed by a single thread, the one that owns the NFC reader.
+ * @param capacity snapshots in the ring, rounded up to a power of two
+ * @param workers worker threads, 0 = one for every online CPU
+ * @return null if there is an error, else a SrixPipeline pointer
+ */
+SrixPipeline *SrixPipelineNew(size_t capacity, size_t workers);
+
+/**
+ * Add a processing stage after the current ones, before the pipeline is started.
+ * @param pipeline pointer to SrixPipeline
+ * @param stage stage function
+ * @param data user data passed to the stage
+ * @return false if the pipeline is started or has already PIPELINE_MAX_STAGES stages
+ */
+bool SrixPipelineAddStage(SrixPipeline *pipeline, SrixPipelineStage stage, void *data);
+
+/**
+ * Start the worker threads.
+ * @param pipeline pointer to SrixPipeline
+ * @return number of started workers, 0 if there is an error
+ */
+size_t SrixPipelineStart(SrixPipeline *pipeline);
+
+/**
+ * Take a snapshot of the tag read by a Srix, reading the blocks still to read.
+ * @param srix pointer to Srix
+ * @param snapshot pointer where save the snapshot, sequence, time and chip ID aren't modified
+ * @param withBlocks false to copy only UID and round trips, without reading blocks
+ * @return SrixError result
+ */
+SrixError SrixSnapshotTake(Srix *srix, SrixSnapshot *snapshot, bool withBlocks);
+
+/**
+ * Add a snapshot to the ring, waiting for a free slot only if all of them are full.
+ * @param pipeline pointer to a started SrixPipeline
+ * @param snapshot snapshot to copy in the ring, its sequence is assigned by the pipeline
+ */
+void SrixPipelinePush(SrixPipeline *pipeline, const SrixSnapshot *snapshot);
+
+/**
+ * Wait for the processing of all pushed snapshots and stop the worker threads.
+ * @param pipeline pointer to SrixPipeline
+ * @return pipeline counters
+ */
+SrixPipelineStats SrixPipelineFinish(SrixPipeline *pipeline);
+
+/**
+ * Stop the pipeline and free its memory.
+ * @param pipeline pointer to SrixPipeline
+ */
+void SrixPipelineDelete(SrixPipeline *pipeline);
+
+#endif /* PIPELINE_H */
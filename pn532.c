@@ -0,0 +1,360 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "pn532.h"
+
+/* PN532 frames */
+#define PN532_HOST_TO_PN532       0xD4
+#define PN532_PN532_TO_HOST       0xD5
+#define PN532_SET_SERIAL_BAUDRATE 0x10
+#define PN532_SAM_CONFIGURATION   0x14
+#define PN532_MAX_FRAME_DATA      64
+
+/* Time to answer a command, and to switch baud rate after the ACK of SetSerialBaudRate */
+#define PN532_ANSWER_MILLIS       100
+#define PN532_SWITCH_MICROS       2000
+
+/**
+ * Baud rate of the serial link, with its termios speed and SetSerialBaudRate code.
+ */
+typedef struct Pn532BaudRate {
+    uint32_t baudRate;                /* bits per second */
+    speed_t speed;                    /* termios speed */
+    uint8_t code;                     /* SetSerialBaudRate BR parameter */
+} Pn532BaudRate;
+
+static const Pn532BaudRate pn532BaudRates[] = {
+        {9600,   B9600,   0x00},
+        {19200,  B19200,  0x01},
+        {38400,  B38400,  0x02},
+        {57600,  B57600,  0x03},
+        {115200, B115200, 0x04},
+#ifdef B230400
+        {230400, B230400, 0x05},
+#endif
+#ifdef B460800
+        {460800, B460800, 0x06},
+#endif
+#ifdef B921600
+        {921600, B921600, 0x07},
+#endif
+};
+
+static const uint8_t pn532Ack[] = {0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00};
+
+/* HSU wake up: 0x55 and a long preamble, so the PN532 leaves power down before the next command */
+static const uint8_t pn532WakeUp[] = {0x55, 0x55, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+/**
+ * Find a supported baud rate.
+ * @param baudRate bits per second
+ * @return null if it isn't supported, else its description
+ */
+static const Pn532BaudRate *pn532FindBaudRate(uint32_t baudRate) {
+    for (size_t i = 0; i < sizeof(pn532BaudRates) / sizeof(pn532BaudRates[0]); i++) {
+        if (pn532BaudRates[i].baudRate == baudRate) {
+            return &pn532BaudRates[i];
+        }
+    }
+
+    return (void *) 0;
+}
+
+/**
+ * Get milliseconds of monotonic time.
+ */
+static int64_t pn532NowMillis() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * Set the speed of the serial port, dropping bytes sent or received at the previous speed.
+ * @param port file descriptor of serial port
+ * @param rate baud rate to use
+ * @return boolean result
+ */
+static bool pn532SetSpeed(int port, const Pn532BaudRate *rate) {
+    struct termios options;
+    if (tcgetattr(port, &options) != 0) {
+        return false;
+    }
+
+    cfsetispeed(&options, rate->speed);
+    cfsetospeed(&options, rate->speed);
+    if (tcsetattr(port, TCSANOW, &options) != 0) {
+        return false;
+    }
+
+    tcflush(port, TCIOFLUSH);
+    return true;
+}
+
+/**
+ * Open a serial port as a raw 8N1 link without flow control.
+ * @param path serial port path
+ * @return file descriptor, negative if there is an error
+ */
+static int pn532Open(const char *path) {
+    int port = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (port < 0) {
+        return -1;
+    }
+
+    struct termios options;
+    if (tcgetattr(port, &options) != 0) {
+        close(port);
+        return -1;
+    }
+
+    cfmakeraw(&options);
+    options.c_cflag |= CLOCAL | CREAD;
+    options.c_cflag &= ~(CSTOPB | PARENB);
+#ifdef CRTSCTS
+    options.c_cflag &= ~CRTSCTS;
+#endif
+    options.c_cc[VMIN] = 0;
+    options.c_cc[VTIME] = 0;
+
+    if (tcsetattr(port, TCSANOW, &options) != 0) {
+        close(port);
+        return -1;
+    }
+
+    return port;
+}
+
+/**
+ * Write all bytes on the serial port.
+ * @param port file descriptor of serial port
+ * @param data bytes to write
+ * @param length number of bytes
+ * @return boolean result
+ */
+static bool pn532Write(int port, const uint8_t *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(port, data, length);
+        if (written < 0) {
+            struct pollfd ready = {.fd = port, .events = POLLOUT};
+            if (poll(&ready, 1, PN532_ANSWER_MILLIS) <= 0) {
+                return false;
+            }
+            continue;
+        }
+
+        data += written;
+        length -= written;
+    }
+
+    return tcdrain(port) == 0;
+}
+
+/**
+ * Read a byte from the serial port.
+ * @param port file descriptor of serial port
+ * @param byte pointer where save the byte
+ * @param deadline pn532NowMillis() time when stop waiting
+ * @return false if deadline expired
+ */
+static bool pn532ReadByte(int port, uint8_t *byte, int64_t deadline) {
+    for (;;) {
+        if (read(port, byte, 1) == 1) {
+            return true;
+        }
+
+        int64_t left = deadline - pn532NowMillis();
+        struct pollfd ready = {.fd = port, .events = POLLIN};
+        if (left <= 0 || poll(&ready, 1, (int) left) <= 0) {
+            return false;
+        }
+    }
+}
+
+/**
+ * Send a normal information frame to the PN532.
+ * @param port file descriptor of serial port
+ * @param data TFI and packet data
+ * @param length number of bytes of data
+ * @return boolean result
+ */
+static bool pn532Send(int port, const uint8_t *data, size_t length) {
+    uint8_t frame[PN532_MAX_FRAME_DATA + 7] = {0x00, 0x00, 0xFF, (uint8_t) length, (uint8_t) -length};
+    uint8_t checksum = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        frame[5 + i] = data[i];
+        checksum += data[i];
+    }
+    frame[5 + length] = (uint8_t) -checksum;
+    frame[6 + length] = 0x00;
+
+    return pn532Write(port, frame, length + 7);
+}
+
+/**
+ * Receive a frame from the PN532, skipping bytes before its start code.
+ * @param port file descriptor of serial port
+ * @param data buffer where save TFI and packet data
+ * @param size size of data buffer
+ * @param deadline pn532NowMillis() time when stop waiting
+ * @return length of data, 0 for an ACK frame, negative on timeout or invalid frame
+ */
+static int pn532Receive(int port, uint8_t *data, size_t size, int64_t deadline) {
+    uint8_t previous = 0xFF;
+    uint8_t byte = 0xFF;
+
+    /* Start code 0x00 0xFF */
+    while (previous != 0x00 || byte != 0xFF) {
+        previous = byte;
+        if (!pn532ReadByte(port, &byte, deadline)) {
+            return -1;
+        }
+    }
+
+    uint8_t length, lengthChecksum;
+    if (!pn532ReadByte(port, &length, deadline) || !pn532ReadByte(port, &lengthChecksum, deadline)) {
+        return -1;
+    }
+
+    /* ACK frame: length 0x00 and 0xFF */
+    if (length == 0x00 && lengthChecksum == 0xFF) {
+        return pn532ReadByte(port, &byte, deadline) ? 0 : -1;
+    }
+
+    if ((uint8_t) (length + lengthChecksum) != 0 || length > size) {
+        return -1;
+    }
+
+    uint8_t checksum = 0;
+    for (uint8_t i = 0; i < length; i++) {
+        if (!pn532ReadByte(port, &data[i], deadline)) {
+            return -1;
+        }
+        checksum += data[i];
+    }
+
+    if (!pn532ReadByte(port, &byte, deadline) || (uint8_t) (checksum + byte) != 0 ||
+        !pn532ReadByte(port, &byte, deadline)) {
+        return -1;
+    }
+
+    return length;
+}
+
+/**
+ * Send a command to the PN532 and wait for its ACK and its response.
+ * @param port file descriptor of serial port
+ * @param command TFI, command code and parameters
+ * @param length number of bytes of command
+ * @return true if the PN532 answered with the response of the command
+ */
+static bool pn532Command(int port, const uint8_t *command, size_t length) {
+    uint8_t response[PN532_MAX_FRAME_DATA];
+    int64_t deadline = pn532NowMillis() + PN532_ANSWER_MILLIS;
+
+    if (!pn532Send(port, command, length) || pn532Receive(port, response, sizeof(response), deadline) != 0) {
+        return false;
+    }
+
+    int received = pn532Receive(port, response, sizeof(response), deadline);
+    return received >= 2 && response[0] == PN532_PN532_TO_HOST && response[1] == command[1] + 1;
+}
+
+/**
+ * Check if the PN532 answers at a baud rate, waking it up.
+ * @param port file descriptor of serial port
+ * @param rate baud rate to check
+ * @return true if the PN532 answered
+ */
+static bool pn532Probe(int port, const Pn532BaudRate *rate) {
+    /* SAMConfiguration in normal mode is the first command after the wake up */
+    const uint8_t samConfiguration[] = {PN532_HOST_TO_PN532, PN532_SAM_CONFIGURATION, 0x01, 0x00};
+
+    return pn532SetSpeed(port, rate) && pn532Write(port, pn532WakeUp, sizeof(pn532WakeUp)) &&
+           pn532Command(port, samConfiguration, sizeof(samConfiguration));
+}
+
+bool NfcPn532BaudRateSupported(uint32_t baudRate) {
+    return pn532FindBaudRate(baudRate) != (void *) 0;
+}
+
+bool NfcPn532ParseConnstring(const char *connstring, char *port, size_t size, uint32_t baudRate[static 1]) {
+    size_t driverLength = strlen(PN532_UART_DRIVER);
+    if (strncmp(connstring, PN532_UART_DRIVER, driverLength) != 0 || connstring[driverLength] != ':') {
+        return false;
+    }
+
+    const char *path = connstring + driverLength + 1;
+    const char *separator = strchr(path, ':');
+    size_t pathLength = separator ? (size_t) (separator - path) : strlen(path);
+    if (pathLength == 0 || pathLength >= size) {
+        return false;
+    }
+
+    memcpy(port, path, pathLength);
+    port[pathLength] = '\0';
+    *baudRate = separator ? (uint32_t) strtoul(separator + 1, (void *) 0, 10) : PN532_UART_DEFAULT_BAUD_RATE;
+    return true;
+}
+
+SrixError NfcPn532SetBaudRate(const char *port, uint32_t current, uint32_t baudRate) {
+    const Pn532BaudRate *currentRate = pn532FindBaudRate(current);
+    const Pn532BaudRate *newRate = pn532FindBaudRate(baudRate);
+    if (!currentRate || !newRate) {
+        return SRIX_ERROR(NFC_ERROR, "unsupported PN532 baud rate");
+    }
+
+    int serial = pn532Open(port);
+    if (serial < 0) {
+        return SRIX_ERROR(NFC_ERROR, "unable to open PN532 serial port");
+    }
+
+    SrixError error = SRIX_NO_ERROR;
+    if (!pn532Probe(serial, currentRate)) {
+        error = SRIX_ERROR(NFC_ERROR, "PN532 doesn't answer");
+    } else if (baudRate != current) {
+        const uint8_t setBaudRate[] = {PN532_HOST_TO_PN532, PN532_SET_SERIAL_BAUDRATE, newRate->code};
+
+        /* PN532 switches to the new rate when it receives the ACK of its response */
+        if (!pn532Command(serial, setBaudRate, sizeof(setBaudRate)) ||
+            !pn532Write(serial, pn532Ack, sizeof(pn532Ack))) {
+            error = SRIX_ERROR(NFC_ERROR, "PN532 refused the baud rate change");
+        } else {
+            struct timespec switchDelay = {.tv_sec = 0, .tv_nsec = PN532_SWITCH_MICROS * 1000};
+            nanosleep(&switchDelay, (void *) 0);
+
+            if (!pn532Probe(serial, newRate)) {
+                error = SRIX_ERROR(NFC_ERROR, "PN532 doesn't answer at the new baud rate");
+            }
+        }
+    }
+
+    close(serial);
+    return error;
+}
+
+SrixError NfcPn532Negotiate(const char *port, uint32_t current, uint32_t baudRate, uint32_t effective[static 1]) {
+    *effective = current;
+
+    SrixError error = NfcPn532SetBaudRate(port, current, baudRate);
+    /* PN532 could still be at the requested rate, if it hasn't been reset after a previous change */
+    if (SRIX_IS_ERROR(error) && baudRate != current &&
+        !SRIX_IS_ERROR(NfcPn532SetBaudRate(port, baudRate, baudRate))) {
+        error = SRIX_NO_ERROR;
+    }
+
+    if (!SRIX_IS_ERROR(error)) {
+        *effective = baudRate;
+        return SRIX_NO_ERROR;
+    }
+
+    /* Fall back to the rate after reset, if the PN532 still answers there */
+    return SRIX_IS_ERROR(NfcPn532SetBaudRate(port, current, current)) ? error : SRIX_NO_ERROR;
+}
@@ -0,0 +1,51 @@
+#ifndef PN532_H
+#define PN532_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "error.h"
+
+#define PN532_UART_DEFAULT_BAUD_RATE  115200
+#define PN532_UART_MAX_BAUD_RATE      921600
+#define PN532_UART_DRIVER             "pn532_uart"
+
+/**
+ * Check if a baud rate can be used on a PN532 UART link (SetSerialBaudRate rates supported by the host).
+ * @param baudRate baud rate
+ * @return true if it's supported
+ */
+bool NfcPn532BaudRateSupported(uint32_t baudRate);
+
+/**
+ * Get serial port and baud rate of a pn532_uart connstring (pn532_uart:port[:baudRate]).
+ * @param connstring libnfc connstring
+ * @param port buffer where save the serial port
+ * @param size size of port buffer
+ * @param baudRate pointer where save the baud rate, PN532_UART_DEFAULT_BAUD_RATE if it isn't in the connstring
+ * @return false if it isn't a pn532_uart connstring
+ */
+bool NfcPn532ParseConnstring(const char *connstring, char *port, size_t size, uint32_t *baudRate);
+
+/**
+ * Change the baud rate of a PN532 UART link with SetSerialBaudRate, checking that the PN532 answers at the new rate.
+ * Serial port is closed when this function returns, the PN532 keeps the new rate until its reset.
+ * @param port serial port of PN532
+ * @param current baud rate used by the PN532
+ * @param baudRate new baud rate, the same as current to only check the link
+ * @return SrixError result
+ */
+SrixError NfcPn532SetBaudRate(const char *port, uint32_t current, uint32_t baudRate);
+
+/**
+ * Move a PN532 UART link to a higher baud rate, or find the rate where it still answers.
+ * A PN532 left at the requested rate by a previous run is used as it is.
+ * @param port serial port of PN532
+ * @param current baud rate of the PN532 after its reset
+ * @param baudRate requested baud rate
+ * @param effective pointer where save the baud rate of the link, current if the change failed
+ * @return SrixError result, an error only if the PN532 doesn't answer at any of the two rates
+ */
+SrixError NfcPn532Negotiate(const char *port, uint32_t current, uint32_t baudRate, uint32_t *effective);
+
+#endif /* PN532_H */
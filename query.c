@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
+#include "archive.h"
+#include "batch.h"
+#include "corpus.h"
+#include "dump.h"
+
+/**
+ * Block filter of a query.
+ */
+typedef struct QueryMatch {
+    uint8_t block;                    /* block to compare */
+    uint32_t value;                   /* value to search */
+    uint32_t mask;                    /* bits to compare */
+} QueryMatch;
+
+
+/**
+ * Print help message.
+ * @param executable name of executable
+ */
+static void printUsage(const char *executable) {
+    printf("Usage: %s [-h] [-m block=value[/mask]] [-d template] [-H block[:byte]] [-l] input...\n\n", executable);
+    printf("Inputs are raw dump files, directories of dumps, glob patterns or archive files.\n\n");
+    printf("Options:\n");
+    printf("  -h        show this help message\n");
+    printf("  -m b=v/m  select dumps where block b masked by m is v (hexadecimal), can be repeated\n");
+    printf("  -d file   count, for every block, selected dumps that differ from a template dump\n");
+    printf("  -H b:n    histogram of byte n (0 = most significant) of block b in selected dumps\n");
+    printf("  -l        list UIDs of selected dumps\n");
+}
+
+
+/**
+ * Get current time in seconds from a monotonic clock.
+ * @return time in seconds
+ */
+static double monotonicSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+
+/**
+ * Parse a block filter in "block=value[/mask]" format, all hexadecimal.
+ * @param text text to parse
+ * @param match pointer where save parsed filter
+ * @return boolean result
+ */
+static bool parseMatch(const char *text, QueryMatch *match) {
+    char *end;
+    unsigned long block = strtoul(text, &end, 16);
+    if (end == text || *end != '=' || block >= SRIX4K_BLOCKS) {
+        return false;
+    }
+
+    const char *valueText = end + 1;
+    unsigned long long value = strtoull(valueText, &end, 16);
+    if (end == valueText || (*end != '\0' && *end != '/') || value > UINT32_MAX) {
+        return false;
+    }
+
+    unsigned long long mask = UINT32_MAX;
+    if (*end == '/') {
+        const char *maskText = end + 1;
+        mask = strtoull(maskText, &end, 16);
+        if (end == maskText || *end != '\0' || mask > UINT32_MAX) {
+            return false;
+        }
+    }
+
+    match->block = (uint8_t) block;
+    match->value = (uint32_t) value;
+    match->mask = (uint32_t) mask;
+    return true;
+}
+
+
+/**
+ * Load inputs in a corpus.
+ * @param corpus corpus where add dumps
+ * @param inputs inputs to load
+ * @param count number of inputs
+ * @return boolean result
+ */
+static bool loadCorpus(SrixCorpus *corpus, char *const inputs[], size_t count) {
+    SrixBatchFiles files = {0};
+    bool result = SrixBatchExpand(&files, inputs, count);
+    for (size_t i = 0; i < files.count && result; i++) {
+        /* Archives are added record by record, other files are raw dumps */
+        SrixArchive *archive = SrixArchiveOpen(files.paths[i]);
+        if (archive) {
+            for (size_t j = 0; j < SrixArchiveCount(archive) && result; j++) {
+                const SrixArchiveRecord *record = SrixArchiveGet(archive, j);
+                result = SrixCorpusAdd(corpus, record->eeprom, record->uid);
+            }
+            SrixArchiveClose(archive);
+            continue;
+        }
+
+        uint32_t eeprom[SRIX4K_BLOCKS];
+        uint64_t uid;
+        SrixError error = SrixDumpLoad(files.paths[i], eeprom, &uid);
+        if (SRIX_IS_ERROR(error)) {
+            fprintf(stderr, "%s: %s\n", files.paths[i], error.message);
+        } else {
+            result = SrixCorpusAdd(corpus, eeprom, uid);
+        }
+    }
+
+    SrixBatchFree(&files);
+    return result;
+}
+
+
+int main(int argc, char *argv[]) {
+    QueryMatch matches[SRIX4K_BLOCKS];
+    size_t matchesCount = 0;
+    char *templateFile = (void *) 0;
+    int histogramBlock = -1;
+    unsigned long histogramByte = 0;
+    bool listUids = false;
+
+    /* Parse input arguments */
+    int param;
+    char *end;
+    while ((param = getopt(argc, argv, "hm:d:H:l")) != -1) {
+        switch (param) {
+            case 'h':
+                printUsage(argv[0]);
+                return EXIT_SUCCESS;
+            case 'm':
+                if (matchesCount == SRIX4K_BLOCKS || !parseMatch(optarg, &matches[matchesCount])) {
+                    fprintf(stderr, "Invalid block filter: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                matchesCount++;
+                break;
+            case 'd':
+                templateFile = optarg;
+                break;
+            case 'H':
+                histogramBlock = (int) strtoul(optarg, &end, 16);
+                if (*end == ':') {
+                    histogramByte = strtoul(end + 1, &end, 10);
+                }
+                if (end == optarg || *end != '\0' || histogramBlock >= SRIX4K_BLOCKS || histogramByte > 3) {
+                    fprintf(stderr, "Invalid histogram block: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'l':
+                listUids = true;
+                break;
+            default:
+                printUsage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind == argc) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    SrixCorpus *corpus = SrixCorpusNew();
+    if (!corpus) {
+        fprintf(stderr, "Unable to allocate memory for the corpus\n");
+        return EXIT_FAILURE;
+    }
+
+    double start = monotonicSeconds();
+    if (!loadCorpus(corpus, argv + optind, argc - optind)) {
+        fprintf(stderr, "Unable to allocate memory for the corpus\n");
+        SrixCorpusDelete(corpus);
+        return EXIT_FAILURE;
+    }
+    size_t count = SrixCorpusCount(corpus);
+    fprintf(stderr, "%zu dumps loaded in %.2f s\n", count, monotonicSeconds() - start);
+
+    uint64_t *selection = malloc((SRIX_CORPUS_WORDS(count) + 1) * sizeof(uint64_t));
+    if (!selection) {
+        fprintf(stderr, "Unable to allocate memory for the selection\n");
+        SrixCorpusDelete(corpus);
+        return EXIT_FAILURE;
+    }
+
+    /* Select dumps */
+    start = monotonicSeconds();
+    SrixCorpusSelectAll(corpus, selection);
+    size_t selected = count;
+    for (size_t i = 0; i < matchesCount; i++) {
+        selected = SrixCorpusScan(corpus, matches[i].block, matches[i].value, matches[i].mask, selection);
+    }
+    printf("%zu of %zu dumps selected\n", selected, count);
+
+    if (listUids) {
+        for (size_t i = 0; i < count; i++) {
+            if (selection[i / SRIX_CORPUS_GROUP] & UINT64_C(1) << (i % SRIX_CORPUS_GROUP)) {
+                printf("%016" PRIX64 "\n", SrixCorpusUid(corpus, i));
+            }
+        }
+    }
+
+    bool result = true;
+    if (templateFile) {
+        uint32_t template[SRIX4K_BLOCKS];
+        uint64_t uid;
+        SrixError error = SrixDumpLoad(templateFile, template, &uid);
+
+        uint64_t *different = malloc((SRIX_CORPUS_WORDS(count) + 1) * sizeof(uint64_t));
+        if (SRIX_IS_ERROR(error)) {
+            fprintf(stderr, "%s: %s\n", templateFile, error.message);
+            result = false;
+        } else if (!different) {
+            fprintf(stderr, "Unable to allocate memory for the diff\n");
+            result = false;
+        } else {
+            uint64_t counts[SRIX4K_BLOCKS];
+            SrixCorpusDiff(corpus, template, selection, counts, different);
+
+            size_t differentCount = 0;
+            for (size_t i = 0; i < SRIX_CORPUS_WORDS(count); i++) {
+                differentCount += __builtin_popcountll(different[i]);
+            }
+
+            printf("%zu selected dumps differ from %s\n", differentCount, templateFile);
+            for (uint8_t i = 0; i < SRIX4K_BLOCKS; i++) {
+                if (counts[i]) {
+                    printf("[%02X] %08" PRIX32 " differs in %" PRIu64 " dumps\n", i, template[i], counts[i]);
+                }
+            }
+        }
+        free(different);
+    }
+
+    if (histogramBlock >= 0) {
+        uint64_t bins[256];
+        SrixCorpusHistogram(corpus, (uint8_t) histogramBlock, (uint8_t) ((3 - histogramByte) * 8), selection, bins);
+
+        printf("Byte %lu of block %02X:\n", histogramByte, histogramBlock);
+        for (size_t i = 0; i < 256; i++) {
+            if (bins[i]) {
+                printf("  %02zX: %" PRIu64 "\n", i, bins[i]);
+            }
+        }
+    }
+    fprintf(stderr, "Query done in %.3f s\n", monotonicSeconds() - start);
+
+    free(selection);
+    SrixCorpusDelete(corpus);
+    return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,6 +1,15 @@
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include "pn532.h"
 #include "reader.h"
+#include "session.h"
+
+/* Timeout of libnfc commands without a deadline (libnfc default) */
+#define NFC_SELECT_TIMEOUT_MILLIS  350
 
 static const nfc_modulation nfc_ISO14443B = {
         .nmt = NMT_ISO14443B,
@@ -12,23 +21,104 @@ static const nfc_modulation nfc_ISO14443B2SR = {
         .nbr = NBR_106,
 };
 
-static nfc_context *libnfc_context = (void *) 0;
+/**
+ * Send bytes to the tag with a libnfc device.
+ */
+static int libnfcTransceive(void *context, const uint8_t *tx, size_t txSize, uint8_t *rx, size_t rxSize,
+                            int timeoutMillis) {
+    return nfc_initiator_transceive_bytes(context, tx, txSize, rx, rxSize, timeoutMillis);
+}
+
+/**
+ * Select a SRIX4K tag with a libnfc device.
+ */
+static int libnfcSelect(void *context, int timeoutMillis) {
+    /* Selection commands end with the deadline, never after the libnfc default timeout */
+    nfc_device_set_property_int(context, NP_TIMEOUT_COMMAND,
+                                timeoutMillis && timeoutMillis < NFC_SELECT_TIMEOUT_MILLIS ?
+                                timeoutMillis : NFC_SELECT_TIMEOUT_MILLIS);
+
+    /*
+     * (libnfc) To read ISO14443B2SR you have to initiate first ISO14443B to configure PN532 internal registers.
+     * https://github.com/nfc-tools/libnfc/issues/436#issuecomment-326686914
+     */
+    nfc_target tmpTarget[MAX_TARGET_COUNT];
+    nfc_initiator_list_passive_targets(context, nfc_ISO14443B, tmpTarget, MAX_TARGET_COUNT);
+    return nfc_initiator_select_passive_target(context, nfc_ISO14443B2SR, (void *) 0, 0, tmpTarget);
+}
 
 /**
- * Exit from libnfc context at the end of the execution.
+ * Check tag presence with a libnfc device.
  */
-static void exitNfcContext() {
-    nfc_exit(libnfc_context);
+static bool libnfcIsPresent(void *context) {
+    return nfc_initiator_target_is_present(context, (void *) 0) >= 0;
 }
 
 /**
- * Initialize libnfc context for this application.
+ * Get last error of a libnfc device.
  */
-static void nfcContextInit() {
-    if (!libnfc_context) {
-        nfc_init(&libnfc_context);
-        atexit(exitNfcContext);
+static const char *libnfcStrerror(void *context) {
+    return nfc_strerror(context);
+}
+
+/**
+ * Close a libnfc device.
+ */
+static void libnfcClose(void *context) {
+    nfc_close(context);
+}
+
+static const NfcTransport libnfcTransport = {
+        .transceive = libnfcTransceive,
+        .select = libnfcSelect,
+        .isPresent = libnfcIsPresent,
+        .strerror = libnfcStrerror,
+        .close = libnfcClose
+};
+
+/**
+ * Bring a negotiated PN532 UART link back to its rate after reset, so other programs can open the reader.
+ * @param reader pointer to a NFC device, already closed
+ */
+static void nfcLinkRestore(NfcReader *reader) {
+    if (reader->linkEffectiveRate && reader->linkEffectiveRate != reader->linkResetRate) {
+        NfcPn532SetBaudRate(reader->linkPort, reader->linkEffectiveRate, reader->linkResetRate);
     }
+
+    reader->linkEffectiveRate = 0;
+}
+
+/**
+ * Negotiate the requested baud rate of a pn532_uart reader before libnfc opens it.
+ * @param reader pointer to a NFC device
+ * @param target index of reader to open
+ * @param negotiated buffer where save the connstring with the negotiated baud rate
+ * @return connstring to open
+ */
+static const char *nfcLinkConnstring(NfcReader *reader, int target, nfc_connstring negotiated) {
+    const char *connstring = reader->libnfc_readers[target];
+    uint32_t connstringRate;
+
+    reader->linkEffectiveRate = 0;
+    if (!reader->linkBaudRate ||
+        !NfcPn532ParseConnstring(connstring, reader->linkPort, sizeof(reader->linkPort), &connstringRate)) {
+        return connstring;
+    }
+
+    /* libnfc opens the serial port at the connstring rate, so it has to match the PN532 one */
+    uint32_t effective;
+    if (SRIX_IS_ERROR(NfcPn532Negotiate(reader->linkPort, connstringRate, reader->linkBaudRate, &effective))) {
+        return connstring;
+    }
+
+    reader->linkEffectiveRate = effective;
+    reader->linkResetRate = connstringRate;
+    if (snprintf(negotiated, sizeof(nfc_connstring), PN532_UART_DRIVER ":%s:%" PRIu32, reader->linkPort,
+                 effective) >= (int) sizeof(nfc_connstring)) {
+        nfcLinkRestore(reader);
+        return connstring;
+    }
+    return negotiated;
 }
 
 /**
@@ -39,130 +129,491 @@ static void nfcContextInit() {
  */
 static SrixError nfcReaderInit(NfcReader *reader, int target) {
     /* Open target reader */
-    reader->libnfc_reader = nfc_open(libnfc_context, reader->libnfc_readers[target]);
+    if (!reader->libnfc_context) {
+        return SRIX_ERROR(NFC_ERROR, "nfc reader has no libnfc context");
+    }
+
+    nfc_connstring negotiated;
+    reader->libnfc_reader = nfc_open(reader->libnfc_context, nfcLinkConnstring(reader, target, negotiated));
     if (!reader->libnfc_reader) {
+        nfcLinkRestore(reader);
         return SRIX_ERROR(NFC_ERROR, "unable to open requested nfc reader");
     }
 
     /* NFC device is an initiator (a reader) */
     if (nfc_initiator_init(reader->libnfc_reader)) {
+        SrixError error = SRIX_ERROR(NFC_ERROR, nfc_strerror(reader->libnfc_reader));
         nfc_close(reader->libnfc_reader);
-        return SRIX_ERROR(NFC_ERROR, nfc_strerror(reader->libnfc_reader));
+        reader->libnfc_reader = (void *) 0;
+        nfcLinkRestore(reader);
+        return error;
+    }
+
+    /* Selection is bounded, polling for a new tag is done by nfcSrix4kInit */
+    nfc_device_set_property_bool(reader->libnfc_reader, NP_INFINITE_SELECT, false);
+
+    reader->transport = &libnfcTransport;
+    reader->transportContext = reader->libnfc_reader;
+    return SRIX_NO_ERROR;
+}
+
+/**
+ * Check if the operation of a reader has to stop, because it has been cancelled or its deadline expired.
+ * @param reader pointer to a NFC device
+ * @return SRIX_CANCELLED or SRIX_TIMEOUT error if the operation has to stop, else SRIX_NO_ERROR
+ */
+static SrixError nfcInterrupted(const NfcReader *reader) {
+    if (reader->cancel && atomic_load(&reader->cancel->cancelled)) {
+        return SRIX_ERROR(SRIX_CANCELLED, "operation cancelled");
+    } else if (reader->deadline && NfcTraceNow() >= reader->deadline) {
+        return SRIX_ERROR(SRIX_TIMEOUT, "operation deadline expired");
     }
 
-    nfc_device_set_property_bool(reader->libnfc_reader, NP_INFINITE_SELECT, true);
     return SRIX_NO_ERROR;
 }
 
+/**
+ * Get the time left before the deadline of a reader, to bound a single exchange.
+ * @param reader pointer to a NFC device
+ * @return milliseconds left (at least 1), 0 if there is no deadline
+ */
+static int nfcTimeoutMillis(const NfcReader *reader) {
+    if (!reader->deadline) {
+        return 0;
+    }
+
+    uint64_t now = NfcTraceNow();
+    uint64_t left = reader->deadline > now ? (reader->deadline - now) / 1000000 : 0;
+    return left < 1 ? 1 : left > INT_MAX ? INT_MAX : (int) left;
+}
+
+/**
+ * Sleep without going beyond the reader deadline.
+ * @param reader pointer to a NFC device
+ * @param delay microseconds to sleep
+ */
+static void nfcSleep(const NfcReader *reader, uint64_t delay) {
+    if (reader->deadline) {
+        uint64_t now = NfcTraceNow();
+        uint64_t left = reader->deadline > now ? (reader->deadline - now) / 1000 : 0;
+        delay = delay < left ? delay : left;
+    }
+
+    if (delay) {
+        struct timespec sleepTime = {.tv_sec = delay / 1000000, .tv_nsec = delay % 1000000 * 1000};
+        nanosleep(&sleepTime, (void *) 0);
+    }
+}
+
 /**
  * Search for a valid SRIX4K tag to initialize and do polling if it isn't available.
  * @param reader pointer to a NFC device
+ * @param wait true to poll until a tag is found, false to try a single selection
+ * @param attempt attempt of the block operation that needs the selection, 1 = first
  * @return SrixError instance, if there is an error it will include its description
  */
-static SrixError nfcSrix4kInit(NfcReader *reader) {
-    /*
-     * (libnfc) To read ISO14443B2SR you have to initiate first ISO14443B to configure PN532 internal registers.
-     * https://github.com/nfc-tools/libnfc/issues/436#issuecomment-326686914
-     */
-    nfc_target tmpTarget[MAX_TARGET_COUNT];
-    nfc_initiator_list_passive_targets(reader->libnfc_reader, nfc_ISO14443B, tmpTarget, MAX_TARGET_COUNT);
+static SrixError nfcSrix4kInit(NfcReader *reader, bool wait, uint8_t attempt) {
+    int found;
 
-    /* NFC tag polling */
-    if (nfc_initiator_select_passive_target(reader->libnfc_reader, nfc_ISO14443B2SR, (void *) 0, 0, tmpTarget) < 0) {
-        nfc_close(reader->libnfc_reader);
-        return SRIX_ERROR(NFC_ERROR, nfc_strerror(reader->libnfc_reader));
+    /* NFC tag polling, until the operation is interrupted */
+    for (bool polled = false; ; polled = true) {
+        if (polled) {
+            nfcSleep(reader, NFC_POLL_MICROS);
+        }
+
+        SrixError stop = nfcInterrupted(reader);
+        if (SRIX_IS_ERROR(stop)) {
+            return stop;
+        }
+
+        reader->stats.selects++;
+        uint64_t start = reader->trace ? NfcTraceNow() : 0;
+
+        found = reader->transport->select(reader->transportContext, nfcTimeoutMillis(reader));
+
+        if (reader->trace) {
+            NfcTraceAdd(reader->trace, (NfcTraceEvent) {
+                    .kind = NFC_TRACE_SELECT,
+                    .response = (int16_t) found,
+                    .attempt = attempt
+            }, start);
+        }
+
+        if (!wait || found != 0) {
+            break;
+        }
+    }
+
+    if (found < 0) {
+        return SRIX_ERROR(NFC_ERROR, reader->transport->strerror(reader->transportContext));
+    } else if (found == 0) {
+        return SRIX_ERROR(NFC_TAG_MISSING, "SRIX4K tag isn't in the field");
     } else {
+        /* Transport selected a tag by itself */
+        reader->chipId = -1;
         return SRIX_NO_ERROR;
     }
 }
 
+/**
+ * Wait before the next attempt of a failed exchange, using an exponential backoff.
+ * Delay never goes beyond the reader deadline.
+ * @param reader pointer to a NFC device with the retry policy
+ * @param attempt number of attempts already done (1 = first attempt failed)
+ */
+static void nfcBackoff(const NfcReader *reader, uint8_t attempt) {
+    const NfcRetryPolicy *policy = &reader->retry;
+    uint64_t delay = (uint64_t) policy->backoffMicros << (attempt > 16 ? 16 : attempt - 1);
+    if (delay > policy->maxBackoffMicros) {
+        delay = policy->maxBackoffMicros;
+    }
+
+    nfcSleep(reader, delay);
+}
+
+/**
+ * Check if the selected tag is still in the field.
+ * @param reader pointer to a NFC device
+ * @param attempt attempt of the block operation that needs the check, 1 = first
+ * @return true if the tag answers, else false
+ */
+static inline bool nfcTargetIsPresent(NfcReader *reader, uint8_t attempt) {
+    reader->stats.presenceChecks++;
+    if (!reader->trace) {
+        return reader->transport->isPresent(reader->transportContext);
+    }
+
+    uint64_t start = NfcTraceNow();
+    bool present = reader->transport->isPresent(reader->transportContext);
+    NfcTraceAdd(reader->trace, (NfcTraceEvent) {
+            .kind = NFC_TRACE_PRESENCE,
+            .response = present,
+            .attempt = attempt
+    }, start);
+
+    return present;
+}
+
 /**
  * Send bytes to the SRIX tag and save the response.
- * @param target NFC device pointer
+ * @param reader pointer to a NFC device
+ * @param attempt attempt of the block operation, 1 = first
  * @param tx_data array of bytes to send
  * @param tx_size number of bytes to send
  * @param rx_data pointer to an array of bytes where save the response
  * @param rx_size size of rx_data array
- * @return NFC response length in bytes
+ * @return NFC response length in bytes, negative on error
  */
-static inline size_t nfcExchange(nfc_device *target, const uint8_t *restrict tx_data, const size_t tx_size,
-                                 uint8_t *restrict rx_data, const size_t rx_size) {
-    return nfc_initiator_transceive_bytes(target, tx_data, tx_size, rx_data, rx_size, 0);
+static inline int nfcExchange(NfcReader *reader, uint8_t attempt, const uint8_t *restrict tx_data,
+                              const size_t tx_size, uint8_t *restrict rx_data, const size_t rx_size) {
+    reader->stats.exchanges++;
+    if (!reader->trace) {
+        return reader->transport->transceive(reader->transportContext, tx_data, tx_size, rx_data, rx_size,
+                                            nfcTimeoutMillis(reader));
+    }
+
+    uint64_t start = NfcTraceNow();
+    int received = reader->transport->transceive(reader->transportContext, tx_data, tx_size, rx_data, rx_size,
+                                            nfcTimeoutMillis(reader));
+    NfcTraceAdd(reader->trace, (NfcTraceEvent) {
+            .kind = NFC_TRACE_EXCHANGE,
+            .response = (int16_t) received,
+            .command = tx_data[0],
+            .block = tx_size > 1 ? tx_data[1] : 0,
+            .attempt = attempt
+    }, start);
+
+    return received;
 }
 
-NfcReader *NfcReaderNew() {
+NfcReader *NfcReaderNew(nfc_context *context) {
     /* Allocate struct */
     NfcReader *created = malloc(sizeof(NfcReader));
     if (!created) {
         return (void *) 0;
     }
 
-    /* Initialize context and set nfc reader to null (avoid conflicts) */
-    nfcContextInit();
+    /* Set nfc reader to null (avoid conflicts) */
+    created->libnfc_context = context;
     created->libnfc_reader = (void *) 0;
+    created->transport = (void *) 0;
+    created->transportContext = (void *) 0;
+    created->stats = (NfcReaderStats) {0};
+    created->retry = NFC_RETRY_POLICY_DEFAULT;
+    created->trace = (void *) 0;
+    created->deadline = 0;
+    created->cancel = (void *) 0;
+    created->chipId = -1;
+    created->linkBaudRate = 0;
+    created->linkEffectiveRate = 0;
+    created->linkResetRate = 0;
 
     /* Return struct pointer */
     return created;
 }
 
 void NfcCloseReader(NfcReader reader[static 1]) {
-    nfc_close(reader->libnfc_reader);
+    if (reader->transport && reader->transport->close) {
+        reader->transport->close(reader->transportContext);
+    }
+
+    reader->transport = (void *) 0;
+    reader->transportContext = (void *) 0;
+    reader->libnfc_reader = (void *) 0;
+    nfcLinkRestore(reader);
 }
 
 size_t NfcUpdateReaders(NfcReader reader[static 1]) {
     /* Search for readers */
-    return nfc_list_devices(libnfc_context, reader->libnfc_readers, MAX_DEVICE_COUNT);
+    return reader->libnfc_context ? nfc_list_devices(reader->libnfc_context, reader->libnfc_readers, MAX_DEVICE_COUNT)
+                                  : 0;
 }
 
 char *NfcGetReaderDescription(NfcReader reader[static 1], int selection) {
     return reader->libnfc_readers[selection];
 }
 
-SrixError NfcInitReader(NfcReader reader[static 1], int selection) {
-    /* Init Reader */
-    SrixError error = nfcReaderInit(reader, selection);
-    if (SRIX_IS_ERROR(error)) {
-        return error;
+NfcReaderStats NfcGetStats(NfcReader reader[static 1]) {
+    return reader->stats;
+}
+
+void NfcResetStats(NfcReader reader[static 1]) {
+    reader->stats = (NfcReaderStats) {0};
+}
+
+void NfcSetRetryPolicy(NfcReader reader[static 1], NfcRetryPolicy policy) {
+    if (policy.maxAttempts == 0) {
+        policy.maxAttempts = 1;
     }
 
-    /* Init SRIX */
-    error = nfcSrix4kInit(reader);
-    if (SRIX_IS_ERROR(error)) {
-        return error;
+    reader->retry = policy;
+}
+
+void NfcSetTrace(NfcReader reader[static 1], NfcTrace *trace) {
+    reader->trace = trace;
+}
+
+void NfcSetDeadline(NfcReader reader[static 1], uint64_t deadline, NfcCancel *cancel) {
+    reader->deadline = deadline;
+    reader->cancel = cancel;
+}
+
+void NfcSetLinkBaudRate(NfcReader reader[static 1], uint32_t baudRate) {
+    reader->linkBaudRate = baudRate;
+}
+
+uint32_t NfcGetLinkBaudRate(NfcReader reader[static 1]) {
+    return reader->linkEffectiveRate;
+}
+
+SrixError NfcOpenReader(NfcReader reader[static 1], int selection) {
+    return nfcReaderInit(reader, selection);
+}
+
+void NfcOpenTransport(NfcReader reader[static 1], const NfcTransport transport[static 1], void *context) {
+    NfcCloseReader(reader);
+    reader->transport = transport;
+    reader->transportContext = context;
+}
+
+SrixError NfcRecordSession(NfcReader reader[static 1], const char *filename) {
+    if (!reader->transport) {
+        return SRIX_ERROR(NFC_ERROR, "nfc reader hasn't been opened");
+    }
+
+    NfcRecorder *recorder = NfcRecorderNew(filename, reader->transport, reader->transportContext);
+    if (!recorder) {
+        return SRIX_ERROR(SRIX_ERROR, "unable to create nfc session file");
     }
 
+    /* Recorder closes the recorded transport */
+    reader->transport = &NFC_RECORDER_TRANSPORT;
+    reader->transportContext = recorder;
     return SRIX_NO_ERROR;
 }
 
-/* NFC commands */
-#define SRIX_GET_UID      0x0B
-#define SRIX_READ_BLOCK   0x08
-#define SRIX_WRITE_BLOCK  0x09
+SrixError NfcSelectTag(NfcReader reader[static 1], bool wait) {
+    if (!reader->transport) {
+        return SRIX_ERROR(NFC_ERROR, "nfc reader hasn't been opened");
+    }
 
-SrixError NfcGetUid(NfcReader reader[static 1], uint8_t uid[const static SRIX_UID_LENGTH]) {
-    /* Send command (length = 1) and check length */
-    if (nfcExchange(reader->libnfc_reader, (const uint8_t[]) {SRIX_GET_UID}, 1, uid, SRIX_UID_LENGTH) !=
-        SRIX_UID_LENGTH) {
-        return SRIX_ERROR(NFC_ERROR, "invalid UID length");
+    return nfcSrix4kInit(reader, wait, 1);
+}
+
+bool NfcTagIsPresent(NfcReader reader[static 1]) {
+    return reader->transport && nfcTargetIsPresent(reader, 1);
+}
+
+/**
+ * Select a tag by its Chip_ID.
+ * @param reader pointer to a NFC device
+ * @param attempt attempt of the operation that needs the selection, 1 = first
+ * @param chipId Chip_ID of tag to select
+ * @return true if the tag answered with its Chip_ID
+ */
+static bool nfcSelectChipId(NfcReader *reader, uint8_t attempt, uint8_t chipId) {
+    uint8_t answer;
+    return nfcExchange(reader, attempt, (const uint8_t[]) {SRIX_SELECT, chipId}, 2, &answer, 1) == 1 &&
+           answer == chipId;
+}
+
+/**
+ * Select again the current tag after a failed exchange, if it isn't answering anymore.
+ * @param reader pointer to a NFC device
+ * @param attempt attempt of the block operation, 1 = first
+ * @return SrixError result
+ */
+static SrixError nfcReselect(NfcReader *reader, uint8_t attempt) {
+    if (reader->chipId >= 0) {
+        /* Transport selection could pick another tag of the field */
+        return nfcSelectChipId(reader, attempt, (uint8_t) reader->chipId) ?
+               SRIX_NO_ERROR : SRIX_ERROR(NFC_TAG_MISSING, "SRIX4K tag isn't in the field");
     }
 
-    return SRIX_NO_ERROR;
+    return nfcTargetIsPresent(reader, attempt) ? SRIX_NO_ERROR : nfcSrix4kInit(reader, false, attempt);
 }
 
+/**
+ * Send a command that makes the tags of a slot answer with their Chip_ID, and select the answering tag.
+ * @param reader pointer to a NFC device
+ * @param inventory pointer to inventory where add the found tag
+ * @param command anticollision command (PCALL16 or SLOT_MARKER)
+ * @param commandSize size of command
+ * @return false if there has been a collision, so another round is needed
+ */
+static bool nfcInventorySlot(NfcReader *reader, NfcInventory *inventory, const uint8_t *command,
+                             size_t commandSize) {
+    uint8_t chipId;
+    int received = nfcExchange(reader, 1, command, commandSize, &chipId, 1);
+    if (received == 0 || received == NFC_ETIMEOUT) {
+        /* Empty slot */
+        return true;
+    } else if (received != 1 || inventory->count == NFC_INVENTORY_SIZE) {
+        return false;
+    }
 
-SrixError NfcReadBlock(NfcReader reader[static 1], SrixBlock block[static 1], const uint8_t blockNum) {
-    /* Read while read block length is different than expected */
-    do {
-        if (nfc_initiator_target_is_present(reader->libnfc_reader, (void *) 0) < 0) {
-            SrixError error = nfcSrix4kInit(reader);
+    /* A Chip_ID already found would select two tags, the new tag gets another one in the next round */
+    for (uint8_t i = 0; i < inventory->count; i++) {
+        if (inventory->chipIds[i] == chipId) {
+            return false;
+        }
+    }
+
+    /* Selected tag leaves the anticollision, and it's deselected by the next selection */
+    if (!nfcSelectChipId(reader, 1, chipId)) {
+        return false;
+    }
+
+    inventory->chipIds[inventory->count++] = chipId;
+    return true;
+}
+
+SrixError NfcInventoryTags(NfcReader reader[static 1], NfcInventory inventory[static 1]) {
+    *inventory = (NfcInventory) {.count = 0, .complete = false};
+    if (!reader->transport) {
+        return SRIX_ERROR(NFC_ERROR, "nfc reader hasn't been opened");
+    }
+
+    /* Transport selection prepares the device, then the tag it selected goes back to the inventory */
+    SrixError error = nfcSrix4kInit(reader, false, 1);
+    if (error.errorType == SRIX_CANCELLED || error.errorType == SRIX_TIMEOUT) {
+        return error;
+    }
+    reader->chipId = -1;
+    nfcExchange(reader, 1, (const uint8_t[]) {SRIX_RESET_TO_INVENTORY}, 1, (void *) 0, 0);
+
+    uint8_t chipId;
+    nfcExchange(reader, 1, (const uint8_t[]) {SRIX_INITIATE, 0x00}, 2, &chipId, 1);
+
+    for (uint8_t round = 0; round < NFC_INVENTORY_ROUNDS && !inventory->complete; round++) {
+        /* Every tag still in inventory chooses a random slot */
+        inventory->complete = nfcInventorySlot(reader, inventory, (const uint8_t[]) {SRIX_PCALL16, 0x04}, 2);
+
+        for (uint8_t slot = 1; slot < 16; slot++) {
+            error = nfcInterrupted(reader);
             if (SRIX_IS_ERROR(error)) {
                 return error;
             }
+
+            inventory->complete &= nfcInventorySlot(reader, inventory, (const uint8_t[]) {SRIX_SLOT_MARKER(slot)}, 1);
         }
-    } while (nfcExchange(reader->libnfc_reader, (const uint8_t[]) {SRIX_READ_BLOCK, blockNum}, 2,
-                         (uint8_t *) block, SRIX_BLOCK_LENGTH) != SRIX_BLOCK_LENGTH);
+    }
 
-    return SRIX_NO_ERROR;
+    return inventory->count ? SRIX_NO_ERROR : SRIX_ERROR(NFC_TAG_MISSING, "SRIX4K tag isn't in the field");
+}
+
+SrixError NfcSelectChip(NfcReader reader[static 1], uint8_t chipId) {
+    if (!reader->transport) {
+        return SRIX_ERROR(NFC_ERROR, "nfc reader hasn't been opened");
+    }
+
+    for (uint8_t attempt = 1;; attempt++) {
+        SrixError stop = nfcInterrupted(reader);
+        if (SRIX_IS_ERROR(stop)) {
+            stop.attempts = attempt - 1;
+            return stop;
+        }
+
+        if (nfcSelectChipId(reader, attempt, chipId)) {
+            reader->chipId = chipId;
+            return SRIX_NO_ERROR;
+        }
+
+        if (attempt >= reader->retry.maxAttempts) {
+            return SRIX_ERROR_ATTEMPTS(NFC_TAG_MISSING, "SRIX4K tag isn't in the field", attempt);
+        }
+
+        nfcBackoff(reader, attempt);
+    }
+}
+
+/**
+ * Send a command to the tag until it answers with the expected response length.
+ * @param reader pointer to a NFC device
+ * @param command array of bytes to send
+ * @param commandSize number of bytes to send
+ * @param response pointer to an array of bytes where save the response
+ * @param responseSize expected response length
+ * @param message description of a response with a different length
+ * @return SrixError result
+ */
+static SrixError nfcExchangeRetry(NfcReader *reader, const uint8_t *command, size_t commandSize,
+                                  uint8_t *response, size_t responseSize, const char *message) {
+    for (uint8_t attempt = 1;; attempt++) {
+        SrixError stop = nfcInterrupted(reader);
+        if (SRIX_IS_ERROR(stop)) {
+            stop.attempts = attempt - 1;
+            return stop;
+        }
+
+        /* Send optimistically, check tag presence only when response length is different than expected */
+        if (nfcExchange(reader, attempt, command, commandSize, response, responseSize) == (int) responseSize) {
+            return SRIX_NO_ERROR;
+        }
+
+        /* A reselection error is more relevant than the response length */
+        SrixError error = nfcReselect(reader, attempt);
+        if (!SRIX_IS_ERROR(error)) {
+            error = SRIX_ERROR(NFC_SHORT_RESPONSE, message);
+        }
+
+        if (attempt >= reader->retry.maxAttempts) {
+            error.attempts = attempt;
+            return error;
+        }
+
+        nfcBackoff(reader, attempt);
+    }
+}
+
+SrixError NfcGetUid(NfcReader reader[static 1], uint8_t uid[const static SRIX_UID_LENGTH]) {
+    return nfcExchangeRetry(reader, (const uint8_t[]) {SRIX_GET_UID}, 1, uid, SRIX_UID_LENGTH,
+                            "invalid UID length");
+}
+
+SrixError NfcReadBlock(NfcReader reader[static 1], SrixBlock block[static 1], const uint8_t blockNum) {
+    return nfcExchangeRetry(reader, (const uint8_t[]) {SRIX_READ_BLOCK, blockNum}, 2, (uint8_t *) block,
+                            SRIX_BLOCK_LENGTH, "invalid block length");
 }
 
 SrixError NfcWriteBlock(NfcReader reader[static 1], SrixBlock block[static 1], const uint8_t blockNum) {
@@ -176,29 +627,63 @@ SrixError NfcWriteBlock(NfcReader reader[static 1], SrixBlock block[static 1], c
             block->block[3]
     };
 
+    const uint8_t readCommand[] = {SRIX_READ_BLOCK, blockNum};
+
     /* Array where save read block */
     SrixBlock check;
 
     /* Write while data aren't correct */
-    do {
-        /* Check tag presence */
-        if (nfc_initiator_target_is_present(reader->libnfc_reader, (void *) 0) < 0) {
-            SrixError error = nfcSrix4kInit(reader);
-            if (SRIX_IS_ERROR(error)) {
-                return error;
-            }
+    for (uint8_t attempt = 1;; attempt++) {
+        SrixError stop = nfcInterrupted(reader);
+        if (SRIX_IS_ERROR(stop)) {
+            stop.attempts = attempt - 1;
+            return stop;
         }
 
-        /* Write data */
-        nfcExchange(reader->libnfc_reader, writeCommand, 6, (void *) 0, 0);
+        /* Write data, a missing tag is detected by the read-back */
+        nfcExchange(reader, attempt, writeCommand, 6, (void *) 0, 0);
 
         /* Check written data */
-        NfcReadBlock(reader, &check, blockNum);
-    } while (memcmp(block, &check, SRIX_BLOCK_LENGTH) != 0);
+        SrixError failure = SRIX_ERROR(NFC_WRITE_MISMATCH, "written block differs from read-back");
+        if (nfcExchange(reader, attempt, readCommand, 2, (uint8_t *) &check, SRIX_BLOCK_LENGTH) !=
+            SRIX_BLOCK_LENGTH) {
+            failure = SRIX_ERROR(NFC_SHORT_RESPONSE, "invalid block length");
+        } else if (memcmp(block, &check, SRIX_BLOCK_LENGTH) == 0) {
+            return SRIX_NO_ERROR;
+        }
 
-    return SRIX_NO_ERROR;
+        /* A mismatch with the tag still answering doesn't need a reselection */
+        SrixError error = failure.errorType == NFC_WRITE_MISMATCH ? SRIX_NO_ERROR : nfcReselect(reader, attempt);
+        if (SRIX_IS_ERROR(error)) {
+            failure = error;
+        }
+
+        if (attempt >= reader->retry.maxAttempts) {
+            failure.attempts = attempt;
+            return failure;
+        }
+
+        nfcBackoff(reader, attempt);
+    }
 }
 
-#undef SRIX_GET_UID
-#undef SRIX_READ_BLOCK
-#undef SRIX_WRITE_BLOCK
\ No newline at end of file
+SrixError NfcWriteBlockUnchecked(NfcReader reader[static 1], SrixBlock block[static 1], const uint8_t blockNum) {
+    /* SRIX write command */
+    const uint8_t writeCommand[] = {
+            SRIX_WRITE_BLOCK,
+            blockNum,
+            block->block[0],
+            block->block[1],
+            block->block[2],
+            block->block[3]
+    };
+
+    SrixError stop = nfcInterrupted(reader);
+    if (SRIX_IS_ERROR(stop)) {
+        return stop;
+    }
+
+    /* Write command has no response, a missing tag will be detected by the verification */
+    nfcExchange(reader, 1, writeCommand, 6, (void *) 0, 0);
+    return SRIX_NO_ERROR;
+}
\ No newline at end of file
@@ -1,13 +1,33 @@
 #ifndef READER_H
 #define READER_H
 
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <nfc/nfc.h>
 #include "error.h"
+#include "trace.h"
 
 #define MAX_DEVICE_COUNT  8
 #define MAX_TARGET_COUNT  1
 
+/* NFC commands */
+#define SRIX_GET_UID      0x0B
+#define SRIX_READ_BLOCK   0x08
+#define SRIX_WRITE_BLOCK  0x09
+
+/* Anticollision commands */
+#define SRIX_INITIATE             0x06                /* followed by 0x00 */
+#define SRIX_PCALL16              0x06                /* followed by 0x04 */
+#define SRIX_SLOT_MARKER(slot)    ((uint8_t) ((slot) << 4U | 0x06U))
+#define SRIX_SELECT               0x0E                /* followed by Chip_ID */
+#define SRIX_COMPLETION           0x0F
+#define SRIX_RESET_TO_INVENTORY   0x0C
+
+#define NFC_INVENTORY_SIZE    16                      /* maximum number of tags of an inventory */
+#define NFC_INVENTORY_ROUNDS  8                       /* PCALL16 rounds to separate colliding tags */
+#define NFC_POLL_MICROS       10000                   /* delay between polls of a missing tag */
+
 /**
  * Single SRIX block.
  */
@@ -15,19 +35,102 @@ typedef struct SrixBlock {
     uint8_t block[SRIX_BLOCK_LENGTH];
 } SrixBlock;
 
+/**
+ * Radio round trips done by a NFC Reader.
+ */
+typedef struct NfcReaderStats {
+    uint32_t exchanges;                               /* commands sent to the tag */
+    uint32_t presenceChecks;                          /* tag presence probes */
+    uint32_t selects;                                 /* tag (re)selections */
+} NfcReaderStats;
+
+/**
+ * Retry policy of block exchanges.
+ * Delay between attempts starts from backoffMicros and is doubled at every retry, up to maxBackoffMicros.
+ */
+typedef struct NfcRetryPolicy {
+    uint8_t maxAttempts;                              /* attempts before giving up (at least 1) */
+    uint32_t backoffMicros;                           /* delay after first failed attempt */
+    uint32_t maxBackoffMicros;                        /* upper bound of delay */
+} NfcRetryPolicy;
+
+#define NFC_RETRY_POLICY_DEFAULT \
+    ((NfcRetryPolicy) {.maxAttempts = 8, .backoffMicros = 1000, .maxBackoffMicros = 64000})
+
+/**
+ * SRIX tags found in the field by the anticollision.
+ * Chip_ID of a tag is random and valid until the tag leaves the field.
+ */
+typedef struct NfcInventory {
+    uint8_t chipIds[NFC_INVENTORY_SIZE];              /* Chip_ID of every found tag */
+    uint8_t count;                                    /* number of found tags */
+    bool complete;                                    /* false if some tags kept colliding */
+} NfcInventory;
+
+/**
+ * Handle that cancels the operations of readers, it can be triggered by any thread.
+ */
+typedef struct NfcCancel {
+    atomic_bool cancelled;                            /* true when operations have to stop */
+} NfcCancel;
+
+/**
+ * Initialize a cancel handle, or reset it to use it again.
+ * @param cancel pointer to cancel handle
+ */
+static inline void NfcCancelReset(NfcCancel *cancel) {
+    atomic_store(&cancel->cancelled, false);
+}
+
+/**
+ * Cancel the operations that use a handle, they stop with SRIX_CANCELLED before their next radio operation.
+ * @param cancel pointer to cancel handle
+ */
+static inline void NfcCancelTrigger(NfcCancel *cancel) {
+    atomic_store(&cancel->cancelled, true);
+}
+
+/**
+ * Link between a NFC Reader and the tag, every function receives the transport context.
+ * Readers opened with NfcOpenReader use a libnfc device, other transports (e.g. an emulated tag)
+ * can be used with NfcOpenTransport.
+ */
+typedef struct NfcTransport {
+    int (*transceive)(void *context, const uint8_t *tx, size_t txSize, uint8_t *rx,
+                      size_t rxSize, int timeoutMillis); /* response length, negative on error, timeout 0 = none */
+    int (*select)(void *context, int timeoutMillis);  /* number of selected tags, negative on error, timeout 0 = none */
+    bool (*isPresent)(void *context);                 /* true if the selected tag answers */
+    const char *(*strerror)(void *context);           /* description of the last error */
+    void (*close)(void *context);                     /* release the transport, can be null */
+} NfcTransport;
+
 /**
  * Struct that represents a NFC Reader.
  */
 typedef struct NfcReader {
+    nfc_context *libnfc_context;                      /* libnfc context, null if only custom transports are used */
     nfc_connstring libnfc_readers[MAX_DEVICE_COUNT];  /* readers connstring array */
     nfc_device *libnfc_reader;                        /* libnfc reader */
+    const NfcTransport *transport;                    /* transport of open reader, null if closed */
+    void *transportContext;                           /* context passed to transport functions */
+    NfcReaderStats stats;                             /* round trips counters */
+    NfcRetryPolicy retry;                             /* block exchanges retry policy */
+    NfcTrace *trace;                                  /* traced radio operations, can be null */
+    uint64_t deadline;                                /* NfcTraceNow() time when operations stop, 0 = none */
+    NfcCancel *cancel;                                /* cancel handle of operations, can be null */
+    int16_t chipId;                                   /* Chip_ID selected by NfcSelectChip, -1 = none */
+    uint32_t linkBaudRate;                            /* PN532 UART baud rate requested at open, 0 = connstring one */
+    uint32_t linkEffectiveRate;                       /* baud rate of negotiated PN532 UART link, 0 = not negotiated */
+    uint32_t linkResetRate;                           /* baud rate of PN532 after reset, restored at close */
+    nfc_connstring linkPort;                          /* serial port of negotiated PN532 UART link */
 } NfcReader;
 
 /**
  * Allocate a nfc reader and set its default values.
+ * @param context libnfc context used to search and open devices, owned by the caller, can be null
  * @return null if there is an error, else an nfc reader pointer
  */
-NfcReader *NfcReaderNew();
+NfcReader *NfcReaderNew(nfc_context *context);
 
 /**
  * Close a nfc reader.
@@ -51,12 +154,124 @@ size_t NfcUpdateReaders(NfcReader *reader);
 char *NfcGetReaderDescription(NfcReader *reader, int selection);
 
 /**
- * Initialize an NFC Reader.
+ * Get round trips done by a reader since last reset.
+ * @param reader pointer to a NfcReader instance
+ * @return copy of reader counters
+ */
+NfcReaderStats NfcGetStats(NfcReader *reader);
+
+/**
+ * Reset round trips counters of a reader.
+ * @param reader pointer to a NfcReader instance
+ */
+void NfcResetStats(NfcReader *reader);
+
+/**
+ * Get total number of radio round trips in reader counters.
+ * @param stats pointer to reader counters
+ * @return sum of exchanges, presence checks and selections
+ */
+static inline uint32_t NfcStatsRoundTrips(const NfcReaderStats *stats) {
+    return stats->exchanges + stats->presenceChecks + stats->selects;
+}
+
+/**
+ * Set retry policy of block reads and writes.
+ * @param reader pointer to a NfcReader instance
+ * @param policy retry policy to use, maxAttempts 0 is treated as 1
+ */
+void NfcSetRetryPolicy(NfcReader *reader, NfcRetryPolicy policy);
+
+/**
+ * Record every radio operation of a reader in a trace.
+ * @param reader pointer to a NfcReader instance
+ * @param trace pointer to trace, null to disable tracing
+ */
+void NfcSetTrace(NfcReader *reader, NfcTrace *trace);
+
+/**
+ * Bound the next operations of a reader: they stop with SRIX_TIMEOUT after a deadline,
+ * or with SRIX_CANCELLED when the cancel handle is triggered.
+ * Exchanges are checked between attempts, and a single exchange never waits beyond the deadline.
+ * @param reader pointer to a NfcReader instance
+ * @param deadline NfcTraceNow() time when operations stop, 0 for no deadline
+ * @param cancel pointer to cancel handle, null for no cancellation
+ */
+void NfcSetDeadline(NfcReader *reader, uint64_t deadline, NfcCancel *cancel);
+
+/**
+ * Request a faster serial link for pn532_uart readers, negotiated with SetSerialBaudRate at the next open.
+ * If the PN532 doesn't accept the rate, the reader is opened at the rate of its connstring.
+ * Other readers ignore this setting.
+ * @param reader pointer to a NfcReader instance
+ * @param baudRate baud rate up to PN532_UART_MAX_BAUD_RATE, 0 to keep the connstring rate
+ */
+void NfcSetLinkBaudRate(NfcReader *reader, uint32_t baudRate);
+
+/**
+ * Get the baud rate of the serial link of an open reader.
+ * @param reader pointer to a NfcReader instance
+ * @return baud rate, 0 if the link hasn't been negotiated
+ */
+uint32_t NfcGetLinkBaudRate(NfcReader *reader);
+
+/**
+ * Open an NFC Reader without waiting for a tag.
  * @param reader pointer to Reader struct
- * @param selection id of Reader to initialize
+ * @param selection id of Reader to open
  * @return SrixError result
  */
-SrixError NfcInitReader(NfcReader *reader, int selection);
+SrixError NfcOpenReader(NfcReader *reader, int selection);
+
+/**
+ * Open an NFC Reader that uses a custom transport instead of a libnfc device.
+ * @param reader pointer to Reader struct
+ * @param transport transport functions
+ * @param context context passed to transport functions
+ */
+void NfcOpenTransport(NfcReader *reader, const NfcTransport *transport, void *context);
+
+/**
+ * Record every operation of an open reader in a session file, that can be replayed with NFC_REPLAY_TRANSPORT.
+ * Session file is saved when the reader is closed.
+ * @param reader pointer to Reader struct
+ * @param filename name of session file
+ * @return SrixError result
+ */
+SrixError NfcRecordSession(NfcReader *reader, const char *filename);
+
+/**
+ * Select the SRIX4K tag in the field of an open reader.
+ * @param reader pointer to Reader struct
+ * @param wait true to poll until a tag is found, false to return NFC_TAG_MISSING if there isn't one
+ * @return SrixError result
+ */
+SrixError NfcSelectTag(NfcReader *reader, bool wait);
+
+/**
+ * Find all SRIX tags in the field with the Chip_ID anticollision (INITIATE, PCALL16, SLOT_MARKER, SELECT).
+ * Found tags are left deselected, a tag has to be selected with NfcSelectChip before using it.
+ * @param reader pointer to Reader struct
+ * @param inventory pointer where save the found tags
+ * @return SrixError result, NFC_TAG_MISSING if there aren't tags
+ */
+SrixError NfcInventoryTags(NfcReader *reader, NfcInventory *inventory);
+
+/**
+ * Select a tag found by NfcInventoryTags, deselecting the previous one.
+ * Later reselections after failed exchanges use the same Chip_ID, so they never switch to another tag.
+ * @param reader pointer to Reader struct
+ * @param chipId Chip_ID of tag
+ * @return SrixError result, NFC_TAG_MISSING if the tag doesn't answer
+ */
+SrixError NfcSelectChip(NfcReader *reader, uint8_t chipId);
+
+/**
+ * Check if the selected tag is still in the field of the reader.
+ * @param reader pointer to Reader struct
+ * @return true if the tag answers, else false
+ */
+bool NfcTagIsPresent(NfcReader *reader);
 
 /**
  * Get UID from Reader as raw byte array.
@@ -68,10 +283,11 @@ SrixError NfcGetUid(NfcReader *reader, uint8_t uid[const static SRIX_UID_LENGTH]
 
 /**
  * Read a specified block from SRIX4K to block array.
+ * Read command is sent straight away, tag presence is checked only after a failed response.
  * @param reader nfc reader to send command
  * @param block array to save read block
  * @param blockNum block to read from SRIX
- * @return SrixError result
+ * @return SrixError result, NFC_SHORT_RESPONSE or NFC_TAG_MISSING when retries are exhausted
  */
 SrixError NfcReadBlock(NfcReader *reader, SrixBlock *block, uint8_t blockNum);
 
@@ -80,8 +296,18 @@ SrixError NfcReadBlock(NfcReader *reader, SrixBlock *block, uint8_t blockNum);
  * @param reader nfc reader to send command
  * @param block array of data to write to block
  * @param blockNum block to write to SRIX
- * @return SrixError result
+ * @return SrixError result, NFC_WRITE_MISMATCH when written data can't be read back after all retries
  */
 SrixError NfcWriteBlock(NfcReader *reader, SrixBlock *block, uint8_t blockNum);
 
+/**
+ * Write a specified block to SRIX4K without reading it back.
+ * Caller is responsible to verify written data later (e.g. with NfcReadBlock).
+ * @param reader nfc reader to send command
+ * @param block array of data to write to block
+ * @param blockNum block to write to SRIX
+ * @return SrixError result
+ */
+SrixError NfcWriteBlockUnchecked(NfcReader *reader, SrixBlock *block, uint8_t blockNum);
+
 #endif /* READER_H */
\ No newline at end of file
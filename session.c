@@ -0,0 +1,388 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "session.h"
+
+#define SESSION_MAGIC       "SRIXSESS"
+#define SESSION_VERSION     1
+#define SESSION_BYTE_ORDER  0x01020304U
+
+/* Records searched ahead when the replayed operations don't follow the recorded order */
+#define SESSION_REPLAY_WINDOW  64
+
+/**
+ * Session file header, followed by records.
+ */
+typedef struct SessionHeader {
+    char magic[8];                    /* SESSION_MAGIC */
+    uint32_t version;                 /* SESSION_VERSION */
+    uint32_t byteOrder;               /* SESSION_BYTE_ORDER written in host order */
+} SessionHeader;
+
+/**
+ * Recorded operation, followed by txSize request bytes and rxSize response bytes.
+ */
+typedef struct SessionRecord {
+    uint64_t startNanos;              /* start of operation since start of recording */
+    uint32_t durationNanos;           /* duration of operation */
+    int16_t result;                   /* response length (negative = error), selected tags or presence */
+    uint8_t kind;                     /* NfcTraceKind */
+    uint8_t txSize;                   /* request bytes */
+    uint8_t rxSize;                   /* response bytes */
+    uint8_t reserved[7];              /* keeps records 24 bytes long, a multiple of 8 */
+} SessionRecord;
+
+/**
+ * Session recorder.
+ */
+struct NfcRecorder {
+    FILE *file;                       /* session file */
+    const NfcTransport *transport;    /* recorded transport */
+    void *context;                    /* context of recorded transport */
+    uint64_t origin;                  /* start of recording */
+};
+
+/**
+ * Session replay.
+ */
+struct NfcReplay {
+    uint8_t *mapping;                 /* mapped session file */
+    size_t size;                      /* size of mapped file */
+    size_t offset;                    /* offset of next record */
+    double speed;                     /* replay speed, 0 = no delay */
+    uint64_t origin;                  /* monotonic time matching the start of recording, 0 before first delay */
+    NfcReplayStats stats;             /* replay counters */
+};
+
+/**
+ * Build the header of a session recorded by this host.
+ * @return session header
+ */
+static SessionHeader sessionHeader() {
+    SessionHeader header = {
+            .version = SESSION_VERSION,
+            .byteOrder = SESSION_BYTE_ORDER
+    };
+    memcpy(header.magic, SESSION_MAGIC, sizeof(header.magic));
+    return header;
+}
+
+/**
+ * Save a record in the session file.
+ * @param recorder pointer to NfcRecorder
+ * @param record record to save
+ * @param tx request bytes
+ * @param rx response bytes
+ */
+static void recorderSave(NfcRecorder *recorder, SessionRecord record, const uint8_t *tx, const uint8_t *rx) {
+    /* Session file is buffered, a failed write is detected on close */
+    fwrite(&record, sizeof(record), 1, recorder->file);
+    if (record.txSize) {
+        fwrite(tx, sizeof(uint8_t), record.txSize, recorder->file);
+    }
+    if (record.rxSize) {
+        fwrite(rx, sizeof(uint8_t), record.rxSize, recorder->file);
+    }
+}
+
+/**
+ * Send bytes with the recorded transport and save request and response.
+ */
+static int recorderTransceive(void *context, const uint8_t *tx, size_t txSize, uint8_t *rx, size_t rxSize,
+                              int timeoutMillis) {
+    NfcRecorder *recorder = context;
+    uint64_t start = NfcTraceNow();
+
+    int result = recorder->transport->transceive(recorder->context, tx, txSize, rx, rxSize, timeoutMillis);
+
+    size_t received = result > 0 ? ((size_t) result < rxSize ? (size_t) result : rxSize) : 0;
+    recorderSave(recorder, (SessionRecord) {
+            .startNanos = start - recorder->origin,
+            .durationNanos = (uint32_t) (NfcTraceNow() - start),
+            .result = (int16_t) result,
+            .kind = NFC_TRACE_EXCHANGE,
+            .txSize = txSize > UINT8_MAX ? UINT8_MAX : txSize,
+            .rxSize = received > UINT8_MAX ? UINT8_MAX : received
+    }, tx, rx);
+
+    return result;
+}
+
+/**
+ * Select a tag with the recorded transport and save the result.
+ */
+static int recorderSelect(void *context, int timeoutMillis) {
+    NfcRecorder *recorder = context;
+    uint64_t start = NfcTraceNow();
+
+    int found = recorder->transport->select(recorder->context, timeoutMillis);
+
+    recorderSave(recorder, (SessionRecord) {
+            .startNanos = start - recorder->origin,
+            .durationNanos = (uint32_t) (NfcTraceNow() - start),
+            .result = (int16_t) found,
+            .kind = NFC_TRACE_SELECT
+    }, (void *) 0, (void *) 0);
+
+    return found;
+}
+
+/**
+ * Check tag presence with the recorded transport and save the result.
+ */
+static bool recorderIsPresent(void *context) {
+    NfcRecorder *recorder = context;
+    uint64_t start = NfcTraceNow();
+
+    bool present = recorder->transport->isPresent(recorder->context);
+
+    recorderSave(recorder, (SessionRecord) {
+            .startNanos = start - recorder->origin,
+            .durationNanos = (uint32_t) (NfcTraceNow() - start),
+            .result = present,
+            .kind = NFC_TRACE_PRESENCE
+    }, (void *) 0, (void *) 0);
+
+    return present;
+}
+
+/**
+ * Get last error of the recorded transport.
+ */
+static const char *recorderStrerror(void *context) {
+    NfcRecorder *recorder = context;
+    return recorder->transport->strerror(recorder->context);
+}
+
+/**
+ * Save the session file and close the recorded transport.
+ */
+static void recorderClose(void *context) {
+    NfcRecorder *recorder = context;
+    if (fclose(recorder->file) != 0) {
+        fprintf(stderr, "Unable to save NFC session file\n");
+    }
+
+    if (recorder->transport->close) {
+        recorder->transport->close(recorder->context);
+    }
+    free(recorder);
+}
+
+const NfcTransport NFC_RECORDER_TRANSPORT = {
+        .transceive = recorderTransceive,
+        .select = recorderSelect,
+        .isPresent = recorderIsPresent,
+        .strerror = recorderStrerror,
+        .close = recorderClose
+};
+
+NfcRecorder *NfcRecorderNew(const char *filename, const NfcTransport transport[static 1], void *context) {
+    NfcRecorder *created = malloc(sizeof(NfcRecorder));
+    if (!created) {
+        return (void *) 0;
+    }
+
+    created->file = fopen(filename, "wb");
+    SessionHeader header = sessionHeader();
+    if (!created->file || fwrite(&header, sizeof(header), 1, created->file) != 1) {
+        if (created->file) {
+            fclose(created->file);
+        }
+        free(created);
+        return (void *) 0;
+    }
+
+    created->transport = transport;
+    created->context = context;
+    created->origin = NfcTraceNow();
+    return created;
+}
+
+/**
+ * Get the next record that matches an operation.
+ * If the next record doesn't match, records are skipped to the first matching one in SESSION_REPLAY_WINDOW.
+ * @param replay pointer to NfcReplay
+ * @param kind kind of operation
+ * @param tx request bytes of exchanges
+ * @param txSize number of request bytes
+ * @param record pointer where save the record
+ * @return pointer to record response bytes, null if there isn't a matching record
+ */
+static const uint8_t *replayNext(NfcReplay *replay, NfcTraceKind kind, const uint8_t *tx, size_t txSize,
+                                 SessionRecord *record) {
+    size_t offset = replay->offset;
+
+    for (size_t skipped = 0; skipped < SESSION_REPLAY_WINDOW; skipped++) {
+        if (offset + sizeof(SessionRecord) > replay->size) {
+            break;
+        }
+
+        /* Records aren't aligned, they are followed by variable length data */
+        memcpy(record, replay->mapping + offset, sizeof(SessionRecord));
+        const uint8_t *data = replay->mapping + offset + sizeof(SessionRecord);
+        offset += sizeof(SessionRecord) + record->txSize + record->rxSize;
+        if (offset > replay->size) {
+            break;
+        }
+
+        if (record->kind == kind &&
+            (kind != NFC_TRACE_EXCHANGE || (record->txSize == txSize && memcmp(data, tx, txSize) == 0))) {
+            replay->offset = offset;
+            replay->stats.replayed++;
+            replay->stats.skipped += skipped;
+            return data + record->txSize;
+        }
+    }
+
+    replay->stats.diverged++;
+    return (void *) 0;
+}
+
+/**
+ * Wait until the scaled end of an operation, so the gaps between recorded operations are replayed too.
+ * Timeline starts with the first replayed operation, replay doesn't wait when it's late.
+ * @param replay pointer to NfcReplay
+ * @param record replayed record
+ */
+static void replayDelay(NfcReplay *replay, const SessionRecord *record) {
+    if (replay->speed <= 0) {
+        return;
+    }
+
+    uint64_t now = NfcTraceNow();
+    if (!replay->origin) {
+        replay->origin = now - (uint64_t) (record->startNanos / replay->speed);
+    }
+
+    uint64_t end = replay->origin + (uint64_t) ((record->startNanos + record->durationNanos) / replay->speed);
+    if (end > now) {
+        struct timespec wakeUp = {.tv_sec = end / 1000000000U, .tv_nsec = end % 1000000000U};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeUp, (void *) 0);
+    }
+}
+
+/**
+ * Answer an exchange with the recorded response.
+ */
+static int replayTransceive(void *context, const uint8_t *tx, size_t txSize, uint8_t *rx, size_t rxSize,
+                            int timeoutMillis) {
+    NfcReplay *replay = context;
+    (void) timeoutMillis;
+    SessionRecord record;
+
+    const uint8_t *response = replayNext(replay, NFC_TRACE_EXCHANGE, tx, txSize, &record);
+    if (!response) {
+        return NFC_ETIMEOUT;
+    }
+
+    replayDelay(replay, &record);
+    memcpy(rx, response, record.rxSize < rxSize ? record.rxSize : rxSize);
+    return record.result;
+}
+
+/**
+ * Answer a selection with the recorded result.
+ */
+static int replaySelect(void *context, int timeoutMillis) {
+    (void) timeoutMillis;
+    NfcReplay *replay = context;
+    SessionRecord record;
+
+    /* Without a record selection fails, so polling for a tag doesn't wait forever */
+    if (!replayNext(replay, NFC_TRACE_SELECT, (void *) 0, 0, &record)) {
+        return NFC_EIO;
+    }
+
+    replayDelay(replay, &record);
+    return record.result;
+}
+
+/**
+ * Answer a presence check with the recorded result.
+ */
+static bool replayIsPresent(void *context) {
+    NfcReplay *replay = context;
+    SessionRecord record;
+
+    if (!replayNext(replay, NFC_TRACE_PRESENCE, (void *) 0, 0, &record)) {
+        return false;
+    }
+
+    replayDelay(replay, &record);
+    return record.result;
+}
+
+/**
+ * Get last error of a replayed session.
+ */
+static const char *replayStrerror(void *context) {
+    (void) context;
+    return "operation not found in replayed session";
+}
+
+const NfcTransport NFC_REPLAY_TRANSPORT = {
+        .transceive = replayTransceive,
+        .select = replaySelect,
+        .isPresent = replayIsPresent,
+        .strerror = replayStrerror,
+        .close = (void *) 0
+};
+
+NfcReplay *NfcReplayOpen(const char *filename, double speed) {
+    int file = open(filename, O_RDONLY);
+    if (file < 0) {
+        return (void *) 0;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) != 0 || (size_t) info.st_size < sizeof(SessionHeader)) {
+        close(file);
+        return (void *) 0;
+    }
+
+    uint8_t *mapping = mmap((void *) 0, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED) {
+        return (void *) 0;
+    }
+
+    SessionHeader expected = sessionHeader();
+    NfcReplay *created = malloc(sizeof(NfcReplay));
+    if (memcmp(mapping, &expected, sizeof(SessionHeader)) != 0 || !created) {
+        munmap(mapping, info.st_size);
+        free(created);
+        return (void *) 0;
+    }
+
+    created->mapping = mapping;
+    created->size = info.st_size;
+    created->offset = sizeof(SessionHeader);
+    created->speed = speed;
+    created->origin = 0;
+    created->stats = (NfcReplayStats) {0};
+
+    /* Count complete records */
+    SessionRecord record;
+    for (size_t offset = created->offset; offset + sizeof(SessionRecord) <= created->size;) {
+        memcpy(&record, mapping + offset, sizeof(SessionRecord));
+        offset += sizeof(SessionRecord) + record.txSize + record.rxSize;
+        created->stats.records += offset <= created->size;
+    }
+
+    return created;
+}
+
+NfcReplayStats NfcReplayGetStats(NfcReplay replay[static 1]) {
+    return replay->stats;
+}
+
+void NfcReplayClose(NfcReplay replay[static 1]) {
+    munmap(replay->mapping, replay->size);
+    free(replay);
+}
@@ -0,0 +1,71 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "error.h"
+#include "reader.h"
+
+/**
+ * Records a NFC session: every operation of a transport is saved in a binary session file,
+ * with its timing, request and response.
+ */
+typedef struct NfcRecorder NfcRecorder;
+
+/**
+ * Replays a recorded NFC session as a transport.
+ */
+typedef struct NfcReplay NfcReplay;
+
+/**
+ * Counters of a replayed session.
+ */
+typedef struct NfcReplayStats {
+    size_t records;                   /* records in session file */
+    size_t replayed;                  /* records used to answer an operation */
+    size_t skipped;                   /* records skipped to follow a different operation order */
+    size_t diverged;                  /* operations without a matching record */
+} NfcReplayStats;
+
+/**
+ * Transport that records every operation of another transport, the context is a NfcRecorder pointer.
+ * Closing it saves the session file and closes the recorded transport.
+ */
+extern const NfcTransport NFC_RECORDER_TRANSPORT;
+
+/**
+ * Transport that answers from a recorded session, the context is a NfcReplay pointer.
+ */
+extern const NfcTransport NFC_REPLAY_TRANSPORT;
+
+/**
+ * Start recording a transport.
+ * @param filename name of session file
+ * @param transport transport to record
+ * @param context context of transport to record
+ * @return null if there is an error, else a NfcRecorder pointer
+ */
+NfcRecorder *NfcRecorderNew(const char *filename, const NfcTransport *transport, void *context);
+
+/**
+ * Open a session file to replay.
+ * @param filename name of session file
+ * @param speed replay speed: 1 = original timing, 2 = twice as fast, 0 = no delay
+ * @return null if there is an error, else a NfcReplay pointer
+ */
+NfcReplay *NfcReplayOpen(const char *filename, double speed);
+
+/**
+ * Get the counters of a replayed session.
+ * @param replay pointer to NfcReplay
+ * @return copy of replay counters
+ */
+NfcReplayStats NfcReplayGetStats(NfcReplay *replay);
+
+/**
+ * Close a replayed session and free its memory.
+ * @param replay pointer to NfcReplay
+ */
+void NfcReplayClose(NfcReplay *replay);
+
+#endif /* SESSION_H */
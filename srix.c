@@ -1,8 +1,21 @@
 #include <string.h>
+#include <time.h>
+#include "cache.h"
+#include "journal.h"
 #include "reader.h"
 #include "srix.h"
 #include "srixflag.h"
 
+/**
+ * With SRIX_VERIFY_SAMPLED, one block every SRIX_VERIFY_SAMPLE_STEP written blocks is read back.
+ */
+#define SRIX_VERIFY_SAMPLE_STEP 4
+
+/**
+ * OTP (0-4) and counter (5-6) blocks change at every use of the tag, they are never taken from cache.
+ */
+#define SRIX_VOLATILE_BLOCKS 7
+
 /**
  * Generic SRIX4K tag
  */
@@ -16,12 +29,37 @@ struct Srix {
         };
         uint32_t eeprom[SRIX4K_BLOCKS]; /* SRIX4K EEPROM */
     };
+    uint32_t shadow[SRIX4K_BLOCKS];     /* EEPROM as last read from (or written to) the tag */
     uint64_t uid;                       /* SRIX UID */
     SrixFlag blockFlags;                /* Modified block flags */
-    NfcReader *reader;                  /* NFC Reader */
+    SrixFlag shadowFlags;               /* Blocks with a valid shadow copy */
+    SrixFlag loadedFlags;               /* Blocks with a valid value in eeprom */
+    SrixFlag writtenFlags;              /* Blocks written on the tag by the last write */
+    bool lazy;                          /* Read blocks from tag on first access */
+    SrixCache *cache;                   /* Dumps of known tags, can be null */
+    uint8_t cacheSamples;               /* Cached blocks verified on the tag at every hit */
+    SrixJournal *journal;               /* Journal of interrupted writes, can be null */
+    SrixUidFilter uidFilter;            /* Filter of selected tags, can be null */
+    void *uidFilterData;                /* User data of UID filter */
+    SrixVerifyMode verifyMode;          /* Verification of written blocks */
+    NfcReader *reader;                  /* NFC Reader, created on first use */
+    NfcRetryPolicy retryPolicy;         /* Retry policy of NFC Reader */
+    uint32_t linkBaudRate;              /* Requested PN532 UART baud rate, 0 = connstring one */
+    NfcTrace *trace;                    /* Trace of NFC Reader, can be null */
+    SrixContext *context;               /* Context of NFC Reader, can be null */
+    uint64_t deadline;                  /* Deadline of NFC operations, 0 = none */
+    NfcCancel *cancel;                  /* Cancel handle of NFC operations, can be null */
+    uint32_t tagTimeout;                /* Milliseconds available to every tag from its selection, 0 = none */
     SrixError error;                         /* Error */
 };
 
+/**
+ * Library context, shared by the Srix created with it.
+ */
+struct SrixContext {
+    nfc_context *libnfc;                /* libnfc context, initialized on first use */
+};
+
 /**
  * Get UID from a SRIX4K.
  * @param target pointer to Srix instance where save UID
@@ -50,64 +88,439 @@ static SrixError getUid(Srix *target) {
 }
 
 /**
- * Read all blocks from a SRIX4K.
+ * Read a range of blocks from a SRIX4K, skipping the ones already loaded.
  * @param target pointer to Srix instance where save EEPROM content
+ * @param first first block to read
+ * @param count number of blocks to read
  * @return SrixError result
  */
-static SrixError readBlocks(Srix *target) {
-    if (!target->reader) {
-        return SRIX_ERROR(SRIX_ERROR, "nfc reader hasn't been initialized");
-    }
-
-    for (uint8_t i = 0; i < SRIX4K_BLOCKS; i++) {
+static SrixError readBlocks(Srix *target, uint8_t first, uint8_t count) {
+    for (uint16_t i = first; i < (uint16_t) first + count && i < SRIX4K_BLOCKS; i++) {
         uint8_t readBlock[SRIX_BLOCK_LENGTH];
 
+        if (srixFlagGet(&target->loadedFlags, i)) {
+            continue;
+        }
+
+        if (!target->reader) {
+            return SRIX_ERROR(SRIX_ERROR, "nfc reader hasn't been initialized");
+        }
+
         SrixError error = NfcReadBlock(target->reader, (SrixBlock *) readBlock, i);
         if (SRIX_IS_ERROR(error)) {
             return error;
         }
 
         target->eeprom[i] = readBlock[0] << 24 | readBlock[1] << 16 | readBlock[2] << 8 | readBlock[3];
+        target->shadow[i] = target->eeprom[i];
+        srixFlagAdd(&target->shadowFlags, i);
+        srixFlagAdd(&target->loadedFlags, i);
     }
 
     return SRIX_NO_ERROR;
 }
 
 /**
- * Write a selected group of blocks on SRIX4K.
- * @param target pointer to Srix instance to take the blocks to write
- * @param groupPointer pointer to array to write
- * @param groupSize size of array to write
+ * Load non volatile blocks of the current tag from cache.
+ * A sample of cached blocks is read from the tag, a mismatch invalidates the cache entry.
+ * @param target pointer to Srix instance with the UID of the tag
+ * @return true if blocks have been loaded from cache
+ */
+static bool srixCacheLoad(Srix *target) {
+    uint32_t cached[SRIX4K_BLOCKS];
+    if (!target->cache || !SrixCacheLoad(target->cache, target->uid, cached)) {
+        return false;
+    }
+
+    /* Sampled verification (xorshift random blocks) */
+    uint64_t seed = target->uid ^ (uint64_t) time((void *) 0) ^ 0x9E3779B97F4A7C15U;
+    for (uint8_t i = 0; i < target->cacheSamples; i++) {
+        seed ^= seed << 13U;
+        seed ^= seed >> 7U;
+        seed ^= seed << 17U;
+
+        const uint8_t blockNum = SRIX_VOLATILE_BLOCKS + seed % (SRIX4K_BLOCKS - SRIX_VOLATILE_BLOCKS);
+        if (SRIX_IS_ERROR(readBlocks(target, blockNum, 1))) {
+            return false;
+        }
+
+        if (target->eeprom[blockNum] != cached[blockNum]) {
+            SrixCacheRemove(target->cache, target->uid);
+            return false;
+        }
+    }
+
+    /* Cached blocks are treated as read from the tag */
+    for (uint8_t i = SRIX_VOLATILE_BLOCKS; i < SRIX4K_BLOCKS; i++) {
+        if (!srixFlagGet(&target->loadedFlags, i)) {
+            target->eeprom[i] = cached[i];
+            target->shadow[i] = cached[i];
+            srixFlagAdd(&target->shadowFlags, i);
+            srixFlagAdd(&target->loadedFlags, i);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Save the current tag in cache, if all its non volatile blocks are confirmed by the tag.
+ * Shadow copy is stored instead of eeprom, that can hold values loaded from a file and never written.
+ * @param target pointer to Srix instance
+ */
+static void srixCacheStore(Srix *target) {
+    if (!target->cache) {
+        return;
+    }
+
+    /* Volatile blocks don't have to be confirmed */
+    SrixFlag required = target->shadowFlags;
+    srixFlagAddRange(&required, 0, SRIX_VOLATILE_BLOCKS);
+    if (srixFlagCount(&required) != SRIX4K_BLOCKS) {
+        return;
+    }
+
+    /* Volatile blocks of a cache entry are never loaded, they are always read from the tag */
+    uint32_t confirmed[SRIX4K_BLOCKS];
+    for (uint8_t i = 0; i < SRIX4K_BLOCKS; i++) {
+        confirmed[i] = srixFlagGet(&target->shadowFlags, i) ? target->shadow[i] : 0xFFFFFFFF;
+    }
+
+    /* Cache is an optimization, a failed store isn't an error */
+    SrixCacheStore(target->cache, target->uid, confirmed);
+}
+
+/**
+ * Load the blocks confirmed by the unfinished write of the current tag, so they aren't read again.
+ * @param target pointer to Srix instance with the UID of the tag
+ * @return true if the tag has an unfinished write
+ */
+static bool srixJournalLoad(Srix *target) {
+    SrixJournalRecord record;
+    if (!target->journal || !SrixJournalLoad(target->journal, target->uid, &record)) {
+        return false;
+    }
+
+    /* Unconfirmed blocks are read from the tag, their write could have landed or not */
+    SrixFlag confirmed = {{record.confirmed[0], record.confirmed[1], record.confirmed[2], record.confirmed[3]}};
+    for (uint8_t i = srixFlagNext(&confirmed, 0); i < SRIX4K_BLOCKS; i = srixFlagNext(&confirmed, i + 1)) {
+        target->eeprom[i] = record.values[i];
+        target->shadow[i] = record.values[i];
+        srixFlagAdd(&target->shadowFlags, i);
+        srixFlagAdd(&target->loadedFlags, i);
+    }
+
+    return true;
+}
+
+/**
+ * Record the planned write set in the journal, before writing the first block.
+ * @param target pointer to Srix instance
+ * @param plan pointer to write plan
+ * @return SrixError result
+ */
+static SrixError srixJournalBegin(Srix *target, const SrixWritePlan *plan) {
+    if (!target->journal) {
+        return SRIX_NO_ERROR;
+    }
+
+    SrixJournalRecord record = {.uid = target->uid};
+    for (uint8_t i = 0; i < plan->count; i++) {
+        const SrixWriteStep *step = &plan->steps[i];
+        if (step->type != SRIX_STEP_VERIFY) {
+            record.planned[step->block / 32] |= 1U << step->block % 32;
+            record.values[step->block] = step->value;
+        }
+    }
+
+    return SrixJournalBegin(target->journal, &record);
+}
+
+/**
+ * Convert a block to the byte order used by SRIX4K.
+ * @param value block value
+ * @param block pointer to SrixBlock where save converted bytes
+ */
+static inline void srixBlockToBytes(uint32_t value, SrixBlock *block) {
+    block->block[0] = value >> 24;
+    block->block[1] = value >> 16;
+    block->block[2] = value >> 8;
+    block->block[3] = value;
+}
+
+/**
+ * Get the blocks that have to be written on SRIX4K.
+ * A flagged block is skipped when its value is the same as the one last read from the tag.
+ * @param target pointer to Srix instance
+ * @return flags of blocks that differ from the tag content
+ */
+static SrixFlag srixDirtyFlags(Srix *target) {
+    SrixFlag dirty = target->blockFlags;
+
+    for (uint8_t i = srixFlagNext(&dirty, 0); i < SRIX4K_BLOCKS; i = srixFlagNext(&dirty, i + 1)) {
+        if (srixFlagGet(&target->shadowFlags, i) && target->shadow[i] == target->eeprom[i]) {
+            srixFlagRemove(&dirty, i);
+        }
+    }
+
+    return dirty;
+}
+
+/**
+ * Update the shadow copy of a block after it has been written on SRIX4K.
+ * Only blocks read back from the tag are confirmed in the journal, a resumed write rewrites the others.
+ * @param target pointer to Srix instance
+ * @param blockNum written block
+ * @param value value written on the tag
+ * @param readBack true if the value has been read back from the tag
+ */
+static inline void srixShadowUpdate(Srix *target, uint8_t blockNum, uint32_t value, bool readBack) {
+    target->shadow[blockNum] = value;
+    srixFlagAdd(&target->shadowFlags, blockNum);
+    srixFlagAdd(&target->writtenFlags, blockNum);
+
+    if (target->journal && readBack) {
+        SrixJournalConfirm(target->journal, blockNum);
+    }
+}
+
+/**
+ * Read back blocks written without verification and write again the mismatching ones.
+ * With sampling only one written block every sampleStep is read back, if one of them
+ * is wrong all written blocks are verified.
+ * @param target pointer to Srix instance
+ * @param written pointer to SrixFlag with the blocks to verify
+ * @param expected values written by the plan, indexed by block
+ * @param sampleStep 1 to verify all blocks, else distance between verified blocks
  * @return SrixError result
  */
-static SrixError srixWriteGroup(Srix *target, uint32_t *groupPointer, uint8_t groupSize) {
-    for (uint64_t i = 0; i < groupSize; i++) {
-        if (srixFlagGet(&target->blockFlags, groupPointer + i - target->eeprom)) {
-            const uint8_t writeBlock[] = {
-                    groupPointer[i] >> 24,
-                    groupPointer[i] >> 16,
-                    groupPointer[i] >> 8,
-                    groupPointer[i]
-            };
-
-            SrixError error = NfcWriteBlock(target->reader, (SrixBlock *) writeBlock,
-                                             groupPointer + i - target->eeprom);
+static SrixError srixVerifyBlocks(Srix *target, SrixFlag *written, const uint32_t expected[static SRIX4K_BLOCKS],
+                                  uint8_t sampleStep) {
+    SrixFlag checked = SRIX_FLAG_INIT;
+    uint8_t position = 0;
+    uint8_t lastBlock = 0;
+
+    for (uint8_t i = srixFlagNext(written, 0); i < SRIX4K_BLOCKS; i = srixFlagNext(written, i + 1)) {
+        lastBlock = i;
+    }
+
+    for (uint8_t i = srixFlagNext(written, 0); i < SRIX4K_BLOCKS; i = srixFlagNext(written, i + 1)) {
+        /* Last written block is always verified, it was the most likely to be interrupted */
+        if (position++ % sampleStep != 0 && i != lastBlock) {
+            continue;
+        }
+
+        SrixBlock expectedBlock;
+        SrixBlock check;
+        srixBlockToBytes(expected[i], &expectedBlock);
+
+        SrixError error = NfcReadBlock(target->reader, &check, i);
+        if (SRIX_IS_ERROR(error)) {
+            return error;
+        }
+
+        if (memcmp(&expectedBlock, &check, SRIX_BLOCK_LENGTH) != 0) {
+            if (sampleStep != 1) {
+                /* Sample failed, verify everything */
+                return srixVerifyBlocks(target, written, expected, 1);
+            }
+
+            /* Write again the block, this time with read-back */
+            error = NfcWriteBlock(target->reader, &expectedBlock, i);
             if (SRIX_IS_ERROR(error)) {
                 return error;
             }
         }
+        srixFlagAdd(&checked, i);
     }
 
+    /* All written blocks are now on the tag */
+    for (uint8_t i = srixFlagNext(written, 0); i < SRIX4K_BLOCKS; i = srixFlagNext(written, i + 1)) {
+        srixShadowUpdate(target, i, expected[i], srixFlagGet(&checked, i));
+    }
+
+    *written = SRIX_FLAG_INIT;
     return SRIX_NO_ERROR;
 }
 
-Srix *SrixNew() {
+/**
+ * Add a step to a write plan.
+ * @param plan pointer to write plan
+ * @param step step to add
+ */
+static inline void srixPlanAdd(SrixWritePlan *plan, SrixWriteStep step) {
+    plan->steps[plan->count++] = step;
+    plan->roundTrips += step.roundTrips;
+}
+
+/**
+ * Add a verify step for the blocks written without check, if there are any.
+ * @param plan pointer to write plan
+ * @param unchecked pointer to number of blocks written without check, reset by this function
+ * @param sampleStep distance between read back blocks, 1 = all
+ */
+static void srixPlanVerify(SrixWritePlan *plan, uint8_t *unchecked, uint8_t sampleStep) {
+    if (*unchecked == 0) {
+        return;
+    }
+
+    /* A block every sampleStep, plus the last one */
+    uint16_t reads = (*unchecked + sampleStep - 1) / sampleStep + ((*unchecked - 1) % sampleStep != 0);
+    srixPlanAdd(plan, (SrixWriteStep) {
+            .type = SRIX_STEP_VERIFY,
+            .block = *unchecked,
+            .sampleStep = sampleStep,
+            .roundTrips = reads
+    });
+    *unchecked = 0;
+}
+
+/**
+ * Execute a single step of a write plan on SRIX4K.
+ * @param target pointer to Srix instance
+ * @param plan pointer to write plan
+ * @param index index of step to execute
+ * @return SrixError result
+ */
+static SrixError srixExecuteStep(Srix *target, const SrixWritePlan *plan, uint8_t index) {
+    const SrixWriteStep *step = &plan->steps[index];
+    SrixError error = SRIX_NO_ERROR;
+    SrixBlock writeBlock;
+
+    switch (step->type) {
+        case SRIX_STEP_WRITE:
+            srixBlockToBytes(step->value, &writeBlock);
+
+            /* Tag content is unknown until the write is confirmed */
+            srixFlagRemove(&target->shadowFlags, step->block);
+            error = NfcWriteBlock(target->reader, &writeBlock, step->block);
+            if (!SRIX_IS_ERROR(error)) {
+                srixShadowUpdate(target, step->block, step->value, true);
+            }
+            break;
+        case SRIX_STEP_WRITE_UNCHECKED:
+            srixBlockToBytes(step->value, &writeBlock);
+
+            srixFlagRemove(&target->shadowFlags, step->block);
+            error = NfcWriteBlockUnchecked(target->reader, &writeBlock, step->block);
+            break;
+        case SRIX_STEP_VERIFY: {
+            /* Blocks written but not verified yet, since the previous verify step */
+            SrixFlag written = SRIX_FLAG_INIT;
+            uint32_t expected[SRIX4K_BLOCKS];
+            for (uint8_t i = index; i > 0 && plan->steps[i - 1].type != SRIX_STEP_VERIFY; i--) {
+                if (plan->steps[i - 1].type == SRIX_STEP_WRITE_UNCHECKED) {
+                    srixFlagAdd(&written, plan->steps[i - 1].block);
+                    expected[plan->steps[i - 1].block] = plan->steps[i - 1].value;
+                }
+            }
+
+            error = srixVerifyBlocks(target, &written, expected, step->sampleStep);
+            break;
+        }
+    }
+
+    return error;
+}
+
+/**
+ * Update a Srix after all steps of a write plan have been executed.
+ * @param target pointer to Srix instance
+ * @param plan pointer to executed write plan
+ */
+static void srixPlanDone(Srix *target, const SrixWritePlan *plan) {
+    /* Blocks modified after the plan was compiled still differ from the tag */
+    for (uint8_t i = srixFlagNext(&target->blockFlags, 0); i < SRIX4K_BLOCKS;
+         i = srixFlagNext(&target->blockFlags, i + 1)) {
+        if (srixFlagGet(&target->shadowFlags, i) && target->shadow[i] == target->eeprom[i]) {
+            srixFlagRemove(&target->blockFlags, i);
+        }
+    }
+
+    if (target->journal) {
+        SrixJournalEnd(target->journal, true);
+    }
+
+    /* Tag content changed */
+    if (plan->blocks) {
+        srixCacheStore(target);
+    }
+}
+
+/**
+ * Get the libnfc context of a library context, initializing it on first use.
+ * @param context pointer to SrixContext, can be null
+ * @return null if there is an error or context is null, else libnfc context
+ */
+static nfc_context *srixContextLibnfc(SrixContext *context) {
+    if (context && !context->libnfc) {
+        nfc_init(&context->libnfc);
+    }
+
+    return context ? context->libnfc : (void *) 0;
+}
+
+/**
+ * Get the NFC reader of a Srix, creating it (and libnfc context) on first use.
+ * @param target pointer to Srix instance
+ * @return null if there is an error, else NfcReader pointer
+ */
+static NfcReader *srixReader(Srix *target) {
+    if (!target->reader) {
+        target->reader = NfcReaderNew(srixContextLibnfc(target->context));
+        if (target->reader) {
+            NfcSetRetryPolicy(target->reader, target->retryPolicy);
+            NfcSetLinkBaudRate(target->reader, target->linkBaudRate);
+            NfcSetTrace(target->reader, target->trace);
+            NfcSetDeadline(target->reader, target->deadline, target->cancel);
+        }
+    }
+
+    return target->reader;
+}
+
+SrixContext *SrixContextNew() {
+    SrixContext *created = malloc(sizeof(SrixContext));
+    if (!created) {
+        return (void *) 0;
+    }
+
+    created->libnfc = (void *) 0;
+    return created;
+}
+
+void SrixContextDelete(SrixContext context[static 1]) {
+    if (context->libnfc) {
+        nfc_exit(context->libnfc);
+    }
+    free(context);
+}
+
+Srix *SrixNew(SrixContext *context) {
     Srix *created = malloc(sizeof(Srix));
     if (!created) {
         return (void *) 0;
     }
 
-    created->reader = NfcReaderNew();
+    created->blockFlags = SRIX_FLAG_INIT;
+    created->shadowFlags = SRIX_FLAG_INIT;
+    created->loadedFlags = SRIX_FLAG_INIT;
+    created->writtenFlags = SRIX_FLAG_INIT;
+    created->lazy = false;
+    created->cache = (void *) 0;
+    created->cacheSamples = 0;
+    created->journal = (void *) 0;
+    created->uidFilter = (void *) 0;
+    created->uidFilterData = (void *) 0;
+    created->verifyMode = SRIX_VERIFY_BLOCK;
+    created->reader = (void *) 0;
+    created->retryPolicy = NFC_RETRY_POLICY_DEFAULT;
+    created->linkBaudRate = 0;
+    created->trace = (void *) 0;
+    created->context = context;
+    created->deadline = 0;
+    created->cancel = (void *) 0;
+    created->tagTimeout = 0;
     created->error = SRIX_NO_ERROR;
     created->error.message = "";
 
@@ -115,57 +528,296 @@ Srix *SrixNew() {
 }
 
 void SrixDelete(Srix target[static 1]) {
-    NfcCloseReader(target->reader);
-    free(target->reader);
+    if (target->reader) {
+        NfcCloseReader(target->reader);
+        free(target->reader);
+    }
     free(target);
 }
 
 size_t NfcGetReadersCount(Srix target[static 1]) {
-    return NfcUpdateReaders(target->reader);
+    NfcReader *reader = srixReader(target);
+    return reader ? NfcUpdateReaders(reader) : 0;
 }
 
 char *NfcGetDescription(Srix *target, int reader) {
-    return NfcGetReaderDescription(target->reader, reader);
+    return NfcGetReaderDescription(srixReader(target), reader);
+}
+
+void SrixSetRetryPolicy(Srix target[static 1], uint8_t maxAttempts, uint32_t backoffMicros) {
+    target->retryPolicy.maxAttempts = maxAttempts;
+    target->retryPolicy.backoffMicros = backoffMicros;
+
+    if (target->reader) {
+        NfcSetRetryPolicy(target->reader, target->retryPolicy);
+    }
+}
+
+void SrixSetLinkBaudRate(Srix target[static 1], uint32_t baudRate) {
+    target->linkBaudRate = baudRate;
+
+    if (target->reader) {
+        NfcSetLinkBaudRate(target->reader, baudRate);
+    }
 }
 
-const char *SrixGetLatestError(Srix target[static 1]) {
-    const char *message = target->error.message;
+uint32_t SrixNfcGetLinkBaudRate(Srix target[static 1]) {
+    return target->reader ? NfcGetLinkBaudRate(target->reader) : 0;
+}
+
+SrixError SrixGetLatestError(Srix target[static 1]) {
+    SrixError error = target->error;
 
     /* Reset error */
     target->error = SRIX_NO_ERROR;
     target->error.message = "";
 
-    return message;
+    return error;
+}
+
+const char *SrixNfcOpen(Srix target[static 1], int reader) {
+    if (!srixReader(target)) {
+        target->error = SRIX_ERROR(SRIX_ERROR, "unable to allocate nfc reader");
+        return target->error.message;
+    }
+    NfcCloseReader(target->reader);
+
+    target->error = NfcOpenReader(target->reader, reader);
+    return SRIX_IS_ERROR(target->error) ? target->error.message : (void *) 0;
+}
+
+const char *SrixNfcOpenTransport(Srix target[static 1], const NfcTransport *transport, void *context) {
+    if (!srixReader(target)) {
+        target->error = SRIX_ERROR(SRIX_ERROR, "unable to allocate nfc reader");
+        return target->error.message;
+    }
+
+    NfcOpenTransport(target->reader, transport, context);
+    return (void *) 0;
+}
+
+const char *SrixNfcRecord(Srix target[static 1], const char *filename) {
+    if (!target->reader) {
+        target->error = SRIX_ERROR(NFC_ERROR, "nfc reader hasn't been opened");
+        return target->error.message;
+    }
+
+    target->error = NfcRecordSession(target->reader, filename);
+    return SRIX_IS_ERROR(target->error) ? target->error.message : (void *) 0;
 }
 
 const char *SrixNfcInit(Srix target[static 1], int reader) {
+    const char *error = SrixNfcOpen(target, reader);
+    if (error) {
+        return error;
+    }
+
+    /* Wait for a SRIX4K */
+    return SrixNfcNextTag(target, true);
+}
+
+/**
+ * Forget the tag previously loaded in a Srix.
+ * @param target pointer to Srix instance
+ */
+static void srixTagReset(Srix *target) {
     target->blockFlags = SRIX_FLAG_INIT;
-    NfcCloseReader(target->reader);
-    NfcInitReader(target->reader, reader);
+    target->shadowFlags = SRIX_FLAG_INIT;
+    target->loadedFlags = SRIX_FLAG_INIT;
+    target->writtenFlags = SRIX_FLAG_INIT;
+}
 
+/**
+ * Load UID and EEPROM of the tag selected by the reader.
+ * @param target pointer to Srix instance
+ * @return null if there is no error, else string error result
+ */
+static const char *srixTagLoad(Srix *target) {
     /* Get SRIX4K UID & EEPROM */
-    SrixError error = getUid(target);
-    if (SRIX_IS_ERROR(error)) {
-        SrixDelete(target);
-        return error.message;
+    target->error = getUid(target);
+    if (SRIX_IS_ERROR(target->error)) {
+        return target->error.message;
     }
 
-    error = readBlocks(target);
-    if (SRIX_IS_ERROR(error)) {
-        SrixDelete(target);
+    /* Rejected tags are dropped before reading any block */
+    if (target->uidFilter && !target->uidFilter(target->uid, target->uidFilterData)) {
+        target->error = SRIX_ERROR(SRIX_DENIED, "tag UID has been rejected");
+        return target->error.message;
+    }
+
+    /* Blocks already written by an interrupted write */
+    bool journaled = srixJournalLoad(target);
+
+    /* Non volatile blocks of a known tag, the cache entry of an interrupted write is older than the tag content */
+    if (journaled && target->cache) {
+        SrixCacheRemove(target->cache, target->uid);
+    }
+    bool cached = !journaled && srixCacheLoad(target);
+
+    /* With lazy initialization blocks are read on first access */
+    if (target->lazy) {
+        return (void *) 0;
+    }
+
+    target->error = readBlocks(target, 0, SRIX4K_BLOCKS);
+    if (SRIX_IS_ERROR(target->error)) {
+        return target->error.message;
     }
 
-    return error.message;
+    if (!cached) {
+        srixCacheStore(target);
+    }
+
+    return (void *) 0;
+}
+
+const char *SrixNfcNextTag(Srix target[static 1], bool wait) {
+    srixTagReset(target);
+
+    if (!target->reader) {
+        target->error = SRIX_ERROR(SRIX_ERROR, "nfc reader hasn't been opened");
+        return target->error.message;
+    }
+
+    /* Waiting for the tag doesn't use the time of the tag */
+    if (target->tagTimeout) {
+        SrixSetDeadline(target, 0, target->cancel);
+    }
+
+    NfcResetStats(target->reader);
+    target->error = NfcSelectTag(target->reader, wait);
+    if (SRIX_IS_ERROR(target->error)) {
+        return target->error.message;
+    }
+
+    if (target->tagTimeout) {
+        SrixSetDeadline(target, target->tagTimeout, target->cancel);
+    }
+
+    return srixTagLoad(target);
+}
+
+const char *SrixNfcInventory(Srix target[static 1], NfcInventory inventory[static 1]) {
+    if (!target->reader) {
+        target->error = SRIX_ERROR(SRIX_ERROR, "nfc reader hasn't been opened");
+        return target->error.message;
+    }
+
+    target->error = NfcInventoryTags(target->reader, inventory);
+    return SRIX_IS_ERROR(target->error) ? target->error.message : (void *) 0;
+}
+
+const char *SrixNfcSelectChip(Srix target[static 1], uint8_t chipId) {
+    srixTagReset(target);
+
+    if (!target->reader) {
+        target->error = SRIX_ERROR(SRIX_ERROR, "nfc reader hasn't been opened");
+        return target->error.message;
+    }
+
+    NfcResetStats(target->reader);
+    target->error = NfcSelectChip(target->reader, chipId);
+    if (SRIX_IS_ERROR(target->error)) {
+        return target->error.message;
+    }
+
+    return srixTagLoad(target);
+}
+
+bool SrixNfcTagIsPresent(Srix target[static 1]) {
+    return target->reader && NfcTagIsPresent(target->reader);
+}
+
+void SrixSetTrace(Srix target[static 1], NfcTrace *trace) {
+    target->trace = trace;
+
+    if (target->reader) {
+        NfcSetTrace(target->reader, trace);
+    }
+}
+
+void SrixSetDeadline(Srix target[static 1], uint32_t timeoutMillis, NfcCancel *cancel) {
+    target->deadline = timeoutMillis ? NfcTraceNow() + (uint64_t) timeoutMillis * 1000000 : 0;
+    target->cancel = cancel;
+
+    if (target->reader) {
+        NfcSetDeadline(target->reader, target->deadline, cancel);
+    }
+}
+
+void SrixSetTagTimeout(Srix target[static 1], uint32_t timeoutMillis) {
+    target->tagTimeout = timeoutMillis;
+}
+
+SrixProgress SrixGetProgress(Srix target[static 1]) {
+    SrixProgress progress = {
+            .loadedCount = srixFlagCount(&target->loadedFlags),
+            .writtenCount = srixFlagCount(&target->writtenFlags),
+            .pendingCount = SrixGetDirtyBlocks(target)
+    };
+    memcpy(progress.loaded, target->loadedFlags.memory, sizeof(progress.loaded));
+    memcpy(progress.written, target->writtenFlags.memory, sizeof(progress.written));
+
+    return progress;
 }
 
-void SrixMemoryInit(Srix target[static 1], uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid) {
+void SrixSetCache(Srix target[static 1], SrixCache *cache, uint8_t verifySamples) {
+    target->cache = cache;
+    target->cacheSamples = verifySamples;
+}
+
+void SrixSetJournal(Srix target[static 1], SrixJournal *journal) {
+    target->journal = journal;
+}
+
+bool SrixResumeWrite(Srix target[static 1]) {
+    SrixJournalRecord record;
+    if (!target->journal || !SrixJournalLoad(target->journal, target->uid, &record)) {
+        return false;
+    }
+
+    /* Confirmed blocks have been loaded with the tag, so they aren't written again */
+    SrixFlag planned = {{record.planned[0], record.planned[1], record.planned[2], record.planned[3]}};
+    for (uint8_t i = srixFlagNext(&planned, 0); i < SRIX4K_BLOCKS; i = srixFlagNext(&planned, i + 1)) {
+        SrixModifyBlock(target, record.values[i], i);
+    }
+
+    return true;
+}
+
+void SrixSetUidFilter(Srix target[static 1], SrixUidFilter filter, void *data) {
+    target->uidFilter = filter;
+    target->uidFilterData = data;
+}
+
+void SrixSetLazy(Srix target[static 1], bool lazy) {
+    target->lazy = lazy;
+}
+
+bool SrixGetLazy(Srix target[static 1]) {
+    return target->lazy;
+}
+
+void SrixSetVerifyMode(Srix target[static 1], SrixVerifyMode mode) {
+    target->verifyMode = mode;
+}
+
+uint32_t SrixGetRoundTrips(Srix target[static 1]) {
+    if (!target->reader) {
+        return 0;
+    }
+
+    NfcReaderStats stats = NfcGetStats(target->reader);
+    return NfcStatsRoundTrips(&stats);
+}
+
+void SrixMemoryInit(Srix target[static 1], const uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid) {
     /* Copy all blocks */
     memcpy(target->eeprom, eeprom, SRIX4K_BLOCKS * SRIX_BLOCK_LENGTH);
+    srixFlagAddRange(&target->loadedFlags, 0, SRIX4K_BLOCKS);
 
     /* Flag all generic blocks */
-    for (uint8_t i = 16; i < 128; i++) {
-        srixFlagAdd(&target->blockFlags, i);
-    }
+    srixFlagAddRange(&target->blockFlags, 16, SRIX4K_BLOCKS - 16);
 
     target->uid = uid;
 }
@@ -175,44 +827,189 @@ uint64_t SrixGetUid(Srix target[static 1]) {
 }
 
 uint32_t *SrixGetBlock(Srix target[static 1], uint8_t blockNum) {
-    return (blockNum < SRIX4K_BLOCKS) ? (target->eeprom + blockNum) : 0;
+    if (blockNum >= SRIX4K_BLOCKS) {
+        return 0;
+    }
+
+    /* Fetch block from tag on first access */
+    if (!srixFlagGet(&target->loadedFlags, blockNum)) {
+        target->error = readBlocks(target, blockNum, 1);
+        if (SRIX_IS_ERROR(target->error)) {
+            return 0;
+        }
+    }
+
+    return target->eeprom + blockNum;
+}
+
+int SrixPrefetchBlocks(Srix target[static 1], uint8_t first, uint8_t count) {
+    target->error = readBlocks(target, first, count);
+    return target->error.errorType;
+}
+
+uint8_t SrixGetDirtyBlocks(Srix target[static 1]) {
+    SrixFlag dirty = srixDirtyFlags(target);
+    return srixFlagCount(&dirty);
 }
 
 void SrixModifyBlock(Srix target[static 1], const uint32_t block, const uint8_t blockNum) {
     target->eeprom[blockNum] = block;
+    srixFlagAdd(&target->loadedFlags, blockNum);
     srixFlagAdd(&target->blockFlags, blockNum);
 }
 
+int SrixResetOtp(Srix target[static 1]) {
+    /* Read OTP and counter blocks */
+    target->error = readBlocks(target, 0, SRIX_VOLATILE_BLOCKS);
+    if (SRIX_IS_ERROR(target->error)) {
+        return target->error.errorType;
+    }
+
+    /* If at least one OTP block is different than 0xFFFFFFFF, reset OTP */
+    bool toReset = false;
+    for (int i = 0; i < 5; i++) {
+        if (target->otp[i] != 0xFFFFFFFF) {
+            toReset = true;
+        }
+    }
+
+    if (toReset) {
+        /* Decrease block 6 */
+        uint32_t block6old = target->counter[1];
+        uint32_t block6 =
+                (block6old << 24) | ((block6old & 0x0C) << 8) | ((block6old & 0x30) >> 8) | (block6old >> 24);
+
+        uint32_t toDecrease = 0x00200000;
+        if (block6 < toDecrease) {
+            target->error = SRIX_ERROR(SRIX_ERROR, "unable to decrease block 6 counter");
+            return target->error.errorType;
+        } else {
+            /* If result will be higher than 0, subtract. */
+            block6 -= toDecrease;
+        }
+
+        block6 = (block6 << 24) | ((block6 & 0x0C) << 8) | ((block6 & 0x30) >> 8) | (block6 >> 24);
+
+        SrixModifyBlock(target, block6, 0x06);
+        for (uint8_t i = 0x00; i <= 0x04; i++) {
+            SrixModifyBlock(target, 0xFFFFFFFF, i);
+        }
+    }
+
+    return SRIX_NO_ERROR.errorType;
+}
+
+void SrixCompileWritePlan(Srix target[static 1], SrixWritePlan plan[static 1]) {
+    /* Sections in write order, counter and OTP blocks are always verified one by one */
+    static const struct {
+        uint8_t first;
+        uint8_t count;
+        bool ordered;
+    } sections[] = {
+            {5, 2, true},     /* counter */
+            {0, 5, true},     /* OTP */
+            {7, 9, false},    /* lockable */
+            {16, 112, false}  /* generic */
+    };
+
+    SrixFlag dirty = srixDirtyFlags(target);
+    uint8_t unchecked = 0;
+
+    plan->count = 0;
+    plan->blocks = srixFlagCount(&dirty);
+    plan->roundTrips = 0;
+
+    for (size_t i = 0; i < sizeof(sections) / sizeof(sections[0]); i++) {
+        const uint8_t end = sections[i].first + sections[i].count;
+        const bool checked = sections[i].ordered || target->verifyMode == SRIX_VERIFY_BLOCK;
+
+        for (uint8_t block = srixFlagNext(&dirty, sections[i].first); block < end;
+             block = srixFlagNext(&dirty, block + 1)) {
+            /* A checked write is followed by its read-back */
+            srixPlanAdd(plan, (SrixWriteStep) {
+                    .type = checked ? SRIX_STEP_WRITE : SRIX_STEP_WRITE_UNCHECKED,
+                    .block = block,
+                    .value = target->eeprom[block],
+                    .roundTrips = checked ? 2 : 1
+            });
+            unchecked += !checked;
+        }
+
+        if (target->verifyMode == SRIX_VERIFY_FULL) {
+            srixPlanVerify(plan, &unchecked, 1);
+        } else if (target->verifyMode == SRIX_VERIFY_SAMPLED) {
+            srixPlanVerify(plan, &unchecked, SRIX_VERIFY_SAMPLE_STEP);
+        }
+    }
+
+    /* Final verification pass */
+    srixPlanVerify(plan, &unchecked, 1);
+}
+
 int SrixWriteBlocks(Srix target[static 1]) {
     if (!target->reader) {
         target->error = SRIX_ERROR(SRIX_ERROR, "NFC reader hasn't been initialized");
         return target->error.errorType;
     }
 
-    /* Counter blocks */
-    target->error = srixWriteGroup(target, target->counter, sizeof(target->counter) / sizeof(uint32_t));
-    if (SRIX_IS_ERROR(target->error)) {
-        return target->error.errorType;
+    SrixWritePlan plan;
+    SrixCompileWritePlan(target, &plan);
+    target->writtenFlags = SRIX_FLAG_INIT;
+
+    /* Nothing to write, an unfinished write is already complete on the tag */
+    if (plan.count == 0) {
+        if (target->journal) {
+            SrixJournalRemove(target->journal, target->uid);
+        }
+        srixPlanDone(target, &plan);
+        return SRIX_NO_ERROR.errorType;
     }
 
-    /* OTP blocks */
-    target->error = srixWriteGroup(target, target->otp, sizeof(target->otp) / sizeof(uint32_t));
+    target->error = srixJournalBegin(target, &plan);
     if (SRIX_IS_ERROR(target->error)) {
         return target->error.errorType;
     }
 
-    /* Lockable blocks */
-    target->error = srixWriteGroup(target, target->lockable, sizeof(target->lockable) / sizeof(uint32_t));
-    if (SRIX_IS_ERROR(target->error)) {
+    for (uint8_t i = 0; i < plan.count; i++) {
+        target->error = srixExecuteStep(target, &plan, i);
+        if (SRIX_IS_ERROR(target->error)) {
+            /* Journal keeps the write, to resume it when the tag is presented again */
+            if (target->journal) {
+                SrixJournalEnd(target->journal, false);
+            }
+            return target->error.errorType;
+        }
+    }
+
+    srixPlanDone(target, &plan);
+    return SRIX_NO_ERROR.errorType;
+}
+
+int SrixExecuteWriteStep(Srix target[static 1], const SrixWritePlan plan[static 1], uint8_t step) {
+    if (!target->reader) {
+        target->error = SRIX_ERROR(SRIX_ERROR, "NFC reader hasn't been initialized");
+        return target->error.errorType;
+    } else if (step >= plan->count) {
+        target->error = SRIX_ERROR(SRIX_ERROR, "write plan step is out of range");
         return target->error.errorType;
     }
 
-    /* Generic blocks */
-    target->error = srixWriteGroup(target, target->generic, sizeof(target->generic) / sizeof(uint32_t));
+    if (step == 0) {
+        target->writtenFlags = SRIX_FLAG_INIT;
+
+        target->error = srixJournalBegin(target, plan);
+        if (SRIX_IS_ERROR(target->error)) {
+            return target->error.errorType;
+        }
+    }
+
+    target->error = srixExecuteStep(target, plan, step);
     if (SRIX_IS_ERROR(target->error)) {
         return target->error.errorType;
     }
 
-    target->blockFlags = SRIX_FLAG_INIT;
+    if (step + 1 == plan->count) {
+        srixPlanDone(target, plan);
+    }
     return SRIX_NO_ERROR.errorType;
-}
\ No newline at end of file
+}
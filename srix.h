@@ -1,17 +1,103 @@
 #ifndef SRIX_H
 #define SRIX_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include "error.h"
 
 typedef struct Srix Srix;
+typedef struct SrixContext SrixContext;
+typedef struct SrixCache SrixCache;
+typedef struct SrixJournal SrixJournal;
+typedef struct NfcTrace NfcTrace;
+typedef struct NfcTransport NfcTransport;
+typedef struct NfcCancel NfcCancel;
+typedef struct NfcInventory NfcInventory;
+
+/**
+ * Function called with the UID of every tag, before any of its blocks is read.
+ * @param uid UID of tag
+ * @param data user data passed to SrixSetUidFilter
+ * @return false to reject the tag, selection fails with SRIX_DENIED
+ */
+typedef bool (*SrixUidFilter)(uint64_t uid, void *data);
+
+/**
+ * Verification of blocks written by SrixWriteBlocks.
+ * Counter and OTP blocks are always read back one by one, because their write order matters.
+ */
+typedef enum {
+    SRIX_VERIFY_BLOCK,   /* read back every block right after writing it (default) */
+    SRIX_VERIFY_FULL,    /* write a whole section, then read back all its written blocks */
+    SRIX_VERIFY_SAMPLED, /* write a whole section, then read back a sample of them (all if one is wrong) */
+    SRIX_VERIFY_FINAL    /* write all sections, then read back every written block in a single pass */
+} SrixVerifyMode;
+
+/**
+ * Operation of a write plan step.
+ */
+typedef enum {
+    SRIX_STEP_WRITE,           /* write a block and read it back */
+    SRIX_STEP_WRITE_UNCHECKED, /* write a block without reading it back */
+    SRIX_STEP_VERIFY           /* read back blocks written without check since the previous verify step */
+} SrixWriteStepType;
+
+/**
+ * Single step of a write plan.
+ */
+typedef struct SrixWriteStep {
+    SrixWriteStepType type;    /* operation */
+    uint8_t block;             /* block to write, number of blocks to read back with SRIX_STEP_VERIFY */
+    uint8_t sampleStep;        /* SRIX_STEP_VERIFY distance between read back blocks, 1 = all */
+    uint32_t value;            /* value to write */
+    uint16_t roundTrips;       /* estimated radio round trips, without retries */
+} SrixWriteStep;
+
+/**
+ * Ordered operations done by SrixWriteBlocks.
+ * Counter, OTP, lockable and generic blocks are written in this order, every block at most once.
+ */
+typedef struct SrixWritePlan {
+    SrixWriteStep steps[SRIX4K_BLOCKS + 3];   /* a step for every block, plus at most 3 verify steps */
+    uint8_t count;                            /* number of steps */
+    uint8_t blocks;                           /* number of blocks to write */
+    uint32_t roundTrips;                      /* estimated radio round trips, without retries */
+} SrixWritePlan;
+
+/**
+ * Progress of the NFC operations of a Srix, to know what has been done by an interrupted operation.
+ * Bitmaps have a bit for every block: bit (block % 32) of word (block / 32).
+ */
+typedef struct SrixProgress {
+    uint32_t loaded[4];        /* blocks with a valid value, read from the tag, cache or memory */
+    uint32_t written[4];       /* blocks written on the tag by the last write */
+    uint8_t loadedCount;       /* number of loaded blocks */
+    uint8_t writtenCount;      /* number of written blocks */
+    uint8_t pendingCount;      /* modified blocks still to write */
+} SrixProgress;
+
+/**
+ * Create a new library context, that owns the libnfc context used by the NFC readers of its Srix.
+ * There is no global state: different contexts, with their Srix, can be used by different threads at the same time.
+ * A Srix (and the reader search of a context) has to be used by a single thread at a time.
+ * @return null if there is an error, else a SrixContext pointer
+ */
+SrixContext *SrixContextNew();
+
+/**
+ * Delete a library context, after all its Srix have been deleted.
+ * @param context pointer to SrixContext
+ */
+void SrixContextDelete(SrixContext *context);
 
 /**
  * Create a new Srix and set its default values.
+ * @param context library context used to search and open NFC readers,
+ *                null if the Srix never uses libnfc readers (e.g. dump files or custom transports)
  * @return null if there is an error, else a Srix struct pointer
  */
-Srix *SrixNew();
+Srix *SrixNew(SrixContext *context);
 
 /**
  * Delete a Srix and free its memory.
@@ -38,17 +124,200 @@ char *NfcGetDescription(Srix *target, int reader);
  * Initialize the Srix using Nfc.
  * @param target pointer to Srix struct
  * @param reader index of nfc reader to use
- * @return string error result
+ * @return null if there is no error, else string error result
  */
 const char *SrixNfcInit(Srix *target, int reader);
 
+/**
+ * Open a nfc reader without waiting for a tag.
+ * @param target pointer to Srix struct
+ * @param reader index of nfc reader to use
+ * @return null if there is no error, else string error result
+ */
+const char *SrixNfcOpen(Srix *target, int reader);
+
+/**
+ * Open a reader that uses a custom transport (e.g. an emulated tag) without waiting for a tag.
+ * @param target pointer to Srix struct
+ * @param transport transport functions
+ * @param context context passed to transport functions
+ * @return null if there is no error, else string error result
+ */
+const char *SrixNfcOpenTransport(Srix *target, const NfcTransport *transport, void *context);
+
+/**
+ * Record every operation of the open reader in a session file, saved when the reader is closed.
+ * @param target pointer to Srix struct
+ * @param filename name of session file
+ * @return null if there is no error, else string error result
+ */
+const char *SrixNfcRecord(Srix *target, const char *filename);
+
+/**
+ * Read the next SRIX4K tag using the reader already opened by SrixNfcOpen or SrixNfcInit.
+ * @param target pointer to Srix struct
+ * @param wait true to wait until a tag is in the field, false to fail if there isn't one
+ * @return null if there is no error, else string error result
+ */
+const char *SrixNfcNextTag(Srix *target, bool wait);
+
+/**
+ * Find all SRIX4K tags in the field of the open reader, with the Chip_ID anticollision.
+ * @param target pointer to Srix struct
+ * @param inventory pointer where save the Chip_ID of found tags
+ * @return null if there is no error, else string error result
+ */
+const char *SrixNfcInventory(Srix *target, NfcInventory *inventory);
+
+/**
+ * Select a tag found by SrixNfcInventory and read it, like SrixNfcNextTag.
+ * @param target pointer to Srix struct
+ * @param chipId Chip_ID of tag
+ * @return null if there is no error, else string error result
+ */
+const char *SrixNfcSelectChip(Srix *target, uint8_t chipId);
+
+/**
+ * Check if the last read tag is still in the reader field.
+ * @param target pointer to Srix struct
+ * @return true if the tag is present
+ */
+bool SrixNfcTagIsPresent(Srix *target);
+
+/**
+ * Set how many times a block read or write is tried before giving up.
+ * @param target pointer to Srix struct
+ * @param maxAttempts maximum attempts for every block
+ * @param backoffMicros delay after first failed attempt, doubled at every retry
+ */
+void SrixSetRetryPolicy(Srix *target, uint8_t maxAttempts, uint32_t backoffMicros);
+
+/**
+ * Request a faster serial link for pn532_uart readers, negotiated when the reader is opened.
+ * @param target pointer to Srix struct
+ * @param baudRate baud rate up to PN532_UART_MAX_BAUD_RATE, 0 to keep the connstring rate
+ */
+void SrixSetLinkBaudRate(Srix *target, uint32_t baudRate);
+
+/**
+ * Get the baud rate of the serial link of the open nfc reader.
+ * @param target pointer to Srix struct
+ * @return baud rate, 0 if the link hasn't been negotiated (not a pn532_uart reader, or it doesn't answer)
+ */
+uint32_t SrixNfcGetLinkBaudRate(Srix *target);
+
+/**
+ * Record every radio operation of the NFC reader in a trace.
+ * @param target pointer to Srix struct
+ * @param trace pointer to trace, null to disable tracing
+ */
+void SrixSetTrace(Srix *target, NfcTrace *trace);
+
+/**
+ * Use a dump cache for tags already seen.
+ * On a cache hit only OTP and counter blocks are read from the tag, with a sample of cached blocks to
+ * detect stale entries. Every tag fully read (or written) is saved in cache.
+ * @param target pointer to Srix struct
+ * @param cache pointer to cache, null to disable it
+ * @param verifySamples number of random cached blocks to verify on the tag at every hit
+ */
+void SrixSetCache(Srix *target, SrixCache *cache, uint8_t verifySamples);
+
+/**
+ * Use a write journal, so a write interrupted by a tag leaving the field can be resumed.
+ * Every write records its planned blocks before starting and every block confirmed by read-back.
+ * When a tag with an unfinished write is read again its confirmed blocks are taken from the journal,
+ * unconfirmed ones are read from the tag to know which writes landed.
+ * @param target pointer to Srix struct
+ * @param journal pointer to journal, null to disable it
+ */
+void SrixSetJournal(Srix *target, SrixJournal *journal);
+
+/**
+ * Restore the unfinished write of the current tag from the journal, as modified blocks.
+ * The following SrixWriteBlocks writes only the blocks that haven't been confirmed.
+ * @param target pointer to Srix struct with a tag read after the journal has been set
+ * @return true if an unfinished write has been restored
+ */
+bool SrixResumeWrite(Srix *target);
+
+/**
+ * Check the UID of every selected tag, e.g. against an allow list, right after the UID exchange.
+ * @param target pointer to Srix struct
+ * @param filter function called with every UID, null to accept all tags
+ * @param data user data passed to filter
+ */
+void SrixSetUidFilter(Srix *target, SrixUidFilter filter, void *data);
+
+/**
+ * Enable or disable lazy initialization.
+ * When enabled, SrixNfcInit and SrixNfcNextTag only read the UID and blocks are read on first access.
+ * @param target pointer to Srix struct
+ * @param lazy true to enable lazy initialization
+ */
+void SrixSetLazy(Srix *target, bool lazy);
+
+/**
+ * Check if lazy initialization is enabled.
+ * @param target pointer to Srix struct
+ * @return true if blocks are read on first access
+ */
+bool SrixGetLazy(Srix *target);
+
+/**
+ * Set how SrixWriteBlocks verifies lockable and generic blocks.
+ * @param target pointer to Srix struct
+ * @param mode verification mode
+ */
+void SrixSetVerifyMode(Srix *target, SrixVerifyMode mode);
+
+/**
+ * Bound the next NFC operations (tag selection, block reads and writes) of a Srix.
+ * When the deadline expires they stop with SRIX_TIMEOUT, when the cancel handle is triggered
+ * (from any thread) they stop with SRIX_CANCELLED; SrixGetProgress reports what has been done.
+ * @param target pointer to Srix struct
+ * @param timeoutMillis time from now available to all next operations, 0 for no deadline
+ * @param cancel pointer to cancel handle, null for no cancellation
+ */
+void SrixSetDeadline(Srix *target, uint32_t timeoutMillis, NfcCancel *cancel);
+
+/**
+ * Bound the NFC operations on every tag selected by SrixNfcNextTag, from its selection.
+ * Waiting for a tag isn't bounded, the deadline of SrixSetDeadline is replaced at every selection.
+ * @param target pointer to Srix struct
+ * @param timeoutMillis time available to every tag after its selection, 0 for no limit
+ */
+void SrixSetTagTimeout(Srix *target, uint32_t timeoutMillis);
+
+/**
+ * Get the progress of the NFC operations of a Srix.
+ * @param target pointer to Srix struct
+ * @return copy of progress
+ */
+SrixProgress SrixGetProgress(Srix *target);
+
+/**
+ * Get latest error of a Srix and reset it.
+ * @param target pointer to Srix struct
+ * @return latest error, including its description and used attempts
+ */
+SrixError SrixGetLatestError(Srix *target);
+
+/**
+ * Return the number of radio round trips done since the last NFC initialization.
+ * @param target pointer to Srix struct
+ * @return round trips count (commands, presence checks and tag selections)
+ */
+uint32_t SrixGetRoundTrips(Srix *target);
+
 /**
  * Initialize the Srix using values in memory.
+ * Content previously read from a tag is kept as reference, so only changed blocks will be written.
  * @param target pointer to Srix struct
  * @param eeprom pointer to EEPROM array to import
  * @param uid UID to import
  */
-void SrixMemoryInit(Srix *target, uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid);
+void SrixMemoryInit(Srix *target, const uint32_t eeprom[const static SRIX4K_BLOCKS], uint64_t uid);
 
 /**
  * Return UID of an initialized srix.
@@ -59,12 +328,23 @@ uint64_t SrixGetUid(Srix *target);
 
 /**
  * Get pointer to a specified block.
+ * With lazy initialization, a block not loaded yet is read from the tag.
  * @param target pointer to Srix struct
  * @param blockNum number of block to get
- * @return pointer to blockNum block
+ * @return pointer to blockNum block, null if it's out of range or it can't be read
  */
 uint32_t *SrixGetBlock(Srix *target, uint8_t blockNum);
 
+/**
+ * Read from the tag a range of blocks that haven't been loaded yet.
+ * Useful with lazy initialization, when the needed blocks are known in advance.
+ * @param target pointer to Srix struct
+ * @param first first block of the range
+ * @param count number of blocks of the range
+ * @return numeric result, 0 = no error
+ */
+int SrixPrefetchBlocks(Srix *target, uint8_t first, uint8_t count);
+
 /**
  * Modify manually a Srix block and add flag automatically.
  * @param target pointer to Srix struct
@@ -73,11 +353,46 @@ uint32_t *SrixGetBlock(Srix *target, uint8_t blockNum);
  */
 void SrixModifyBlock(Srix *target, uint32_t block, uint8_t blockNum);
 
+/**
+ * Reset OTP blocks (0x00-0x04) to 0xFFFFFFFF if they are used, decreasing the block 6 counter.
+ * @param target pointer to Srix struct
+ * @return numeric result, 0 = no error
+ */
+int SrixResetOtp(Srix *target);
+
+/**
+ * Count blocks that SrixWriteBlocks would write.
+ * Modified blocks with the same value last read from the tag aren't counted.
+ * @param target pointer to Srix struct
+ * @return number of blocks to write
+ */
+uint8_t SrixGetDirtyBlocks(Srix *target);
+
+/**
+ * Compile the write plan that SrixWriteBlocks would execute, without writing anything.
+ * @param target pointer to Srix struct
+ * @param plan pointer where save the write plan
+ */
+void SrixCompileWritePlan(Srix *target, SrixWritePlan *plan);
+
 /**
  * Write all modified blocks of target to physical SRIX4K.
+ * Only blocks that differ from the content last read from the tag are written, following
+ * the plan of SrixCompileWritePlan.
  * @param target pointer to Srix struct
  * @return numeric result, 0 = no error
  */
 int SrixWriteBlocks(Srix *target);
 
+/**
+ * Execute a single step of a write plan, so a write can be interrupted between two steps.
+ * Steps have to be executed in order, after the last one modified blocks are reset like with SrixWriteBlocks.
+ * Blocks modified after the plan was compiled stay modified, the tag holds the values of the plan.
+ * @param target pointer to Srix struct
+ * @param plan pointer to write plan compiled by SrixCompileWritePlan
+ * @param step index of step to execute
+ * @return numeric result, 0 = no error
+ */
+int SrixExecuteWriteStep(Srix *target, const SrixWritePlan *plan, uint8_t step);
+
 #endif /* SRIX_H */
\ No newline at end of file
@@ -16,10 +16,65 @@ void srixFlagAdd(SrixFlag flag[static 1], uint8_t block) {
     }
 }
 
+void srixFlagRemove(SrixFlag flag[static 1], uint8_t block) {
+    if (block < 128) {
+        flag->memory[block / 32] &= ~(1U << block % 32);
+    }
+}
+
 bool srixFlagGet(SrixFlag flag[static 1], uint8_t block) {
     if (block < 128) {
         return flag->memory[block / 32] >> block % 32 & 1U;
     } else {
         return false;
     }
-}
\ No newline at end of file
+}
+
+/**
+ * Get the bits of a range of blocks that are in a single uint32_t.
+ * @param word index of uint32_t (0-3)
+ * @param first first block of range
+ * @param end block after the last one of range
+ * @return bit mask of range blocks in word
+ */
+static uint32_t srixFlagWordRange(uint8_t word, uint16_t first, uint16_t end) {
+    const uint16_t wordFirst = word * 32;
+    if (end <= wordFirst || first >= wordFirst + 32) {
+        return 0;
+    }
+
+    /* Range limits inside the uint32_t */
+    const uint8_t low = first > wordFirst ? first - wordFirst : 0;
+    const uint8_t high = end < wordFirst + 32 ? end - wordFirst : 32;
+
+    const uint32_t bits = high == 32 ? UINT32_MAX : (1U << high) - 1;
+    return bits & ~((1U << low) - 1);
+}
+
+void srixFlagAddRange(SrixFlag flag[static 1], uint8_t first, uint8_t count) {
+    uint16_t end = (uint16_t) first + count < 128 ? (uint16_t) first + count : 128;
+    for (uint8_t i = 0; i < 4; i++) {
+        flag->memory[i] |= srixFlagWordRange(i, first, end);
+    }
+}
+
+uint8_t srixFlagNext(SrixFlag flag[static 1], uint8_t from) {
+    for (uint8_t i = from / 32; i < 4; i++) {
+        /* Ignore blocks before from in its uint32_t */
+        uint32_t bits = i == from / 32 ? flag->memory[i] & ~((1U << from % 32) - 1) : flag->memory[i];
+        if (bits) {
+            return i * 32 + __builtin_ctz(bits);
+        }
+    }
+
+    return 128;
+}
+
+uint8_t srixFlagCount(SrixFlag flag[static 1]) {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        count += __builtin_popcount(flag->memory[i]);
+    }
+
+    return count;
+}
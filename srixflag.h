@@ -20,6 +20,13 @@ typedef struct SrixFlag {
  */
 void srixFlagAdd(SrixFlag *flag, uint8_t block);
 
+/**
+ * Set the flag value of a specified block to false (not modified).
+ * @param flag pointer to a SrixFlag instance
+ * @param block block to unflag (0-127)
+ */
+void srixFlagRemove(SrixFlag *flag, uint8_t block);
+
 /**
  * Get the flag value of a specified block.
  * @param flag pointer to a SrixFlag instance
@@ -28,4 +35,27 @@ void srixFlagAdd(SrixFlag *flag, uint8_t block);
  */
 bool srixFlagGet(SrixFlag *flag, uint8_t block);
 
+/**
+ * Set the flag value of a range of blocks to true (modified).
+ * @param flag pointer to a SrixFlag instance
+ * @param first first block of range (0-127)
+ * @param count number of blocks of range, blocks after 127 are ignored
+ */
+void srixFlagAddRange(SrixFlag *flag, uint8_t first, uint8_t count);
+
+/**
+ * Get the first flagged block starting from a specified block.
+ * @param flag pointer to a SrixFlag instance
+ * @param from first block to check (0-128)
+ * @return first flagged block, 128 if there isn't one
+ */
+uint8_t srixFlagNext(SrixFlag *flag, uint8_t from);
+
+/**
+ * Count the flagged blocks.
+ * @param flag pointer to a SrixFlag instance
+ * @return number of flagged blocks
+ */
+uint8_t srixFlagCount(SrixFlag *flag);
+
 #endif /* SRIX_FLAG_H */
\ No newline at end of file
@@ -0,0 +1,272 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "pn532.h"
+
+/* Behaviour of the emulated PN532 */
+typedef enum {
+    STAND_IN_ACCEPT,                  /* switches to the requested baud rate */
+    STAND_IN_REFUSE,                  /* never answers SetSerialBaudRate */
+    STAND_IN_SILENT                   /* never answers any command */
+} StandInMode;
+
+/**
+ * PN532 on the other side of a pseudo terminal, it only answers when the host uses its baud rate.
+ */
+typedef struct StandIn {
+    int master;                       /* pseudo terminal master, PN532 side */
+    int slave;                        /* slave kept open, so the master never reads EIO */
+    char port[64];                    /* slave path, host side */
+    StandInMode mode;                 /* behaviour of the PN532 */
+    speed_t speed;                    /* baud rate of the PN532 */
+    speed_t pending;                  /* baud rate used after the next ACK, 0 if there isn't a change */
+    uint8_t frame[512];               /* received bytes that aren't a complete frame yet */
+    size_t length;                    /* number of received bytes */
+    atomic_bool running;              /* false when the thread has to stop */
+    pthread_t thread;                 /* PN532 thread */
+} StandIn;
+
+static const speed_t standInSpeeds[] = {B9600, B19200, B38400, B57600, B115200, B230400, B460800, B921600};
+
+/**
+ * Get the baud rate set by the host on the slave.
+ * @param standIn pointer to StandIn
+ * @return termios speed
+ */
+static speed_t standInHostSpeed(const StandIn *standIn) {
+    struct termios options;
+    tcgetattr(standIn->master, &options);
+    return cfgetospeed(&options);
+}
+
+/**
+ * Send bytes to the host, they are lost if the two sides use a different baud rate.
+ * @param standIn pointer to StandIn
+ * @param data bytes to send
+ * @param length number of bytes
+ */
+static void standInSend(const StandIn *standIn, const uint8_t *data, size_t length) {
+    if (standInHostSpeed(standIn) == standIn->speed) {
+        (void) !write(standIn->master, data, length);
+    }
+}
+
+/**
+ * Send an ACK and a normal frame to the host.
+ * @param standIn pointer to StandIn
+ * @param data frame data, starting with the TFI
+ * @param length number of bytes of data
+ */
+static void standInAnswer(const StandIn *standIn, const uint8_t *data, uint8_t length) {
+    static const uint8_t ack[] = {0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00};
+    uint8_t frame[32] = {0x00, 0x00, 0xFF, length, (uint8_t) -length};
+    uint8_t checksum = 0;
+
+    for (uint8_t i = 0; i < length; i++) {
+        frame[5 + i] = data[i];
+        checksum += data[i];
+    }
+    frame[5 + length] = (uint8_t) -checksum;
+    frame[6 + length] = 0x00;
+
+    standInSend(standIn, ack, sizeof(ack));
+    standInSend(standIn, frame, length + 7);
+}
+
+/**
+ * Execute a command frame received from the host.
+ * @param standIn pointer to StandIn
+ * @param data frame data, starting with the TFI
+ * @param length number of bytes of data
+ */
+static void standInCommand(StandIn *standIn, const uint8_t *data, size_t length) {
+    if (standIn->mode == STAND_IN_SILENT || length < 2 || data[0] != 0xD4) {
+        return;
+    }
+
+    if (data[1] == 0x14) {
+        standInAnswer(standIn, (const uint8_t[]) {0xD5, 0x15}, 2);
+    } else if (data[1] == 0x10 && length == 3 && standIn->mode == STAND_IN_ACCEPT &&
+               data[2] < sizeof(standInSpeeds) / sizeof(standInSpeeds[0])) {
+        standInAnswer(standIn, (const uint8_t[]) {0xD5, 0x11}, 2);
+        standIn->pending = standInSpeeds[data[2]];
+    }
+}
+
+/**
+ * Parse the complete frames received from the host.
+ * @param standIn pointer to StandIn
+ */
+static void standInParse(StandIn *standIn) {
+    for (;;) {
+        size_t start = 0;
+        while (start + 1 < standIn->length &&
+               !(standIn->frame[start] == 0x00 && standIn->frame[start + 1] == 0xFF)) {
+            start++;
+        }
+
+        /* Drop wake up bytes and preambles */
+        memmove(standIn->frame, standIn->frame + start, standIn->length - start);
+        standIn->length -= start;
+        if (standIn->length < 4) {
+            return;
+        }
+
+        const uint8_t length = standIn->frame[2];
+        const uint8_t lengthChecksum = standIn->frame[3];
+        size_t used = 4;
+
+        if (length == 0x00 && lengthChecksum == 0xFF) {
+            /* ACK of the host, the PN532 moves to the new baud rate */
+            if (standIn->pending) {
+                standIn->speed = standIn->pending;
+                standIn->pending = 0;
+            }
+        } else if ((uint8_t) (length + lengthChecksum) != 0) {
+            used = 2;
+        } else if (standIn->length < (size_t) length + 6) {
+            return;
+        } else {
+            uint8_t checksum = standIn->frame[4 + length];
+            for (uint8_t i = 0; i < length; i++) {
+                checksum += standIn->frame[4 + i];
+            }
+
+            if (checksum == 0) {
+                standInCommand(standIn, standIn->frame + 4, length);
+            }
+            used = (size_t) length + 6;
+        }
+
+        memmove(standIn->frame, standIn->frame + used, standIn->length - used);
+        standIn->length -= used;
+    }
+}
+
+/**
+ * PN532 thread: receive the bytes sent by the host.
+ * @param arg pointer to StandIn
+ * @return null
+ */
+static void *standInRun(void *arg) {
+    StandIn *standIn = arg;
+
+    while (atomic_load(&standIn->running)) {
+        struct pollfd ready = {.fd = standIn->master, .events = POLLIN};
+        if (poll(&ready, 1, 10) <= 0) {
+            continue;
+        }
+
+        uint8_t buffer[256];
+        ssize_t received = read(standIn->master, buffer, sizeof(buffer));
+        if (received <= 0) {
+            continue;
+        }
+
+        /* Bytes sent at another baud rate are noise for the PN532 */
+        if (standInHostSpeed(standIn) != standIn->speed) {
+            standIn->length = 0;
+            continue;
+        }
+
+        size_t count = (size_t) received < sizeof(standIn->frame) - standIn->length ?
+                       (size_t) received : sizeof(standIn->frame) - standIn->length;
+        memcpy(standIn->frame + standIn->length, buffer, count);
+        standIn->length += count;
+        standInParse(standIn);
+    }
+
+    return (void *) 0;
+}
+
+/**
+ * Start a PN532 stand-in.
+ * @param standIn pointer to StandIn to initialize
+ * @param mode behaviour of the PN532
+ * @param speed initial baud rate of the PN532
+ * @return boolean result
+ */
+static bool standInStart(StandIn *standIn, StandInMode mode, speed_t speed) {
+    memset(standIn, 0, sizeof(StandIn));
+    standIn->mode = mode;
+    standIn->speed = speed;
+
+    standIn->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (standIn->master < 0 || grantpt(standIn->master) != 0 || unlockpt(standIn->master) != 0 ||
+        ptsname_r(standIn->master, standIn->port, sizeof(standIn->port)) != 0) {
+        return false;
+    }
+
+    standIn->slave = open(standIn->port, O_RDWR | O_NOCTTY);
+    struct termios options;
+    if (standIn->slave < 0 || tcgetattr(standIn->slave, &options) != 0) {
+        return false;
+    }
+    cfmakeraw(&options);
+    cfsetspeed(&options, B115200);
+    tcsetattr(standIn->slave, TCSANOW, &options);
+
+    atomic_init(&standIn->running, true);
+    return pthread_create(&standIn->thread, (void *) 0, standInRun, standIn) == 0;
+}
+
+/**
+ * Stop a PN532 stand-in.
+ * @param standIn pointer to StandIn
+ */
+static void standInStop(StandIn *standIn) {
+    atomic_store(&standIn->running, false);
+    pthread_join(standIn->thread, (void *) 0);
+    close(standIn->slave);
+    close(standIn->master);
+}
+
+/**
+ * Negotiate 921600 baud with a PN532 stand-in and check the result.
+ * @param name name of the case
+ * @param mode behaviour of the PN532
+ * @param speed initial baud rate of the PN532
+ * @param expectError true if the negotiation has to fail
+ * @param expectEffective expected baud rate of the link
+ * @param expectSpeed expected baud rate of the PN532 at the end
+ * @return true if the case passed
+ */
+static bool checkNegotiation(const char *name, StandInMode mode, speed_t speed, bool expectError,
+                             uint32_t expectEffective, speed_t expectSpeed) {
+    StandIn standIn;
+    if (!standInStart(&standIn, mode, speed)) {
+        fprintf(stderr, "%s: unable to start PN532 stand-in\n", name);
+        return false;
+    }
+
+    uint32_t effective;
+    SrixError error = NfcPn532Negotiate(standIn.port, PN532_UART_DEFAULT_BAUD_RATE, PN532_UART_MAX_BAUD_RATE,
+                                        &effective);
+    standInStop(&standIn);
+
+    bool passed = SRIX_IS_ERROR(error) == expectError && effective == expectEffective &&
+                  standIn.speed == expectSpeed;
+    printf("%s: %s (%s, link at %" PRIu32 " baud)\n", name, passed ? "passed" : "FAILED",
+           SRIX_IS_ERROR(error) ? error.message : "no error", effective);
+    return passed;
+}
+
+int main() {
+    bool passed = true;
+
+    passed &= checkNegotiation("accept", STAND_IN_ACCEPT, B115200, false, PN532_UART_MAX_BAUD_RATE, B921600);
+    passed &= checkNegotiation("refuse", STAND_IN_REFUSE, B115200, false, PN532_UART_DEFAULT_BAUD_RATE, B115200);
+    passed &= checkNegotiation("silent", STAND_IN_SILENT, B115200, true, PN532_UART_DEFAULT_BAUD_RATE, B115200);
+    passed &= checkNegotiation("already switched", STAND_IN_ACCEPT, B921600, false, PN532_UART_MAX_BAUD_RATE,
+                               B921600);
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,121 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reader.h"
+#include "trace.h"
+
+NfcTrace *NfcTraceNew(size_t capacity, uint32_t id, const char *name) {
+    NfcTrace *created = malloc(sizeof(NfcTrace));
+    if (!created) {
+        return (void *) 0;
+    }
+
+    created->events = malloc((capacity ? capacity : 1) * sizeof(NfcTraceEvent));
+    if (!created->events) {
+        free(created);
+        return (void *) 0;
+    }
+
+    created->count = 0;
+    created->capacity = capacity;
+    created->dropped = 0;
+    created->id = id;
+    snprintf(created->name, sizeof(created->name), "%s", name);
+
+    return created;
+}
+
+void NfcTraceDelete(NfcTrace trace[static 1]) {
+    free(trace->events);
+    free(trace);
+}
+
+/**
+ * Get the name of a traced event.
+ * @param event pointer to event
+ * @return event name
+ */
+static const char *nfcTraceEventName(const NfcTraceEvent *event) {
+    switch (event->kind) {
+        case NFC_TRACE_PRESENCE:
+            return "presence check";
+        case NFC_TRACE_SELECT:
+            return "select";
+        default:
+            break;
+    }
+
+    switch (event->command) {
+        case SRIX_GET_UID:
+            return "get uid";
+        case SRIX_READ_BLOCK:
+            return "read block";
+        case SRIX_WRITE_BLOCK:
+            return "write block";
+        default:
+            return "exchange";
+    }
+}
+
+/**
+ * Write a string to a JSON file, escaping quotes, backslashes and control characters.
+ * @param file JSON file
+ * @param string string to write, without quotes
+ */
+static void nfcTraceWriteString(FILE *file, const char *string) {
+    for (const unsigned char *c = (const unsigned char *) string; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(file, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+}
+
+SrixError NfcTraceExport(const char *filename, NfcTrace *const traces[], size_t count) {
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        return SRIX_ERROR(SRIX_ERROR, "unable to open trace file");
+    }
+
+    /* Timestamps are relative to the first event */
+    uint64_t origin = UINT64_MAX;
+    for (size_t i = 0; i < count; i++) {
+        if (traces[i]->count && traces[i]->events[0].startNanos < origin) {
+            origin = traces[i]->events[0].startNanos;
+        }
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    for (size_t i = 0; i < count; i++) {
+        const NfcTrace *trace = traces[i];
+
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%" PRIu32
+                      ",\"args\":{\"name\":\"", first ? "" : ",\n", trace->id);
+        nfcTraceWriteString(file, trace->name);
+        fprintf(file, "\",\"dropped\":%zu}}", trace->dropped);
+        first = false;
+
+        for (size_t j = 0; j < trace->count; j++) {
+            const NfcTraceEvent *event = &trace->events[j];
+            uint64_t start = event->startNanos - origin;
+
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%" PRIu64
+                          ".%03" PRIu64 ",\"dur\":%" PRIu64 ".%03" PRIu64 ",\"args\":{\"command\":%" PRIu8
+                          ",\"block\":%" PRIu8 ",\"response\":%" PRId16 ",\"attempt\":%" PRIu8 "}}",
+                    nfcTraceEventName(event), trace->id, start / 1000, start % 1000, event->durationNanos / 1000,
+                    event->durationNanos % 1000, event->command, event->block, event->response, event->attempt);
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0) {
+        return SRIX_ERROR(SRIX_ERROR, "unable to write trace file");
+    }
+
+    return SRIX_NO_ERROR;
+}
@@ -0,0 +1,97 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "error.h"
+
+#define NFC_TRACE_DEFAULT_EVENTS  (1U << 20)
+
+/**
+ * Radio operation recorded by a trace.
+ */
+typedef enum {
+    NFC_TRACE_EXCHANGE,       /* command sent to the tag */
+    NFC_TRACE_PRESENCE,       /* tag presence probe */
+    NFC_TRACE_SELECT          /* tag (re)selection */
+} NfcTraceKind;
+
+/**
+ * Single radio operation.
+ */
+typedef struct NfcTraceEvent {
+    uint64_t startNanos;      /* monotonic clock when the operation started */
+    uint64_t durationNanos;   /* duration of the operation */
+    int16_t response;         /* response length (negative = libnfc error), presence or found targets */
+    uint8_t kind;             /* NfcTraceKind */
+    uint8_t command;          /* first byte sent with NFC_TRACE_EXCHANGE */
+    uint8_t block;            /* block of read and write commands */
+    uint8_t attempt;          /* attempt of the block operation, 1 = first */
+} NfcTraceEvent;
+
+/**
+ * Buffer of radio operations of a single reader.
+ * Events are saved in a preallocated buffer, when it's full new events are counted and dropped.
+ */
+typedef struct NfcTrace {
+    NfcTraceEvent *events;    /* recorded events */
+    size_t count;             /* number of recorded events */
+    size_t capacity;          /* maximum number of events */
+    size_t dropped;           /* events not recorded because buffer was full */
+    uint32_t id;              /* trace viewer thread of this trace */
+    char name[64];            /* trace viewer thread name */
+} NfcTrace;
+
+/**
+ * Create a new trace.
+ * @param capacity maximum number of events
+ * @param id thread id shown by trace viewer
+ * @param name thread name shown by trace viewer
+ * @return null if there is an error, else a NfcTrace pointer
+ */
+NfcTrace *NfcTraceNew(size_t capacity, uint32_t id, const char *name);
+
+/**
+ * Free the memory of a trace.
+ * @param trace pointer to NfcTrace
+ */
+void NfcTraceDelete(NfcTrace *trace);
+
+/**
+ * Save traces as Chrome trace event JSON.
+ * @param filename name of JSON file
+ * @param traces traces to save, every trace is shown as a thread
+ * @param count number of traces
+ * @return SrixError result
+ */
+SrixError NfcTraceExport(const char *filename, NfcTrace *const traces[], size_t count);
+
+/**
+ * Get monotonic clock time for trace events.
+ * @return time in nanoseconds
+ */
+static inline uint64_t NfcTraceNow() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000U + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * Record an event started at startNanos and ended now.
+ * @param trace pointer to NfcTrace
+ * @param event event to record, its duration is set by this function
+ * @param startNanos start time from NfcTraceNow
+ */
+static inline void NfcTraceAdd(NfcTrace *trace, NfcTraceEvent event, uint64_t startNanos) {
+    if (trace->count == trace->capacity) {
+        trace->dropped++;
+        return;
+    }
+
+    event.startNanos = startNanos;
+    event.durationNanos = NfcTraceNow() - startNanos;
+    trace->events[trace->count++] = event;
+}
+
+#endif /* TRACE_H */
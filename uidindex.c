@@ -0,0 +1,277 @@
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "uidindex.h"
+
+#define UID_INDEX_MAGIC       "SRIXUIDX"
+#define UID_INDEX_VERSION     1
+#define UID_INDEX_BYTE_ORDER  0x01020304U
+
+/**
+ * Index file header, followed by count + 1 UIDs: an unused slot and the Eytzinger layout.
+ * Header is a cache line long, so every group of 8 tree nodes starting at a multiple of 8 is in a single line.
+ */
+typedef struct UidIndexHeader {
+    char magic[8];                    /* UID_INDEX_MAGIC */
+    uint32_t version;                 /* UID_INDEX_VERSION */
+    uint32_t byteOrder;               /* UID_INDEX_BYTE_ORDER written in host order */
+    uint64_t count;                   /* number of UIDs */
+    uint64_t reserved[5];             /* pads header to 64 bytes */
+} UidIndexHeader;
+
+/**
+ * UID index mapped in memory.
+ */
+struct SrixUidIndex {
+    void *mapping;                    /* mapped file */
+    size_t mappingSize;               /* size of mapped file */
+    const uint64_t *layout;           /* tree nodes, root is layout[1] */
+    size_t count;                     /* number of UIDs */
+};
+
+/**
+ * Compare two UIDs for qsort.
+ */
+static int uidIndexCompare(const void *first, const void *second) {
+    const uint64_t a = *(const uint64_t *) first;
+    const uint64_t b = *(const uint64_t *) second;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Place sorted UIDs in Eytzinger order with an in-order visit of the tree.
+ * @param sorted sorted UIDs
+ * @param layout array where save the tree, node k has children 2k and 2k + 1
+ * @param count number of UIDs
+ * @param next index of next sorted UID to place
+ * @param node node to visit
+ * @return index of next sorted UID to place after the visit
+ */
+static size_t uidIndexFill(const uint64_t *sorted, uint64_t *layout, size_t count, size_t next, size_t node) {
+    if (node <= count) {
+        next = uidIndexFill(sorted, layout, count, next, 2 * node);
+        layout[node] = sorted[next++];
+        next = uidIndexFill(sorted, layout, count, next, 2 * node + 1);
+    }
+    return next;
+}
+
+/**
+ * Sort UIDs and remove duplicates.
+ * @param uids UIDs to sort in place
+ * @param count number of UIDs
+ * @return number of distinct UIDs, at the start of the array
+ */
+static size_t uidIndexUnique(uint64_t *uids, size_t count) {
+    qsort(uids, count, sizeof(uint64_t), uidIndexCompare);
+
+    size_t distinct = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (distinct == 0 || uids[distinct - 1] != uids[i]) {
+            uids[distinct++] = uids[i];
+        }
+    }
+    return distinct;
+}
+
+/**
+ * Write an index file.
+ * @param filename name of index file
+ * @param sorted sorted distinct UIDs
+ * @param distinct number of UIDs
+ * @return SrixError result
+ */
+static SrixError uidIndexWrite(const char *filename, const uint64_t *sorted, size_t distinct) {
+    uint64_t *layout = calloc(distinct + 1, sizeof(uint64_t));
+    if (!layout) {
+        return SRIX_ERROR(SRIX_ERROR, "unable to allocate memory for UID index");
+    }
+    uidIndexFill(sorted, layout, distinct, 0, 1);
+
+    UidIndexHeader header = {
+            .version = UID_INDEX_VERSION,
+            .byteOrder = UID_INDEX_BYTE_ORDER,
+            .count = distinct
+    };
+    memcpy(header.magic, UID_INDEX_MAGIC, sizeof(header.magic));
+
+    /* Readers never see a partial index */
+    char temporary[PATH_MAX];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", filename);
+
+    FILE *output = fopen(temporary, "wb");
+    if (!output) {
+        free(layout);
+        return SRIX_ERROR(SRIX_ERROR, "unable to create UID index file");
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, output) == 1 &&
+                   fwrite(layout, sizeof(uint64_t), distinct + 1, output) == distinct + 1;
+    free(layout);
+
+    if (fclose(output) != 0 || !written || rename(temporary, filename) != 0) {
+        remove(temporary);
+        return SRIX_ERROR(SRIX_ERROR, "incorrect UID index file write");
+    }
+
+    return SRIX_NO_ERROR;
+}
+
+SrixError SrixUidIndexBuild(const char *filename, uint64_t *uids, size_t count) {
+    return uidIndexWrite(filename, uids, uidIndexUnique(uids, count));
+}
+
+/**
+ * Parse a line of a UID list.
+ * @param line text line
+ * @param uid pointer where save the UID
+ * @return 1 if a UID has been parsed, 0 if the line is empty or a comment, -1 if it's invalid
+ */
+static int uidIndexParseLine(const char *line, uint64_t *uid) {
+    while (isspace((unsigned char) *line)) {
+        line++;
+    }
+    if (*line == '\0' || *line == '#') {
+        return 0;
+    }
+
+    char *end;
+    unsigned long long value = strtoull(line, &end, 16);
+    while (isspace((unsigned char) *end)) {
+        end++;
+    }
+    if (end == line || *end != '\0') {
+        return -1;
+    }
+
+    *uid = value;
+    return 1;
+}
+
+SrixError SrixUidIndexImport(const char *filename, char *const lists[], size_t count, size_t *indexed) {
+    size_t capacity = 4096;
+    size_t uidsCount = 0;
+    uint64_t *uids = malloc(capacity * sizeof(uint64_t));
+    if (!uids) {
+        return SRIX_ERROR(SRIX_ERROR, "unable to allocate memory for UID index");
+    }
+
+    SrixError error = SRIX_NO_ERROR;
+    char line[128];
+
+    for (size_t i = 0; i < count && !SRIX_IS_ERROR(error); i++) {
+        FILE *input = fopen(lists[i], "r");
+        if (!input) {
+            error = SRIX_ERROR(SRIX_ERROR, "unable to open UID list file");
+            break;
+        }
+
+        while (fgets(line, sizeof(line), input)) {
+            uint64_t uid;
+            int parsed = uidIndexParseLine(line, &uid);
+            if (parsed < 0) {
+                error = SRIX_ERROR(SRIX_ERROR, "invalid UID in list file");
+                break;
+            } else if (parsed == 0) {
+                continue;
+            }
+
+            /* Grow UID array */
+            if (uidsCount == capacity) {
+                uint64_t *grown = realloc(uids, capacity * 2 * sizeof(uint64_t));
+                if (!grown) {
+                    error = SRIX_ERROR(SRIX_ERROR, "unable to allocate memory for UID index");
+                    break;
+                }
+                uids = grown;
+                capacity *= 2;
+            }
+            uids[uidsCount++] = uid;
+        }
+        fclose(input);
+    }
+
+    if (!SRIX_IS_ERROR(error)) {
+        size_t distinct = uidIndexUnique(uids, uidsCount);
+        error = uidIndexWrite(filename, uids, distinct);
+        if (indexed) {
+            *indexed = distinct;
+        }
+    }
+
+    free(uids);
+    return error;
+}
+
+SrixUidIndex *SrixUidIndexOpen(const char *filename) {
+    int file = open(filename, O_RDONLY);
+    if (file < 0) {
+        return (void *) 0;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) != 0 || (size_t) info.st_size < sizeof(UidIndexHeader) + sizeof(uint64_t)) {
+        close(file);
+        return (void *) 0;
+    }
+
+    void *mapping = mmap((void *) 0, info.st_size, PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED) {
+        return (void *) 0;
+    }
+
+    /* Only indexes written with the same byte order can be mapped directly */
+    const UidIndexHeader *header = mapping;
+    if (memcmp(header->magic, UID_INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != UID_INDEX_VERSION || header->byteOrder != UID_INDEX_BYTE_ORDER ||
+        header->count != (info.st_size - sizeof(UidIndexHeader)) / sizeof(uint64_t) - 1) {
+        munmap(mapping, info.st_size);
+        return (void *) 0;
+    }
+
+    SrixUidIndex *created = malloc(sizeof(SrixUidIndex));
+    if (!created) {
+        munmap(mapping, info.st_size);
+        return (void *) 0;
+    }
+
+    created->mapping = mapping;
+    created->mappingSize = info.st_size;
+    created->layout = (const uint64_t *) ((const uint8_t *) mapping + sizeof(UidIndexHeader));
+    created->count = header->count;
+
+    /* Lookups jump all over the index, read-ahead would only load unused pages */
+    madvise(mapping, info.st_size, MADV_RANDOM);
+    return created;
+}
+
+void SrixUidIndexClose(SrixUidIndex index[static 1]) {
+    munmap(index->mapping, index->mappingSize);
+    free(index);
+}
+
+size_t SrixUidIndexCount(SrixUidIndex index[static 1]) {
+    return index->count;
+}
+
+bool SrixUidIndexContains(SrixUidIndex index[static 1], uint64_t uid) {
+    const uint64_t *layout = index->layout;
+    size_t node = 1;
+
+    /* Branchless descent, nodes 3 levels below are in a single cache line fetched in advance */
+    while (node <= index->count) {
+        __builtin_prefetch(layout + 8 * node);
+        node = 2 * node + (layout[node] < uid);
+    }
+
+    /* Remove the right turns after the last left turn, the node where the search went left */
+    node >>= __builtin_ffsll((long long) ~node);
+    return node != 0 && layout[node] == uid;
+}
@@ -0,0 +1,63 @@
+#ifndef UIDINDEX_H
+#define UIDINDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "error.h"
+
+/**
+ * Read-only set of UIDs mapped in memory, in Eytzinger (breadth-first binary tree) order,
+ * so a lookup touches a cache line every few levels and the next ones are prefetched.
+ */
+typedef struct SrixUidIndex SrixUidIndex;
+
+/**
+ * Build an index file from a list of UIDs, replacing the file if it exists.
+ * @param filename name of index file
+ * @param uids UIDs to index, sorted in place, duplicates are allowed
+ * @param count number of UIDs
+ * @return SrixError result
+ */
+SrixError SrixUidIndexBuild(const char *filename, uint64_t *uids, size_t count);
+
+/**
+ * Build an index file from text files with a hexadecimal UID on every line.
+ * Empty lines and lines starting with # are ignored.
+ * @param filename name of index file
+ * @param lists names of UID list files
+ * @param count number of list files
+ * @param indexed pointer where save the number of distinct indexed UIDs, can be null
+ * @return SrixError result
+ */
+SrixError SrixUidIndexImport(const char *filename, char *const lists[], size_t count, size_t *indexed);
+
+/**
+ * Open an index file in read-only mode, mapping it in memory.
+ * @param filename name of index file
+ * @return null if there is an error, else a SrixUidIndex pointer
+ */
+SrixUidIndex *SrixUidIndexOpen(const char *filename);
+
+/**
+ * Unmap an index and free its memory.
+ * @param index pointer to SrixUidIndex
+ */
+void SrixUidIndexClose(SrixUidIndex *index);
+
+/**
+ * Get number of UIDs in an index.
+ * @param index pointer to SrixUidIndex
+ * @return number of distinct UIDs
+ */
+size_t SrixUidIndexCount(SrixUidIndex *index);
+
+/**
+ * Check if a UID is in an index.
+ * @param index pointer to SrixUidIndex
+ * @param uid UID to search
+ * @return true if the UID is in the index
+ */
+bool SrixUidIndexContains(SrixUidIndex *index, uint64_t uid);
+
+#endif /* UIDINDEX_H */